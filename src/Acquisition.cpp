@@ -0,0 +1,220 @@
+#include <pressure_velki/Acquisition.hpp>
+#include <pressure_velki/Errors.hpp>
+#include <pressure_velki/RequestFrames.hpp>
+#include <base/Logging.hpp>
+#include <unistd.h>
+
+using namespace pressure_velki;
+using namespace std;
+
+const int Acquisition::DEVICE_COUNT;
+
+Acquisition::Acquisition(size_t ringCapacity)
+    : ring(ringCapacity)
+    , sharedWriter(0)
+    , running(false)
+    , failed(false)
+    , latestSlots(new LatestSlot[DEVICE_COUNT * RequestFrames::CHANNEL_COUNT])
+{
+}
+
+Acquisition::~Acquisition()
+{
+    stop();
+}
+
+DriverClass5_20& Acquisition::getDriver()
+{
+    return driver;
+}
+
+void Acquisition::addDevice(int address, Channels const& channels)
+{
+    if (isRunning())
+        throw std::logic_error("cannot add devices while the acquisition runs");
+
+    Device device;
+    device.address = address;
+    device.channels = channels;
+    devices.push_back(device);
+}
+
+void Acquisition::setSharedWriter(SharedSampleWriter* writer)
+{
+    if (isRunning())
+        throw std::logic_error("cannot change the shared writer while the acquisition runs");
+    sharedWriter = writer;
+}
+
+void Acquisition::setPeriod(base::Time const& period)
+{
+    this->period = period;
+}
+
+void Acquisition::start()
+{
+    if (isRunning())
+        return;
+    // The thread may have stopped on its own after a failure
+    if (thread.joinable())
+        thread.join();
+    clearFailure();
+    running = true;
+    thread = boost::thread(&Acquisition::run, this);
+}
+
+void Acquisition::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+bool Acquisition::isRunning() const
+{
+    return running;
+}
+
+bool Acquisition::hasFailed() const
+{
+    return failed.load(boost::memory_order_acquire);
+}
+
+string Acquisition::getFailure() const
+{
+    if (!hasFailed())
+        return string();
+    return failure;
+}
+
+void Acquisition::clearFailure()
+{
+    failed = false;
+    failure.clear();
+}
+
+void Acquisition::run()
+{
+    base::Time next_cycle = base::Time::now();
+    while (running)
+    {
+        if (!tryPollOnce())
+        {
+            running = false;
+            return;
+        }
+        if (period.isNull())
+            continue;
+
+        next_cycle = next_cycle + period;
+        base::Time now = base::Time::now();
+        if (next_cycle > now)
+            usleep((next_cycle - now).toMicroseconds());
+        else
+            next_cycle = now;
+    }
+}
+
+void Acquisition::pollOnce()
+{
+    for (size_t i = 0; i < devices.size(); ++i)
+        pollDevice(devices[i]);
+}
+
+bool Acquisition::tryPollOnce()
+{
+    try
+    {
+        pollOnce();
+        return true;
+    }
+    catch(std::exception const& e)
+    {
+        // Most likely the port went away. Letting the exception out of the
+        // thread would terminate the process
+        LOG_ERROR_S << "acquisition stopped: " << e.what();
+        failure = e.what();
+        failed.store(true, boost::memory_order_release);
+        return false;
+    }
+}
+
+void Acquisition::pollDevice(Device const& device)
+{
+    driver.tryReadChannels(device.channels, samples, device.address);
+
+    bool timeout = false;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        Sample const& sample = samples[i];
+        if (sample.status == Sample::STATUS_TIMEOUT)
+            timeout = true;
+        else if (sample.status == Sample::STATUS_DEVICE_ERROR)
+            LOG_WARN_S << "device " << device.address << " returned an error: "
+                << Error::errorMessage(DriverClass5_20::FUNCTION_READ_CHANNEL, static_cast<Error::ERROR_CODE>(sample.error));
+        publish(sample);
+    }
+
+    // Drop whatever partial response we got, it would only confuse the next
+    // transaction
+    if (timeout)
+        driver.clear();
+}
+
+void Acquisition::publish(Sample const& sample)
+{
+    if (sample.device >= 0 && sample.device < DEVICE_COUNT &&
+            sample.channel >= 0 && sample.channel < RequestFrames::CHANNEL_COUNT)
+    {
+        LatestSlot& slot = latestSlots[sample.device * RequestFrames::CHANNEL_COUNT + sample.channel];
+        boost::uint32_t sequence = slot.sequence.load(boost::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_release);
+        slot.sample = sample;
+        slot.sequence.store(sequence + 2, boost::memory_order_release);
+    }
+
+    if (sharedWriter)
+        sharedWriter->publish(sample);
+    if (!ring.push(sample))
+        LOG_DEBUG_S << "acquisition ring full, dropping sample";
+}
+
+size_t Acquisition::drain(vector<Sample>& samples)
+{
+    size_t count = 0;
+    Sample sample;
+    while (ring.pop(sample))
+    {
+        samples.push_back(sample);
+        ++count;
+    }
+    return count;
+}
+
+bool Acquisition::latest(int device, int channel, Sample& sample) const
+{
+    if (device < 0 || device >= DEVICE_COUNT ||
+            channel < 0 || channel >= RequestFrames::CHANNEL_COUNT)
+        return false;
+
+    LatestSlot const& slot = latestSlots[device * RequestFrames::CHANNEL_COUNT + channel];
+    while (true)
+    {
+        boost::uint32_t sequence = slot.sequence.load(boost::memory_order_acquire);
+        if (sequence == 0)
+            return false;
+        if (sequence & 1)
+            continue;
+        sample = slot.sample;
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        if (slot.sequence.load(boost::memory_order_relaxed) == sequence)
+            return true;
+    }
+}
+
+boost::uint64_t Acquisition::getOverruns() const
+{
+    return ring.getOverruns();
+}
+
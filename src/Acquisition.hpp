@@ -0,0 +1,175 @@
+#ifndef PRESSURE_VELKI_ACQUISITION_HPP
+#define PRESSURE_VELKI_ACQUISITION_HPP
+
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/thread.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+#include <pressure_velki/Sample.hpp>
+#include <pressure_velki/SPSCRing.hpp>
+#include <pressure_velki/SharedSamples.hpp>
+
+namespace pressure_velki
+{
+    /** Continuous acquisition in a background thread
+     *
+     * The acquisition owns a driver, and polls a configured set of channels in
+     * a dedicated thread. The resulting samples are pushed in a lock-free
+     * ring, from which a consumer thread can get them without ever blocking
+     * on the serial port.
+     *
+     * Samples are pushed for failed reads as well, with the corresponding
+     * Sample::status, so that the consumer can monitor the devices.
+     *
+     * drain() is the consumer side of the ring. It must always be called
+     * from the same thread. The latest sample of each channel is kept
+     * separately from the ring, so latest() works whether or not the ring
+     * is drained, and can be called from any thread.
+     *
+     * If the port fails (e.g. a USB adapter gets unplugged), the thread
+     * stops. isRunning() then returns false and getFailure() tells why.
+     */
+    class Acquisition
+    {
+    public:
+        typedef std::vector<DriverClass5_20::CHANNEL_ID> Channels;
+
+        /** Size of the latest-sample table. Devices are 0 to 255 */
+        static const int DEVICE_COUNT = 256;
+
+    private:
+        struct Device
+        {
+            int address;
+            Channels channels;
+        };
+
+        DriverClass5_20 driver;
+        std::vector<Device> devices;
+        base::Time period;
+        SPSCRing<Sample> ring;
+        SharedSampleWriter* sharedWriter;
+
+        boost::atomic<bool> running;
+        boost::thread thread;
+        /** Set once failure is written, by the thread that polls the port */
+        boost::atomic<bool> failed;
+        std::string failure;
+
+        /** The latest sample of a channel. The sequence is odd while the
+         * producer writes the slot (seqlock)
+         */
+        struct LatestSlot
+        {
+            boost::atomic<boost::uint32_t> sequence;
+            Sample sample;
+
+            LatestSlot() : sequence(0) {}
+        };
+        boost::scoped_array<LatestSlot> latestSlots;
+
+        /** Producer-side buffer */
+        std::vector<Sample> samples;
+
+        void run();
+        void pollDevice(Device const& device);
+        void publish(Sample const& sample);
+
+    public:
+        /**
+         * @param ringCapacity the number of samples the ring can hold. Samples
+         *   are dropped when the consumer does not keep up
+         */
+        explicit Acquisition(size_t ringCapacity = 4096);
+        ~Acquisition();
+
+        /** The driver used by the acquisition
+         *
+         * Use it to open and configure the port. It must not be used while
+         * the acquisition thread runs.
+         */
+        DriverClass5_20& getDriver();
+
+        /** Adds a device and the channels that should be read on it
+         *
+         * It cannot be called while the acquisition thread runs
+         */
+        void addDevice(int device, Channels const& channels);
+
+        /** Sets a writer in which the samples are published as well, so
+         * that other processes can read them
+         *
+         * The writer is not owned by the acquisition. It cannot be changed
+         * while the acquisition thread runs. Set to NULL to stop publishing.
+         */
+        void setSharedWriter(SharedSampleWriter* writer);
+
+        /** Sets the period of a polling cycle, in which all devices are read
+         * once. The default (zero) is to poll as fast as possible
+         */
+        void setPeriod(base::Time const& period);
+
+        /** Starts the acquisition thread */
+        void start();
+
+        /** Stops the acquisition thread and waits for it to finish */
+        void stop();
+
+        /** Returns true if the acquisition thread runs */
+        bool isRunning() const;
+
+        /** Returns true if the port failed, which stopped the acquisition
+         * thread
+         */
+        bool hasFailed() const;
+
+        /** Returns the error that made the port fail, or an empty string */
+        std::string getFailure() const;
+
+        /** Forgets the failure of the port, e.g. once it got reopened.
+         * start() does it
+         */
+        void clearFailure();
+
+        /** Reads all devices once
+         *
+         * This is what the acquisition thread does at each cycle. It can be
+         * called directly instead of using start()
+         */
+        void pollOnce();
+
+        /** Reads all devices once, and records a failure of the port
+         * instead of throwing
+         *
+         * @return false if the port failed, in which case hasFailed() and
+         *   getFailure() tell why
+         */
+        bool tryPollOnce();
+
+        /** Moves all available samples at the end of \c samples
+         *
+         * @return the number of samples added
+         */
+        size_t drain(std::vector<Sample>& samples);
+
+        /** Gets the latest sample of a channel
+         *
+         * It does not touch the ring. It is wait-free for the producer, the
+         * caller retries if the producer updates the channel during the
+         * copy.
+         *
+         * @return false if no sample has been acquired for this channel yet
+         */
+        bool latest(int device, int channel, Sample& sample) const;
+
+        /** Returns the number of samples that got dropped because the
+         * consumer did not keep up
+         */
+        boost::uint64_t getOverruns() const;
+    };
+}
+
+#endif
+
@@ -0,0 +1,57 @@
+#include <pressure_velki/AdaptiveTimeout.hpp>
+#include <algorithm>
+
+using namespace pressure_velki;
+
+AdaptiveTimeout::AdaptiveTimeout(double percentile)
+    : percentile(percentile)
+    , sinceUpdate(0)
+{
+}
+
+void AdaptiveTimeout::setPercentile(double percentile)
+{
+    this->percentile = percentile;
+    update();
+}
+
+void AdaptiveTimeout::record(base::Time const& responseTime)
+{
+    if (current.getCount() >= static_cast<boost::uint64_t>(WINDOW_SIZE))
+    {
+        previous = current;
+        current.reset();
+    }
+    current.record(responseTime);
+
+    if (++sinceUpdate >= UPDATE_PERIOD || getSampleCount() == MINIMUM_SAMPLES)
+        update();
+}
+
+void AdaptiveTimeout::update()
+{
+    sinceUpdate = 0;
+    LatencyHistogram window = previous;
+    window.merge(current);
+    estimate = window.getPercentile(percentile);
+}
+
+void AdaptiveTimeout::reset()
+{
+    current.reset();
+    previous.reset();
+    sinceUpdate = 0;
+    estimate = base::Time();
+}
+
+int AdaptiveTimeout::getSampleCount() const
+{
+    return current.getCount() + previous.getCount();
+}
+
+base::Time AdaptiveTimeout::getTimeout(base::Time const& margin, base::Time const& fallback) const
+{
+    if (getSampleCount() < MINIMUM_SAMPLES)
+        return fallback;
+    return std::min(estimate + margin, fallback);
+}
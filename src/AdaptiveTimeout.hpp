@@ -0,0 +1,66 @@
+#ifndef PRESSURE_VELKI_ADAPTIVE_TIMEOUT_HPP
+#define PRESSURE_VELKI_ADAPTIVE_TIMEOUT_HPP
+
+#include <pressure_velki/LatencyHistogram.hpp>
+
+namespace pressure_velki
+{
+    /** Estimation of a response timeout from the observed response times
+     *
+     * The timeout is a high percentile of the response times, plus a margin.
+     * Only the last WINDOW_SIZE to 2 * WINDOW_SIZE response times are taken
+     * into account, so that the estimate follows changes in the device's
+     * behaviour. The percentile is updated every UPDATE_PERIOD response
+     * times, so that getTimeout() is cheap.
+     */
+    class AdaptiveTimeout
+    {
+    public:
+        static const int WINDOW_SIZE = 256;
+
+        /** Number of response times needed before getTimeout() returns an
+         * estimate
+         */
+        static const int MINIMUM_SAMPLES = 16;
+
+        static const int UPDATE_PERIOD = 16;
+
+    private:
+        LatencyHistogram current;
+        LatencyHistogram previous;
+        double percentile;
+        int sinceUpdate;
+        base::Time estimate;
+
+        void update();
+
+    public:
+        /** @param percentile the percentile of the response times that is
+         *   used as base of the timeout, e.g. 0.99
+         */
+        explicit AdaptiveTimeout(double percentile = 0.99);
+
+        void setPercentile(double percentile);
+
+        /** Adds a response time */
+        void record(base::Time const& responseTime);
+
+        /** Forgets all recorded response times */
+        void reset();
+
+        /** Returns the number of response times the estimate is based on */
+        int getSampleCount() const;
+
+        /** Returns the timeout
+         *
+         * @param margin the margin added to the percentile
+         * @param fallback the timeout returned while there are less than
+         *   MINIMUM_SAMPLES response times. It is also the upper bound of
+         *   the estimate
+         */
+        base::Time getTimeout(base::Time const& margin, base::Time const& fallback) const;
+    };
+}
+
+#endif
+
@@ -0,0 +1,118 @@
+#include <pressure_velki/BatchDecoder.hpp>
+#include <string.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+using namespace pressure_velki;
+using boost::uint32_t;
+
+namespace
+{
+    /** The bits of the NaN used for invalid values (quiet NaN) */
+    const uint32_t NAN_BITS = 0x7FC00000;
+
+    /** Converts the big-endian values in place */
+    void swapBytes(float* values, size_t count)
+    {
+        size_t i = 0;
+#if defined(__SSSE3__)
+        __m128i const shuffle = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(values + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), _mm_shuffle_epi8(v, shuffle));
+        }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        for (; i + 4 <= count; i += 4)
+        {
+            uint8x16_t v = vld1q_u8(reinterpret_cast<uint8_t const*>(values + i));
+            vst1q_u8(reinterpret_cast<uint8_t*>(values + i), vrev32q_u8(v));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            uint32_t raw;
+            memcpy(&raw, values + i, 4);
+            raw = __builtin_bswap32(raw);
+            memcpy(values + i, &raw, 4);
+        }
+    }
+}
+
+size_t ChannelColumns::size() const
+{
+    return values.size();
+}
+
+void ChannelColumns::clear()
+{
+    values.clear();
+    statuses.clear();
+    channels.clear();
+    devices.clear();
+}
+
+void ChannelColumns::resize(size_t size)
+{
+    values.resize(size);
+    statuses.resize(size);
+    channels.resize(size);
+    devices.resize(size);
+}
+
+Sample::STATUS BatchDecoder::classify(byte status, int channel)
+{
+    // Same priorities than DriverClass5_20::decodeChannel: powering up, then
+    // saturation, then channel error
+    uint32_t powering_up = (status >> 3) & 1;
+    uint32_t saturated = ((status & 0x7) != 0) & (powering_up ^ 1);
+    uint32_t channel_error = ((status & channel) != 0) & ((powering_up | saturated) ^ 1);
+    return static_cast<Sample::STATUS>(
+            powering_up * Sample::STATUS_POWERING_UP +
+            saturated * Sample::STATUS_SATURATED +
+            channel_error * Sample::STATUS_CHANNEL_ERROR);
+}
+
+void BatchDecoder::decode(byte const* buffer, uint32_t const* offsets,
+        byte const* channels, size_t count, ChannelColumns& columns)
+{
+    if (count == 0)
+        return;
+
+    size_t start = columns.size();
+    columns.resize(start + count);
+    float* values = &columns.values[start];
+    boost::uint8_t* statuses = &columns.statuses[start];
+    boost::uint8_t* channel_column = &columns.channels[start];
+    boost::uint8_t* devices = &columns.devices[start];
+
+    // Gather the fields of each frame. The values are copied as-is, and
+    // byte-swapped all at once afterwards
+    for (size_t i = 0; i < count; ++i)
+    {
+        byte const* frame = buffer + offsets[i];
+        devices[i] = frame[0];
+        memcpy(values + i, frame + 2, 4);
+        statuses[i] = frame[6];
+        channel_column[i] = channels[i];
+    }
+
+    swapBytes(values, count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        Sample::STATUS status = classify(statuses[i], channel_column[i]);
+        statuses[i] = status;
+
+        // Replace the value by NaN unless the status is OK
+        uint32_t mask = -static_cast<uint32_t>(status == Sample::STATUS_OK);
+        uint32_t raw;
+        memcpy(&raw, values + i, 4);
+        raw = (raw & mask) | (NAN_BITS & ~mask);
+        memcpy(values + i, &raw, 4);
+    }
+}
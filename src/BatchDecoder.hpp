@@ -0,0 +1,70 @@
+#ifndef PRESSURE_VELKI_BATCH_DECODER_HPP
+#define PRESSURE_VELKI_BATCH_DECODER_HPP
+
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <pressure_velki/Packet.hpp>
+#include <pressure_velki/Sample.hpp>
+
+namespace pressure_velki
+{
+    /** Channel readings stored column by column
+     *
+     * The i-th reading is (values[i], statuses[i], channels[i], devices[i])
+     */
+    struct ChannelColumns
+    {
+        /** The values. NaN unless the status is Sample::STATUS_OK */
+        std::vector<float> values;
+        /** The statuses, as Sample::STATUS values */
+        std::vector<boost::uint8_t> statuses;
+        /** The channels, as DriverClass5_20::CHANNEL_ID values */
+        std::vector<boost::uint8_t> channels;
+        /** The device addresses */
+        std::vector<boost::uint8_t> devices;
+
+        size_t size() const;
+        void clear();
+        void resize(size_t size);
+    };
+
+    /** Decoding of large amounts of READ_CHANNEL responses, as e.g. when
+     * analysing recorded sessions
+     *
+     * It gives the same results than DriverClass5_20::decodeChannel, but
+     * processes whole columns at once: the byte swap of the values uses SIMD
+     * when the target supports it (SSSE3 or NEON), and the status
+     * classification has no branches.
+     */
+    class BatchDecoder
+    {
+    public:
+        /** Size of a READ_CHANNEL response frame */
+        static const int RESPONSE_SIZE = 9;
+
+        /** Classifies the status byte of a READ_CHANNEL response
+         *
+         * @param status the status byte
+         * @param channel the channel that has been read
+         */
+        static Sample::STATUS classify(byte status, int channel);
+
+        /** Decodes READ_CHANNEL response frames and appends the result to
+         * \c columns
+         *
+         * The frames must already have been validated, i.e. have a valid CRC
+         * and not be exception responses.
+         *
+         * @param buffer the buffer that contains the frames
+         * @param offsets the offset of each frame in \c buffer
+         * @param channels the channel that has been requested for each frame,
+         *   as the response does not contain it
+         * @param count the number of frames
+         */
+        static void decode(byte const* buffer, boost::uint32_t const* offsets,
+                byte const* channels, size_t count, ChannelColumns& columns);
+    };
+}
+
+#endif
+
@@ -0,0 +1,177 @@
+#include <pressure_velki/BusDiscovery.hpp>
+#include <pressure_velki/Errors.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace pressure_velki;
+using namespace std;
+
+const int BusDiscovery::FIRST_ADDRESS;
+const int BusDiscovery::LAST_ADDRESS;
+
+namespace
+{
+    /** Restores the driver's timeout and retries when the scan returns */
+    struct DriverSettings
+    {
+        DriverClass5_20& driver;
+        base::Time readTimeout;
+        int maxRetries;
+
+        explicit DriverSettings(DriverClass5_20& driver)
+            : driver(driver)
+            , readTimeout(driver.getReadTimeout())
+            , maxRetries(driver.getMaxRetries()) {}
+
+        ~DriverSettings()
+        {
+            driver.setReadTimeout(readTimeout);
+            driver.setMaxRetries(maxRetries);
+        }
+    };
+}
+
+BusDiscovery::BusDiscovery(DriverClass5_20& driver)
+    : driver(driver)
+    , first(FIRST_ADDRESS)
+    , last(LAST_ADDRESS)
+    , turnaround(base::Time::fromMilliseconds(20))
+    , maxConsecutiveMisses(0)
+    , probeCount(0)
+{
+}
+
+void BusDiscovery::setRange(int first, int last)
+{
+    if (first < 0 || last > 255 || first > last)
+        throw std::invalid_argument("BusDiscovery: invalid address range");
+    this->first = first;
+    this->last = last;
+}
+
+void BusDiscovery::setTurnaround(base::Time const& turnaround)
+{
+    this->turnaround = turnaround;
+}
+
+void BusDiscovery::setMaxConsecutiveMisses(int misses)
+{
+    maxConsecutiveMisses = misses;
+}
+
+base::Time BusDiscovery::getProbeTimeout() const
+{
+    // The request and response sizes do not depend on the address
+    DriverClass5_20::Request request = DriverClass5_20::Request::initialize(first);
+    base::Time transmission = driver.getTransmissionTime(request.frame->size + request.responseSize + 4);
+    base::Time timeout = transmission + turnaround + driver.getInterFrameSilence();
+    return std::min(timeout, driver.getReadTimeout());
+}
+
+int BusDiscovery::getProbeCount() const
+{
+    return probeCount;
+}
+
+BusDiscovery::PROBE_RESULT BusDiscovery::probe(int address, DeviceInfo& info)
+{
+    ++probeCount;
+    boost::uint64_t discarded = driver.getDiscardedBytes();
+    try
+    {
+        info = driver.initialize(address);
+        return PROBE_HIT;
+    }
+    catch(iodrivers_base::TimeoutError const& e)
+    {
+        if (e.type == iodrivers_base::TimeoutError::PACKET || driver.getDiscardedBytes() != discarded)
+            return PROBE_GARBAGE;
+        return PROBE_MISS;
+    }
+    catch(Error const&)
+    {
+        // Something answered at this address, but not as a device that
+        // can be initialized would
+        return PROBE_GARBAGE;
+    }
+    // Anything else, e.g. a UnixError on a dead port, is not something a
+    // scan can work around
+}
+
+vector<BusDiscovery::Device> BusDiscovery::scan()
+{
+    DriverSettings settings(driver);
+    vector<Device> devices;
+    probeCount = 0;
+
+    base::Time timeout = getProbeTimeout();
+    // Leave some room for the scheduling of this process
+    base::Time minimumTimeout = timeout - turnaround + base::Time::fromMilliseconds(2);
+    driver.setReadTimeout(timeout);
+    driver.setMaxRetries(0);
+
+    int misses = 0;
+    bool previousMissed = false;
+    for (int address = first; address <= last; ++address)
+    {
+        if (maxConsecutiveMisses && misses >= maxConsecutiveMisses)
+            break;
+
+        Device device;
+        device.address = address;
+        base::Time start = base::Time::now();
+        PROBE_RESULT result = probe(address, device.info);
+        if (result == PROBE_GARBAGE)
+        {
+            // Either this device or the previous one is slower than the
+            // timeout, and its response arrived late
+            base::Time increased = std::min(timeout + timeout, settings.readTimeout);
+            if (increased > timeout)
+            {
+                timeout = increased;
+                driver.setReadTimeout(timeout);
+                driver.clear();
+                if (previousMissed)
+                {
+                    address -= 2;
+                    --misses;
+                }
+                else
+                    --address;
+                previousMissed = false;
+                continue;
+            }
+        }
+        if (result != PROBE_HIT)
+        {
+            ++misses;
+            previousMissed = true;
+            continue;
+        }
+        // Shrink the timeout to what the devices actually need
+        base::Time elapsed = base::Time::now() - start;
+        timeout = std::min(timeout, std::max(elapsed + elapsed, minimumTimeout));
+        misses = 0;
+        previousMissed = false;
+
+        driver.setReadTimeout(settings.readTimeout);
+        driver.setMaxRetries(settings.maxRetries);
+        try
+        {
+            driver.echo(address);
+            device.serialNumber = driver.getSerialNumber(address);
+            devices.push_back(device);
+        }
+        catch(Error const&)
+        {
+            // Not a device we can talk to
+        }
+        catch(iodrivers_base::TimeoutError const&)
+        {
+            // It stopped responding
+        }
+        driver.setReadTimeout(timeout);
+        driver.setMaxRetries(0);
+    }
+    return devices;
+}
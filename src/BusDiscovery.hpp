@@ -0,0 +1,101 @@
+#ifndef PRESSURE_VELKI_BUS_DISCOVERY_HPP
+#define PRESSURE_VELKI_BUS_DISCOVERY_HPP
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+
+namespace pressure_velki
+{
+    /** Finds the devices that are present on a bus
+     *
+     * Each address is probed with an initialize request. Most addresses are
+     * empty, so the time it takes to scan a bus is the time spent waiting for
+     * responses that never come. Instead of the read timeout, a probe waits
+     * for the time it takes to transmit the request and the response at the
+     * driver's baud rate, plus the time a device takes to start responding
+     * (setTurnaround). Once a device has responded, the probes wait for at
+     * most twice the slowest response seen so far.
+     *
+     * Bytes that get received but cannot be decoded during a probe mean that
+     * something responded too late or got corrupted. The probe timeout is
+     * then doubled, up to the driver's read timeout, and the scan goes back
+     * to the previous address.
+     *
+     * Hits are verified with an echo, and completed with the device's serial
+     * number, with the driver's read timeout and retries.
+     */
+    class BusDiscovery : boost::noncopyable
+    {
+    public:
+        static const int FIRST_ADDRESS = 1;
+        static const int LAST_ADDRESS = 249;
+
+        /** A device found by scan() */
+        struct Device
+        {
+            int address;
+            DeviceInfo info;
+            int serialNumber;
+        };
+
+        /** @param driver the driver, whose port must be open */
+        explicit BusDiscovery(DriverClass5_20& driver);
+
+        /** Sets the range of addresses to scan. It is FIRST_ADDRESS to
+         * LAST_ADDRESS by default
+         */
+        void setRange(int first, int last);
+
+        /** Sets the time a device may take between the end of a request and
+         * the start of its response, before it is considered absent. It is
+         * 20ms by default
+         */
+        void setTurnaround(base::Time const& turnaround);
+
+        /** Stops the scan after that many consecutive empty addresses
+         *
+         * Devices are usually given consecutive addresses from the start of
+         * the range, so that e.g. 16 is enough to find them all in a
+         * fraction of the time of a full scan. It is 0 by default, which
+         * scans the whole range.
+         */
+        void setMaxConsecutiveMisses(int misses);
+
+        /** Returns the timeout of the first probe of a scan */
+        base::Time getProbeTimeout() const;
+
+        /** Returns the number of probes sent by the last scan */
+        int getProbeCount() const;
+
+        /** Scans the bus
+         *
+         * The devices that are found are initialized. The driver's read
+         * timeout and number of retries are restored on return.
+         *
+         * @throw iodrivers_base::UnixError if the port fails. A dead port
+         *   is not reported as an empty bus
+         */
+        std::vector<Device> scan();
+
+    private:
+        DriverClass5_20& driver;
+        int first;
+        int last;
+        base::Time turnaround;
+        int maxConsecutiveMisses;
+        int probeCount;
+
+        enum PROBE_RESULT
+        {
+            PROBE_HIT,
+            PROBE_MISS,
+            /** Bytes got received, but no valid response */
+            PROBE_GARBAGE
+        };
+
+        PROBE_RESULT probe(int address, DeviceInfo& info);
+    };
+}
+
+#endif
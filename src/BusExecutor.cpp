@@ -0,0 +1,191 @@
+#include <pressure_velki/BusExecutor.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <errno.h>
+#include <sys/select.h>
+#include <boost/bind.hpp>
+
+using namespace pressure_velki;
+using namespace std;
+
+BusTask::BusTask()
+    : waiting(false)
+    , status(DriverClass5_20::ASYNC_OK)
+{
+}
+
+BusTask::~BusTask()
+{
+}
+
+PacketView BusTask::getResponse() const
+{
+    if (response.empty())
+        return PacketView();
+    return PacketView(&response[0], response.size());
+}
+
+BusExecutor::BusExecutor(DriverClass5_20& driver)
+    : driver(driver)
+{
+}
+
+BusExecutor::~BusExecutor()
+{
+    for (size_t i = 0; i < tasks.size(); ++i)
+        delete tasks[i];
+}
+
+DriverClass5_20& BusExecutor::getDriver()
+{
+    return driver;
+}
+
+void BusExecutor::spawn(BusTask* task)
+{
+    tasks.push_back(task);
+    ready.push_back(task);
+}
+
+size_t BusExecutor::getTaskCount() const
+{
+    return tasks.size();
+}
+
+void BusExecutor::wait(BusTask& task)
+{
+    if (task.waiting)
+        throw std::logic_error("BusExecutor: a task can only wait for one thing at a time");
+    task.waiting = true;
+}
+
+void BusExecutor::transact(BusTask& task, DriverClass5_20::Request const& request)
+{
+    wait(task);
+    driver.submit(request, boost::bind(&BusExecutor::completeTransaction, this, &task, _1, _2));
+}
+
+void BusExecutor::readChannel(BusTask& task, DriverClass5_20::CHANNEL_ID channel, int device)
+{
+    wait(task);
+    driver.submit(DriverClass5_20::Request::readChannel(channel, device),
+            boost::bind(&BusExecutor::completeRead, this, &task, channel, device, _1, _2));
+}
+
+void BusExecutor::sleep(BusTask& task, base::Time const& duration)
+{
+    wait(task);
+    timers.insert(make_pair(base::Time::now() + duration, &task));
+}
+
+void BusExecutor::completeTransaction(BusTask* task, DriverClass5_20::ASYNC_STATUS status,
+        PacketView const& response)
+{
+    // The view is only valid during the callback
+    task->status = status;
+    if (response.isEmpty())
+        task->response.clear();
+    else
+        task->response.assign(response.getFrame(), response.getFrame() + response.getFrameSize());
+    task->waiting = false;
+    ready.push_back(task);
+}
+
+void BusExecutor::completeRead(BusTask* task, DriverClass5_20::CHANNEL_ID channel, int device,
+        DriverClass5_20::ASYNC_STATUS status, PacketView const& response)
+{
+    Sample::STATUS sampleStatus = Sample::STATUS_OK;
+    if (status == DriverClass5_20::ASYNC_TIMEOUT)
+        sampleStatus = Sample::STATUS_TIMEOUT;
+    else if (status == DriverClass5_20::ASYNC_DEVICE_ERROR)
+        sampleStatus = Sample::STATUS_DEVICE_ERROR;
+    task->sample = driver.decodeChannelSample(channel, device, sampleStatus, response);
+    completeTransaction(task, status, response);
+}
+
+void BusExecutor::resume(BusTask* task)
+{
+    try
+    {
+        (*task)(*this);
+    }
+    catch(...)
+    {
+        // A task that throws cannot be resumed anymore
+        tasks.erase(find(tasks.begin(), tasks.end(), task));
+        delete task;
+        throw;
+    }
+
+    if (task->is_complete())
+    {
+        tasks.erase(find(tasks.begin(), tasks.end(), task));
+        delete task;
+    }
+    else if (!task->waiting)
+        ready.push_back(task);
+}
+
+void BusExecutor::run()
+{
+    while (runOnce(base::Time::fromSeconds(1)));
+}
+
+bool BusExecutor::runOnce(base::Time const& timeout)
+{
+    // Only run the tasks that are ready now, a task that yields without
+    // waiting runs again at the next call
+    deque<BusTask*> current;
+    current.swap(ready);
+    for (size_t i = 0; i < current.size(); ++i)
+    {
+        try
+        {
+            resume(current[i]);
+        }
+        catch(...)
+        {
+            // The other tasks of the batch run first at the next call
+            ready.insert(ready.begin(), current.begin() + i + 1, current.end());
+            throw;
+        }
+    }
+    if (tasks.empty())
+        return false;
+
+    base::Time now = base::Time::now();
+    base::Time deadline = now + timeout;
+    if (!ready.empty())
+        deadline = now;
+    base::Time asyncDeadline = driver.getNextAsyncDeadline();
+    if (!asyncDeadline.isNull())
+        deadline = std::min(deadline, asyncDeadline);
+    if (!timers.empty())
+        deadline = std::min(deadline, timers.begin()->first);
+
+    if (deadline > now)
+    {
+        int fd = driver.getFileDescriptor();
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(fd, &set);
+        timeval tv;
+        boost::int64_t remaining = (deadline - now).toMicroseconds();
+        tv.tv_sec = remaining / 1000000;
+        tv.tv_usec = remaining % 1000000;
+        if (select(fd + 1, &set, 0, 0, &tv) == -1 && errno != EINTR)
+            throw iodrivers_base::UnixError("BusExecutor: error while waiting on the port");
+    }
+
+    // Completions push the tasks in the ready queue
+    driver.processAsync();
+    now = base::Time::now();
+    while (!timers.empty() && timers.begin()->first <= now)
+    {
+        BusTask* task = timers.begin()->second;
+        timers.erase(timers.begin());
+        task->waiting = false;
+        ready.push_back(task);
+    }
+    return true;
+}
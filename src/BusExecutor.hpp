@@ -0,0 +1,150 @@
+#ifndef PRESSURE_VELKI_BUS_EXECUTOR_HPP
+#define PRESSURE_VELKI_BUS_EXECUTOR_HPP
+
+#include <deque>
+#include <map>
+#include <vector>
+#include <boost/asio/coroutine.hpp>
+#include <boost/noncopyable.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+
+namespace pressure_velki
+{
+    class BusExecutor;
+
+    /** A sequence of transactions run by a BusExecutor
+     *
+     * Tasks are stackless coroutines (boost::asio::coroutine). Subclasses
+     * implement operator(), and wait for a transaction by yielding the call
+     * that starts it:
+     *
+     * @code
+     * #include <boost/asio/yield.hpp>
+     * void ReadTask::operator()(BusExecutor& executor)
+     * {
+     *     reenter(this)
+     *     {
+     *         yield executor.transact(*this, DriverClass5_20::Request::initialize(device));
+     *         while (true)
+     *         {
+     *             yield executor.readChannel(*this, DriverClass5_20::CHANNEL_PRESSURE0, device);
+     *             if (sample.status == Sample::STATUS_POWERING_UP)
+     *                 yield executor.sleep(*this, base::Time::fromMilliseconds(100));
+     *             else
+     *                 ...
+     *         }
+     *     }
+     * }
+     * #include <boost/asio/unyield.hpp>
+     * @endcode
+     *
+     * As the coroutine is stackless, the state that must survive a yield
+     * has to be stored in the task's members. A bare yield gives the other
+     * tasks a chance to run.
+     */
+    class BusTask : public boost::asio::coroutine
+    {
+        friend class BusExecutor;
+        bool waiting;
+
+    protected:
+        /** Outcome of the last transaction */
+        DriverClass5_20::ASYNC_STATUS status;
+        /** The frame of the last response. Empty on timeout */
+        std::vector<byte> response;
+        /** The result of the last BusExecutor::readChannel */
+        Sample sample;
+
+        /** Returns a view on the last response */
+        PacketView getResponse() const;
+
+    public:
+        BusTask();
+        virtual ~BusTask();
+
+        /** Runs the task until it waits or completes */
+        virtual void operator()(BusExecutor& executor) = 0;
+    };
+
+    /** Single-threaded executor that interleaves the transactions of many
+     * tasks on one bus
+     *
+     * The executor drives the driver's non-blocking mode (see
+     * DriverClass5_20::submit) and the tasks from the thread that calls
+     * run(). While a task waits for a response or sleeps, the other tasks
+     * keep on using the bus, so that e.g. a device powering up does not
+     * block the others.
+     */
+    class BusExecutor : boost::noncopyable
+    {
+        DriverClass5_20& driver;
+        std::vector<BusTask*> tasks;
+        std::deque<BusTask*> ready;
+        std::multimap<base::Time, BusTask*> timers;
+
+        void wait(BusTask& task);
+        void resume(BusTask* task);
+        void completeTransaction(BusTask* task, DriverClass5_20::ASYNC_STATUS status,
+                PacketView const& response);
+        void completeRead(BusTask* task, DriverClass5_20::CHANNEL_ID channel, int device,
+                DriverClass5_20::ASYNC_STATUS status, PacketView const& response);
+
+    public:
+        /** @param driver the driver, whose port must be open. It must not
+         *   be used by anything else while the executor runs
+         */
+        explicit BusExecutor(DriverClass5_20& driver);
+
+        /** Deletes the tasks that did not complete
+         *
+         * The driver must not be used anymore in the non-blocking mode if
+         * it still has pending requests, as their callbacks refer to the
+         * executor
+         */
+        ~BusExecutor();
+
+        DriverClass5_20& getDriver();
+
+        /** Adds a task. The executor takes ownership, and deletes it when it
+         * completes. It first runs at the next call to run() or runOnce()
+         */
+        void spawn(BusTask* task);
+
+        /** Returns the number of tasks that did not complete yet */
+        size_t getTaskCount() const;
+
+        /** Sends a request on behalf of a task, and resumes it once the
+         * response is received or the request timed out
+         *
+         * On completion, the task's status and response are set
+         */
+        void transact(BusTask& task, DriverClass5_20::Request const& request);
+
+        /** Reads a channel on behalf of a task, and resumes it with the
+         * task's sample set
+         */
+        void readChannel(BusTask& task, DriverClass5_20::CHANNEL_ID channel, int device);
+
+        /** Resumes a task after the given duration */
+        void sleep(BusTask& task, base::Time const& duration);
+
+        /** Runs the tasks until they all completed
+         *
+         * An exception thrown by a task is passed on, see runOnce()
+         */
+        void run();
+
+        /** Runs the tasks that can run, waiting at most \c timeout for the
+         * port or a sleeping task
+         *
+         * An exception thrown by a task is passed on after the task got
+         * deleted. The other tasks are not affected, and keep running at
+         * the next call
+         *
+         * @return false if there are no tasks left
+         */
+        bool runOnce(base::Time const& timeout);
+    };
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include <pressure_velki/BusScheduler.hpp>
+#include <pressure_velki/Errors.hpp>
+#include <base/Logging.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace pressure_velki;
+using namespace std;
+
+BusScheduler::BusScheduler()
+    : minBackoff(base::Time::fromMilliseconds(100))
+    , maxBackoff(base::Time::fromSeconds(5))
+    , statisticsStart(base::Time::now())
+{
+}
+
+DriverClass5_20& BusScheduler::getDriver()
+{
+    return driver;
+}
+
+void BusScheduler::addDevice(int address, Channels const& channels, double rate, int weight)
+{
+    if (findDevice(address))
+        throw std::logic_error("device already added to the scheduler");
+    if (channels.empty())
+        throw std::logic_error("no channels to read");
+    if (rate < 0 || weight <= 0)
+        throw std::logic_error("invalid rate or weight");
+
+    Device device;
+    device.address = address;
+    device.channels = channels;
+    device.rate = rate;
+    device.weight = weight;
+    device.currentWeight = 0;
+    if (rate > 0)
+        device.period = base::Time::fromSeconds(1.0 / rate);
+    device.deadline = base::Time::now();
+    device.successes = 0;
+    device.timeouts = 0;
+    device.poweringUp = 0;
+    device.errors = 0;
+    devices.push_back(device);
+}
+
+void BusScheduler::removeDevice(int address)
+{
+    for (vector<Device>::iterator it = devices.begin(); it != devices.end(); ++it)
+    {
+        if (it->address == address)
+        {
+            devices.erase(it);
+            return;
+        }
+    }
+}
+
+void BusScheduler::setBackoff(base::Time const& min, base::Time const& max)
+{
+    minBackoff = min;
+    maxBackoff = max;
+}
+
+BusScheduler::Device* BusScheduler::findDevice(int address)
+{
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        if (devices[i].address == address)
+            return &devices[i];
+    }
+    return 0;
+}
+
+BusScheduler::Device* BusScheduler::selectNextDevice(base::Time const& now, base::Time& wakeup)
+{
+    // Earliest deadline first among the rate-limited devices that are due
+    Device* earliest = 0;
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        Device& device = devices[i];
+        if (device.rate == 0)
+            continue;
+
+        base::Time due = std::max(device.deadline, device.backoffUntil);
+        if (due <= now)
+        {
+            if (!earliest || device.deadline < earliest->deadline)
+                earliest = &device;
+        }
+        else if (wakeup.isNull() || due < wakeup)
+            wakeup = due;
+    }
+    if (earliest)
+        return earliest;
+
+    Device* free_running = selectRoundRobin(now);
+    if (free_running)
+        return free_running;
+
+    // Nothing can be polled right now. Wake up for whichever comes first: a
+    // rate-limited device or the end of a back-off period
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        if (devices[i].rate == 0 && (wakeup.isNull() || devices[i].backoffUntil < wakeup))
+            wakeup = devices[i].backoffUntil;
+    }
+    return 0;
+}
+
+BusScheduler::Device* BusScheduler::selectRoundRobin(base::Time const& now)
+{
+    // Smooth weighted round-robin: each available device accumulates its
+    // weight, and the device with the highest accumulated weight wins and
+    // gets the total weight removed.
+    Device* selected = 0;
+    int total_weight = 0;
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        Device& device = devices[i];
+        if (device.rate != 0 || device.backoffUntil > now)
+            continue;
+
+        device.currentWeight += device.weight;
+        total_weight += device.weight;
+        if (!selected || device.currentWeight > selected->currentWeight)
+            selected = &device;
+    }
+    if (selected)
+        selected->currentWeight -= total_weight;
+    return selected;
+}
+
+BusScheduler::PollResult BusScheduler::poll()
+{
+    if (devices.empty())
+        throw std::logic_error("no devices to poll");
+
+    while (true)
+    {
+        base::Time now = base::Time::now();
+        base::Time wakeup;
+        Device* device = selectNextDevice(now, wakeup);
+        if (device)
+            return pollDevice(*device);
+
+        if (wakeup > now)
+            usleep((wakeup - now).toMicroseconds());
+    }
+}
+
+BusScheduler::PollResult BusScheduler::pollDevice(Device& device)
+{
+    PollResult result;
+    result.device = device.address;
+    result.channels = device.channels;
+    result.status = POLL_OK;
+
+    driver.tryReadChannels(device.channels, samples, device.address);
+    int error = 0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        Sample const& sample = samples[i];
+        if (sample.status == Sample::STATUS_TIMEOUT)
+            result.status = POLL_TIMEOUT;
+        else if (sample.status == Sample::STATUS_DEVICE_ERROR && result.status != POLL_TIMEOUT)
+        {
+            result.status = POLL_DEVICE_ERROR;
+            error = sample.error;
+        }
+        else if (sample.status == Sample::STATUS_POWERING_UP && result.status == POLL_OK)
+            result.status = POLL_POWERING_UP;
+    }
+
+    switch(result.status)
+    {
+        case POLL_OK:
+            for (size_t i = 0; i < samples.size(); ++i)
+                result.values.push_back(samples[i].value);
+            break;
+        case POLL_TIMEOUT:
+            LOG_WARN_S << "timeout while polling device " << device.address;
+            ++device.timeouts;
+            // Drop whatever partial response we got, it would only confuse
+            // the next transaction
+            driver.clear();
+            break;
+        case POLL_POWERING_UP:
+            ++device.poweringUp;
+            break;
+        case POLL_DEVICE_ERROR:
+            LOG_WARN_S << "device " << device.address << " returned an error: "
+                << Error::errorMessage(DriverClass5_20::FUNCTION_READ_CHANNEL, static_cast<Error::ERROR_CODE>(error));
+            ++device.errors;
+            break;
+    }
+    result.time = base::Time::now();
+
+    if (result.status == POLL_TIMEOUT || result.status == POLL_POWERING_UP)
+    {
+        if (device.backoff.isNull())
+            device.backoff = minBackoff;
+        else
+            device.backoff = std::min(device.backoff * 2, maxBackoff);
+        device.backoffUntil = result.time + device.backoff;
+    }
+    else
+    {
+        device.backoff = base::Time();
+        device.backoffUntil = base::Time();
+    }
+
+    if (result.status == POLL_OK)
+        ++device.successes;
+
+    if (device.rate > 0)
+    {
+        device.deadline = device.deadline + device.period;
+        // Do not try to catch up on missed deadlines, that would only starve
+        // the other devices
+        if (device.deadline < result.time)
+            device.deadline = result.time;
+    }
+    return result;
+}
+
+vector<BusScheduler::DeviceStatistics> BusScheduler::getStatistics() const
+{
+    double duration = (base::Time::now() - statisticsStart).toSeconds();
+
+    vector<DeviceStatistics> result;
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        Device const& device = devices[i];
+        DeviceStatistics stats;
+        stats.device = device.address;
+        stats.requestedRate = device.rate;
+        stats.achievedRate = (duration > 0) ? device.successes / duration : 0;
+        stats.successes = device.successes;
+        stats.timeouts = device.timeouts;
+        stats.poweringUp = device.poweringUp;
+        stats.errors = device.errors;
+        stats.backoffUntil = device.backoffUntil;
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void BusScheduler::resetStatistics()
+{
+    statisticsStart = base::Time::now();
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        devices[i].successes = 0;
+        devices[i].timeouts = 0;
+        devices[i].poweringUp = 0;
+        devices[i].errors = 0;
+    }
+}
+
@@ -0,0 +1,151 @@
+#ifndef PRESSURE_VELKI_BUS_SCHEDULER_HPP
+#define PRESSURE_VELKI_BUS_SCHEDULER_HPP
+
+#include <vector>
+#include <base/Time.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+
+namespace pressure_velki
+{
+    /** Polls a set of devices that share the same RS-485 bus
+     *
+     * The scheduler owns the driver, and decides which device gets the bus
+     * next. Devices registered with a rate are polled with an earliest
+     * deadline first policy. Devices registered with a rate of zero are polled
+     * as fast as the bus allows, whenever no rate-limited device is due. The
+     * bus time is then shared between them in proportion of their weights
+     * (weighted round-robin).
+     *
+     * Devices that time out or report that they are powering up are backed
+     * off exponentially, so that they do not waste bus time that the other
+     * devices could use.
+     */
+    class BusScheduler
+    {
+    public:
+        typedef std::vector<DriverClass5_20::CHANNEL_ID> Channels;
+
+        enum POLL_STATUS
+        {
+            POLL_OK,
+            POLL_TIMEOUT,
+            POLL_POWERING_UP,
+            POLL_DEVICE_ERROR
+        };
+
+        /** The outcome of a single poll */
+        struct PollResult
+        {
+            /** The device that got polled */
+            int device;
+            /** The time at which the response got received */
+            base::Time time;
+            POLL_STATUS status;
+            /** The channels that were read */
+            Channels channels;
+            /** The channel values, in the same order than \c channels. It is
+             * empty unless status is POLL_OK
+             */
+            std::vector<float> values;
+        };
+
+        /** Per-device statistics */
+        struct DeviceStatistics
+        {
+            int device;
+            /** The rate requested in addDevice, zero for free-running devices */
+            double requestedRate;
+            /** The rate of successful polls since the last call to
+             * resetStatistics()
+             */
+            double achievedRate;
+            int successes;
+            int timeouts;
+            int poweringUp;
+            int errors;
+            /** The device won't be polled before this time */
+            base::Time backoffUntil;
+        };
+
+    private:
+        struct Device
+        {
+            int address;
+            Channels channels;
+            double rate;
+            int weight;
+            int currentWeight;
+            base::Time period;
+            base::Time deadline;
+            base::Time backoff;
+            base::Time backoffUntil;
+            int successes;
+            int timeouts;
+            int poweringUp;
+            int errors;
+        };
+
+        DriverClass5_20 driver;
+        std::vector<Device> devices;
+        /** Buffer for the samples read by pollDevice */
+        std::vector<Sample> samples;
+        base::Time minBackoff;
+        base::Time maxBackoff;
+        base::Time statisticsStart;
+
+        Device* findDevice(int address);
+        Device* selectNextDevice(base::Time const& now, base::Time& wakeup);
+        Device* selectRoundRobin(base::Time const& now);
+        PollResult pollDevice(Device& device);
+
+    public:
+        BusScheduler();
+
+        /** The driver used to talk to the devices
+         *
+         * Use it to open the port. It should not be used by anything else
+         * while the scheduler runs.
+         */
+        DriverClass5_20& getDriver();
+
+        /** Adds a device to the polling set
+         *
+         * @param device the device address
+         * @param channels the channels that should be read at each poll
+         * @param rate the requested poll rate in Hz. Set to zero to poll the
+         *   device as fast as the bus allows
+         * @param weight for devices with a zero rate, the relative share of the
+         *   bus time left by the rate-limited devices
+         */
+        void addDevice(int device, Channels const& channels, double rate, int weight = 1);
+
+        /** Removes a device from the polling set */
+        void removeDevice(int device);
+
+        /** Sets the bounds of the exponential back-off applied to devices
+         * that time out or are powering up
+         *
+         * The defaults are 100ms and 5s
+         */
+        void setBackoff(base::Time const& min, base::Time const& max);
+
+        /** Polls the next device
+         *
+         * It waits until a device is due if none is due yet.
+         *
+         * @throw std::logic_error if no device has been added
+         */
+        PollResult poll();
+
+        /** Returns the statistics of all devices, in the order in which they
+         * have been added
+         */
+        std::vector<DeviceStatistics> getStatistics() const;
+
+        /** Resets the statistics returned by getStatistics() */
+        void resetStatistics();
+    };
+}
+
+#endif
+
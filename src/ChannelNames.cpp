@@ -0,0 +1,29 @@
+#include "ChannelNames.hpp"
+#include <sstream>
+
+using namespace std;
+
+namespace pressure_velki
+{
+    char const* const CHANNEL_NAMES[6] = { "calc", "p0", "p1", "t", "t0", "t1" };
+
+    bool parseChannels(string const& spec, vector<DriverClass5_20::CHANNEL_ID>& channels)
+    {
+        channels.clear();
+        istringstream stream(spec);
+        string name;
+        while (getline(stream, name, ','))
+        {
+            int id = -1;
+            for (int i = 0; i < 6; ++i)
+            {
+                if (name == CHANNEL_NAMES[i])
+                    id = i;
+            }
+            if (id == -1)
+                return false;
+            channels.push_back(static_cast<DriverClass5_20::CHANNEL_ID>(id));
+        }
+        return !channels.empty();
+    }
+}
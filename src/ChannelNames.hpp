@@ -0,0 +1,22 @@
+#ifndef PRESSURE_VELKI_CHANNEL_NAMES_HPP
+#define PRESSURE_VELKI_CHANNEL_NAMES_HPP
+
+#include <string>
+#include <vector>
+#include <pressure_velki/DriverClass5_20.hpp>
+
+namespace pressure_velki
+{
+    /** The names of the channels on the command line of the tools, indexed
+     * by DriverClass5_20::CHANNEL_ID
+     */
+    extern char const* const CHANNEL_NAMES[6];
+
+    /** Parses a comma-separated list of channel names
+     *
+     * @return false if a name is unknown or if the list is empty
+     */
+    bool parseChannels(std::string const& spec, std::vector<DriverClass5_20::CHANNEL_ID>& channels);
+}
+
+#endif
@@ -0,0 +1,249 @@
+#include <pressure_velki/ChannelReducer.hpp>
+#include <base/Float.hpp>
+#include <stdexcept>
+
+using namespace pressure_velki;
+using namespace std;
+using boost::uint64_t;
+
+ChannelReducer::Queue::Queue(int capacity)
+    : items(capacity)
+    , head(0)
+    , size(0)
+{
+}
+
+void ChannelReducer::Queue::clear()
+{
+    head = 0;
+    size = 0;
+}
+
+uint64_t ChannelReducer::Queue::front() const
+{
+    return items[head];
+}
+
+uint64_t ChannelReducer::Queue::back() const
+{
+    return items[(head + size - 1) % items.size()];
+}
+
+void ChannelReducer::Queue::popFront()
+{
+    head = (head + 1) % items.size();
+    --size;
+}
+
+void ChannelReducer::Queue::popBack()
+{
+    --size;
+}
+
+void ChannelReducer::Queue::pushBack(uint64_t seq)
+{
+    items[(head + size) % items.size()] = seq;
+    ++size;
+}
+
+ChannelReducer::ChannelReducer(int windowSize, double alpha)
+    : windowSize(windowSize)
+    , alpha(alpha)
+    , values(windowSize)
+    , minimums(windowSize)
+    , maximums(windowSize)
+{
+    if (windowSize <= 0)
+        throw std::invalid_argument("the window size must be strictly positive");
+    reset();
+}
+
+void ChannelReducer::reset()
+{
+    count = 0;
+    validCount = 0;
+    mean = 0;
+    m2 = 0;
+    smoothed = 0;
+    hasSmoothed = false;
+    minimums.clear();
+    maximums.clear();
+}
+
+float ChannelReducer::valueAt(uint64_t seq) const
+{
+    return values[seq % windowSize];
+}
+
+void ChannelReducer::push(float value)
+{
+    uint64_t seq = count++;
+
+    // Remove the value that leaves the window from the running mean and
+    // variance
+    if (seq >= static_cast<uint64_t>(windowSize))
+    {
+        float old = valueAt(seq);
+        if (!base::isUnknown(old))
+        {
+            if (--validCount == 0)
+            {
+                mean = 0;
+                m2 = 0;
+            }
+            else
+            {
+                double delta = old - mean;
+                mean -= delta / validCount;
+                m2 -= delta * (old - mean);
+            }
+        }
+
+        uint64_t first = seq - windowSize + 1;
+        if (minimums.size && minimums.front() < first)
+            minimums.popFront();
+        if (maximums.size && maximums.front() < first)
+            maximums.popFront();
+    }
+    values[seq % windowSize] = value;
+
+    if (base::isUnknown(value))
+        return;
+
+    ++validCount;
+    double delta = value - mean;
+    mean += delta / validCount;
+    m2 += delta * (value - mean);
+
+    while (minimums.size && valueAt(minimums.back()) >= value)
+        minimums.popBack();
+    minimums.pushBack(seq);
+    while (maximums.size && valueAt(maximums.back()) <= value)
+        maximums.popBack();
+    maximums.pushBack(seq);
+
+    if (hasSmoothed)
+        smoothed += alpha * (value - smoothed);
+    else
+        smoothed = value;
+    hasSmoothed = true;
+}
+
+int ChannelReducer::getWindowCount() const
+{
+    return count < static_cast<uint64_t>(windowSize) ? count : windowSize;
+}
+
+int ChannelReducer::getValidCount() const
+{
+    return validCount;
+}
+
+float ChannelReducer::getMean() const
+{
+    if (validCount == 0)
+        return base::unknown<float>();
+    return mean;
+}
+
+float ChannelReducer::getVariance() const
+{
+    if (validCount == 0)
+        return base::unknown<float>();
+    // Removals may leave a tiny negative rounding error
+    return m2 > 0 ? m2 / validCount : 0;
+}
+
+float ChannelReducer::getMin() const
+{
+    if (validCount == 0)
+        return base::unknown<float>();
+    return valueAt(minimums.front());
+}
+
+float ChannelReducer::getMax() const
+{
+    if (validCount == 0)
+        return base::unknown<float>();
+    return valueAt(maximums.front());
+}
+
+float ChannelReducer::getSmoothed() const
+{
+    if (!hasSmoothed)
+        return base::unknown<float>();
+    return smoothed;
+}
+
+SampleReducer::Channel::Channel(int windowSize, double alpha)
+    : reducer(windowSize, alpha)
+    , invalidCount(0)
+{
+}
+
+SampleReducer::SampleReducer(int windowSize, double alpha, base::Time const& outputPeriod)
+    : windowSize(windowSize)
+    , alpha(alpha)
+    , outputPeriod(outputPeriod)
+{
+}
+
+bool SampleReducer::push(Sample const& sample, ReducedSample& output)
+{
+    pair<int, int> key(sample.device, sample.channel);
+    map<pair<int, int>, Channel>::iterator it = channels.find(key);
+    if (it == channels.end())
+    {
+        it = channels.insert(make_pair(key, Channel(windowSize, alpha))).first;
+        it->second.nextOutput = sample.time;
+    }
+
+    Channel& channel = it->second;
+    float value = sample.isValid() ? sample.value : base::unknown<float>();
+    if (base::isUnknown(value))
+        ++channel.invalidCount;
+    channel.reducer.push(value);
+
+    if (sample.time < channel.nextOutput)
+        return false;
+
+    ChannelReducer const& reducer = channel.reducer;
+    output.time = sample.time;
+    output.device = sample.device;
+    output.channel = sample.channel;
+    output.mean = reducer.getMean();
+    output.variance = reducer.getVariance();
+    output.min = reducer.getMin();
+    output.max = reducer.getMax();
+    output.smoothed = reducer.getSmoothed();
+    output.windowCount = reducer.getWindowCount();
+    output.validCount = reducer.getValidCount();
+    output.invalidCount = channel.invalidCount;
+
+    channel.invalidCount = 0;
+    channel.nextOutput = channel.nextOutput + outputPeriod;
+    // Do not try to catch up after a gap in the data
+    if (channel.nextOutput <= sample.time)
+        channel.nextOutput = sample.time + outputPeriod;
+    return true;
+}
+
+size_t SampleReducer::push(vector<Sample> const& samples, vector<ReducedSample>& outputs)
+{
+    size_t count = 0;
+    ReducedSample output;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        if (push(samples[i], output))
+        {
+            outputs.push_back(output);
+            ++count;
+        }
+    }
+    return count;
+}
+
+void SampleReducer::reset()
+{
+    channels.clear();
+}
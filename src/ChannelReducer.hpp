@@ -0,0 +1,164 @@
+#ifndef PRESSURE_VELKI_CHANNEL_REDUCER_HPP
+#define PRESSURE_VELKI_CHANNEL_REDUCER_HPP
+
+#include <map>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <pressure_velki/Sample.hpp>
+
+namespace pressure_velki
+{
+    /** Streaming statistics of a single channel
+     *
+     * It maintains, over a sliding window of the last N values, the mean and
+     * variance (Welford's algorithm, updated on both insertion and removal)
+     * and the minimum and maximum (monotonic queues), as well as an
+     * exponential moving average of all values. All memory is allocated at
+     * construction, and each value is processed in amortized constant time.
+     *
+     * Invalid values (NaN, as returned on saturation or channel errors)
+     * take their place in the window but are ignored by the statistics.
+     */
+    class ChannelReducer
+    {
+        int windowSize;
+        double alpha;
+
+        /** The values in the window, indexed by sequence number modulo
+         * windowSize
+         */
+        std::vector<float> values;
+        boost::uint64_t count;
+
+        int validCount;
+        double mean;
+        double m2;
+        double smoothed;
+        bool hasSmoothed;
+
+        /** Fixed-capacity double-ended queue of sequence numbers */
+        struct Queue
+        {
+            std::vector<boost::uint64_t> items;
+            int head;
+            int size;
+
+            explicit Queue(int capacity);
+            void clear();
+            boost::uint64_t front() const;
+            boost::uint64_t back() const;
+            void popFront();
+            void popBack();
+            void pushBack(boost::uint64_t seq);
+        };
+
+        /** Sequence numbers of the candidates for the minimum and maximum,
+         * with increasing (resp. decreasing) values
+         */
+        Queue minimums;
+        Queue maximums;
+
+        float valueAt(boost::uint64_t seq) const;
+
+    public:
+        /**
+         * @param windowSize the number of values in the sliding window
+         * @param alpha the weight of a new value in the exponential moving
+         *   average, between 0 and 1
+         */
+        ChannelReducer(int windowSize, double alpha);
+
+        /** Adds a value. NaN marks an invalid value */
+        void push(float value);
+
+        /** Removes all values */
+        void reset();
+
+        /** The number of values in the window, valid or not */
+        int getWindowCount() const;
+
+        /** The number of valid values in the window */
+        int getValidCount() const;
+
+        /** The statistics below are NaN if there are no valid values in the
+         * window
+         */
+        float getMean() const;
+        float getVariance() const;
+        float getMin() const;
+        float getMax() const;
+
+        /** The exponential moving average of all valid values so far */
+        float getSmoothed() const;
+    };
+
+    /** The output of SampleReducer */
+    struct ReducedSample
+    {
+        /** The time of the last sample taken into account */
+        base::Time time;
+        int device;
+        int channel;
+        /** Statistics over the sliding window, see ChannelReducer */
+        float mean;
+        float variance;
+        float min;
+        float max;
+        float smoothed;
+        int windowCount;
+        int validCount;
+        /** Number of invalid samples since the previous output */
+        int invalidCount;
+    };
+
+    /** Decimation of a stream of samples
+     *
+     * It feeds each channel's samples to a ChannelReducer, and outputs the
+     * channel's statistics once per output period.
+     */
+    class SampleReducer
+    {
+        int windowSize;
+        double alpha;
+        base::Time outputPeriod;
+
+        struct Channel
+        {
+            ChannelReducer reducer;
+            base::Time nextOutput;
+            int invalidCount;
+
+            Channel(int windowSize, double alpha);
+        };
+        std::map<std::pair<int, int>, Channel> channels;
+
+    public:
+        /**
+         * @param windowSize the size of the sliding window of each channel
+         * @param alpha the weight of new values in the exponential moving
+         *   average
+         * @param outputPeriod the period at which each channel's statistics
+         *   are output. Zero means one output per sample
+         */
+        SampleReducer(int windowSize, double alpha, base::Time const& outputPeriod);
+
+        /** Adds a sample
+         *
+         * @return true if the sample completed an output period, in which
+         *   case \c output is set
+         */
+        bool push(Sample const& sample, ReducedSample& output);
+
+        /** Adds samples, and appends the resulting outputs to \c outputs
+         *
+         * @return the number of outputs added
+         */
+        size_t push(std::vector<Sample> const& samples, std::vector<ReducedSample>& outputs);
+
+        /** Forgets all channels */
+        void reset();
+    };
+}
+
+#endif
+
@@ -0,0 +1,153 @@
+#include <pressure_velki/Crc16.hpp>
+#include <stdexcept>
+
+using namespace pressure_velki;
+using boost::uint8_t;
+using boost::uint16_t;
+
+#ifndef PRESSURE_VELKI_CRC16_DEFAULT_ENGINE
+#define PRESSURE_VELKI_CRC16_DEFAULT_ENGINE ENGINE_SLICE_BY_8
+#endif
+
+namespace
+{
+    /** Lookup tables for the table-driven engines
+     *
+     * table[0][n] is the CRC of the byte n. table[k][n] is the CRC of the byte
+     * n followed by k zero bytes, which is what is needed to process k + 1
+     * bytes in a single step.
+     */
+    struct Tables
+    {
+        uint16_t table[8][256];
+
+        Tables()
+        {
+            for (int n = 0; n < 256; ++n)
+            {
+                uint16_t crc = n;
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc & 0x1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+                table[0][n] = crc;
+            }
+            for (int k = 1; k < 8; ++k)
+            {
+                for (int n = 0; n < 256; ++n)
+                {
+                    uint16_t previous = table[k - 1][n];
+                    table[k][n] = (previous >> 8) ^ table[0][previous & 0xFF];
+                }
+            }
+        }
+    };
+
+    Tables const& tables()
+    {
+        static Tables const tables;
+        return tables;
+    }
+
+    // I've tried to use boost's CRC implementation, but could not manage to
+    // configure it to match the CRC expected by Velki. This is the CRC
+    // calculation from the Velki docs.
+    uint16_t updateBitwise(uint16_t crc, uint8_t const* begin, uint8_t const* end)
+    {
+        for (uint8_t const* it = begin; it != end; ++it)
+        {
+            crc ^= *it;
+            for (int n = 0; n < 8; ++n)
+            {
+                if (crc & 0x1)
+                {
+                    crc >>= 1;
+                    crc ^= 0xA001;
+                }
+                else
+                {
+                    crc >>= 1;
+                }
+            }
+        }
+        return crc;
+    }
+
+    uint16_t updateTable(uint16_t crc, uint8_t const* begin, uint8_t const* end)
+    {
+        uint16_t const* table = tables().table[0];
+        for (uint8_t const* it = begin; it != end; ++it)
+            crc = (crc >> 8) ^ table[(crc ^ *it) & 0xFF];
+        return crc;
+    }
+
+    uint16_t updateSliceBy4(uint16_t crc, uint8_t const* begin, uint8_t const* end)
+    {
+        uint16_t const (*table)[256] = tables().table;
+        uint8_t const* it = begin;
+        for (; end - it >= 4; it += 4)
+        {
+            crc = table[3][(it[0] ^ crc) & 0xFF] ^
+                table[2][(it[1] ^ (crc >> 8)) & 0xFF] ^
+                table[1][it[2]] ^
+                table[0][it[3]];
+        }
+        return updateTable(crc, it, end);
+    }
+
+    uint16_t updateSliceBy8(uint16_t crc, uint8_t const* begin, uint8_t const* end)
+    {
+        uint16_t const (*table)[256] = tables().table;
+        uint8_t const* it = begin;
+        for (; end - it >= 8; it += 8)
+        {
+            crc = table[7][(it[0] ^ crc) & 0xFF] ^
+                table[6][(it[1] ^ (crc >> 8)) & 0xFF] ^
+                table[5][it[2]] ^
+                table[4][it[3]] ^
+                table[3][it[4]] ^
+                table[2][it[5]] ^
+                table[1][it[6]] ^
+                table[0][it[7]];
+        }
+        return updateSliceBy4(crc, it, end);
+    }
+
+    Crc16::ENGINE defaultEngine = Crc16::PRESSURE_VELKI_CRC16_DEFAULT_ENGINE;
+}
+
+uint16_t Crc16::compute(uint8_t const* begin, uint8_t const* end)
+{
+    return update(defaultEngine, INITIAL_VALUE, begin, end);
+}
+
+uint16_t Crc16::compute(ENGINE engine, uint8_t const* begin, uint8_t const* end)
+{
+    return update(engine, INITIAL_VALUE, begin, end);
+}
+
+uint16_t Crc16::update(uint16_t crc, uint8_t const* begin, uint8_t const* end)
+{
+    return update(defaultEngine, crc, begin, end);
+}
+
+uint16_t Crc16::update(ENGINE engine, uint16_t crc, uint8_t const* begin, uint8_t const* end)
+{
+    switch(engine)
+    {
+        case ENGINE_BITWISE: return updateBitwise(crc, begin, end);
+        case ENGINE_TABLE: return updateTable(crc, begin, end);
+        case ENGINE_SLICE_BY_4: return updateSliceBy4(crc, begin, end);
+        case ENGINE_SLICE_BY_8: return updateSliceBy8(crc, begin, end);
+    }
+    throw std::logic_error("invalid CRC16 engine");
+}
+
+void Crc16::setDefaultEngine(ENGINE engine)
+{
+    defaultEngine = engine;
+}
+
+Crc16::ENGINE Crc16::getDefaultEngine()
+{
+    return defaultEngine;
+}
+
@@ -0,0 +1,65 @@
+#ifndef PRESSURE_VELKI_CRC16_HPP
+#define PRESSURE_VELKI_CRC16_HPP
+
+#include <boost/cstdint.hpp>
+
+namespace pressure_velki
+{
+    /** CRC16 checksum as used by the Velki protocol
+     *
+     * This is the variant given in the Velki docs: reflected polynomial
+     * 0xA001, initial value 0xFFFF and no final XOR (also known as
+     * CRC-16/MODBUS).
+     *
+     * Several engines are available. They all compute the same value and only
+     * differ in speed. The bitwise engine is the reference from the Velki docs
+     * and is kept for cross-checking. The table-driven engines process one
+     * (ENGINE_TABLE), four or eight bytes per step.
+     */
+    class Crc16
+    {
+    public:
+        enum ENGINE
+        {
+            ENGINE_BITWISE,
+            ENGINE_TABLE,
+            ENGINE_SLICE_BY_4,
+            ENGINE_SLICE_BY_8
+        };
+
+        /** The value a CRC computation starts with */
+        static const boost::uint16_t INITIAL_VALUE = 0xFFFF;
+
+        /** Computes the CRC of [begin, end) with the default engine */
+        static boost::uint16_t compute(boost::uint8_t const* begin, boost::uint8_t const* end);
+
+        /** Computes the CRC of [begin, end) with the given engine */
+        static boost::uint16_t compute(ENGINE engine, boost::uint8_t const* begin, boost::uint8_t const* end);
+
+        /** Continues a CRC computation with the bytes in [begin, end)
+         *
+         * compute(begin, end) is update(INITIAL_VALUE, begin, end). The
+         * computation of a buffer can therefore be split into several calls.
+         */
+        static boost::uint16_t update(boost::uint16_t crc, boost::uint8_t const* begin, boost::uint8_t const* end);
+
+        /** Continues a CRC computation using the given engine */
+        static boost::uint16_t update(ENGINE engine, boost::uint16_t crc, boost::uint8_t const* begin, boost::uint8_t const* end);
+
+        /** Changes the engine used by compute() and update()
+         *
+         * The default is ENGINE_SLICE_BY_8. It can be changed at build time by
+         * defining PRESSURE_VELKI_CRC16_DEFAULT_ENGINE.
+         *
+         * This is not thread-safe. Change the engine before any driver is
+         * started.
+         */
+        static void setDefaultEngine(ENGINE engine);
+
+        /** Returns the engine used by compute() and update() */
+        static ENGINE getDefaultEngine();
+    };
+}
+
+#endif
+
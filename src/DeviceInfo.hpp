@@ -11,6 +11,28 @@ namespace pressure_velki
         int firmwareWeek;
         int internalBufferSize;
     };
+
+    /** What the driver knows about a device
+     *
+     * @see DriverClass5_20::getMetadata
+     */
+    struct DeviceMetadata
+    {
+        /** Whether \c info is known, i.e. the device has been initialized */
+        bool hasInfo;
+        DeviceInfo info;
+        bool hasSerialNumber;
+        int serialNumber;
+        bool hasAbsolute;
+        bool absolute;
+
+        DeviceMetadata()
+            : hasInfo(false)
+            , hasSerialNumber(false)
+            , serialNumber(0)
+            , hasAbsolute(false)
+            , absolute(false) {}
+    };
 }
 
 #endif
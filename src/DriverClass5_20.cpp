@@ -3,23 +3,219 @@
 #include <pressure_velki/Errors.hpp>
 #include <base/Logging.hpp>
 #include <base/Float.hpp>
+#include <algorithm>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 using namespace pressure_velki;
 using namespace std;
 
+DriverClass5_20::Request::Request()
+    : frame(0)
+    , address(0)
+    , function(FUNCTION_ECHO)
+    , responseSize(0)
+{
+}
+
+DriverClass5_20::Request::Request(int address, FUNCTIONS function, int responseSize,
+        RequestFrames::Frame const& frame)
+    : frame(&frame)
+    , address(address)
+    , function(function)
+    , responseSize(responseSize)
+{
+}
+
+DriverClass5_20::Request DriverClass5_20::Request::initialize(int device)
+{
+    return Request(device, FUNCTION_INITIALIZE, 6, RequestFrames::initialize(device));
+}
+
+DriverClass5_20::Request DriverClass5_20::Request::serialNumber(int device)
+{
+    return Request(device, FUNCTION_SERIAL_NUMBER, 4, RequestFrames::serialNumber(device));
+}
+
+DriverClass5_20::Request DriverClass5_20::Request::echo(int device)
+{
+    return Request(device, FUNCTION_ECHO, 4, RequestFrames::echo(device));
+}
+
+DriverClass5_20::Request DriverClass5_20::Request::isAbsolute(int device)
+{
+    return Request(device, FUNCTION_CONFIGURATION_READ, 1, RequestFrames::isAbsolute(device));
+}
+
+DriverClass5_20::Request DriverClass5_20::Request::readChannel(CHANNEL_ID channel, int device)
+{
+    return Request(device, FUNCTION_READ_CHANNEL, 5, RequestFrames::readChannel(channel, device));
+}
+
 DriverClass5_20::DriverClass5_20()
     : iodrivers_base::Driver(Packet::MAXIMUM_PACKET_SIZE)
+    , baudrate(0)
+    , minimumInterFrameSilence(base::Time::fromMilliseconds(1))
+    , recorder(0)
+    , trace(&defaultTrace)
+    , writeSize(0)
+    , writeFrameCount(1)
+    , responsesSinceWrite(0)
+    , firstByteReceived(true)
+    , adaptiveTimeoutEnabled(false)
+    , adaptiveTimeoutPercentile(0.99)
+    , adaptiveTimeoutMargin(base::Time::fromMilliseconds(5))
+    , maxRetries(0)
+    , asyncInFlight(false)
 {
     setWriteTimeout(base::Time::fromSeconds(1));
     setReadTimeout(base::Time::fromSeconds(1));
+    lateResponses.count = 0;
+    // Enough for the batched requests of readChannels, so that it does not
+    // allocate
+    writeBuffer.reserve(256);
+}
+
+void DriverClass5_20::openURI(string const& uri)
+{
+    iodrivers_base::Driver::openURI(uri);
+
+    if (uri.compare(0, 9, "serial://") == 0)
+    {
+        size_t colon = uri.rfind(':');
+        if (colon != string::npos && colon > 8)
+            setBaudrate(atoi(uri.c_str() + colon + 1));
+    }
+}
+
+void DriverClass5_20::setBaudrate(int baudrate)
+{
+    this->baudrate = baudrate;
+}
+
+int DriverClass5_20::getBaudrate() const
+{
+    return baudrate;
+}
+
+base::Time DriverClass5_20::getInterFrameSilence() const
+{
+    // The Velki docs specify a silence of 1ms between reception of data and
+    // sending again
+    base::Time minimum = minimumInterFrameSilence;
+    if (baudrate <= 0)
+        return minimum;
+
+    // 3.5 characters of 11 bits (start, 8 data bits, parity and stop)
+    base::Time silence = base::Time::fromSeconds(3.5 * 11 / baudrate);
+    return std::max(silence, minimum);
+}
+
+base::Time DriverClass5_20::getTransmissionTime(int bytes) const
+{
+    if (baudrate <= 0)
+        return base::Time();
+    return base::Time::fromSeconds(11.0 * bytes / baudrate);
+}
+
+void DriverClass5_20::setMinimumInterFrameSilence(base::Time const& silence)
+{
+    minimumInterFrameSilence = silence;
+}
+
+base::Time DriverClass5_20::getMinimumInterFrameSilence() const
+{
+    return minimumInterFrameSilence;
+}
+
+void DriverClass5_20::setAdaptiveTimeout(bool enable, double percentile, base::Time const& margin)
+{
+    adaptiveTimeoutEnabled = enable;
+    adaptiveTimeoutPercentile = percentile;
+    adaptiveTimeoutMargin = margin;
+    for (map<pair<int, int>, AdaptiveTimeout>::iterator it = responseTimes.begin(); it != responseTimes.end(); ++it)
+        it->second.setPercentile(percentile);
+}
+
+bool DriverClass5_20::isAdaptiveTimeoutEnabled() const
+{
+    return adaptiveTimeoutEnabled;
+}
+
+void DriverClass5_20::setConversionDelay(int device, base::Time const& delay, base::Time const& uncertainty)
+{
+    timestampEstimators[device].setConversionDelay(delay, uncertainty);
+}
+
+base::Time DriverClass5_20::getProcessingDelay(int device) const
+{
+    map<int, TimestampEstimator>::const_iterator it = timestampEstimators.find(device);
+    if (it == timestampEstimators.end())
+        return base::Time();
+    return it->second.getProcessingDelay();
+}
+
+base::Time DriverClass5_20::getResponseTimeout(int device, int function) const
+{
+    if (!adaptiveTimeoutEnabled)
+        return getReadTimeout();
+
+    map<pair<int, int>, AdaptiveTimeout>::const_iterator it =
+        responseTimes.find(make_pair(device, function));
+    if (it == responseTimes.end())
+        return getReadTimeout();
+    return it->second.getTimeout(adaptiveTimeoutMargin, getReadTimeout());
+}
+
+void DriverClass5_20::setMaxRetries(int retries)
+{
+    maxRetries = retries;
+}
+
+int DriverClass5_20::getMaxRetries() const
+{
+    return maxRetries;
+}
+
+void DriverClass5_20::setTrace(TraceRing* trace)
+{
+    this->trace = trace ? trace : &defaultTrace;
+}
+
+TraceRing& DriverClass5_20::getTrace() const
+{
+    return *trace;
+}
+
+void DriverClass5_20::setRecorder(FrameRecorder* recorder)
+{
+    this->recorder = recorder;
+}
+
+void DriverClass5_20::waitInterFrameSilence()
+{
+    if (lastReceptionTime.isNull())
+        return;
+
+    base::Time elapsed = base::Time::now() - lastReceptionTime;
+    base::Time silence = getInterFrameSilence();
+    if (elapsed < silence)
+        usleep((silence - elapsed).toMicroseconds());
 }
 
 DeviceInfo DriverClass5_20::initialize(int device)
 {
-    Packet packet(device, FUNCTION_INITIALIZE);
-    writePacket(packet);
-    Packet response = readResponse(device, FUNCTION_INITIALIZE, 6);
-    
+    DeviceInfo info = parseInitialize(transact(Request::initialize(device)));
+    DeviceMetadata& cache = metadata[device];
+    cache = DeviceMetadata();
+    cache.hasInfo = true;
+    cache.info = info;
+    return info;
+}
+
+DeviceInfo DriverClass5_20::parseInitialize(PacketView const& response)
+{
     DeviceInfo info;
     info.deviceClass = response[0];
     info.deviceGroup = response[1];
@@ -31,10 +227,47 @@ DeviceInfo DriverClass5_20::initialize(int device)
 
 int DriverClass5_20::getSerialNumber(int device)
 {
-    Packet packet(device, FUNCTION_SERIAL_NUMBER);
-    writePacket(packet);
-    Packet response = readResponse(device, FUNCTION_SERIAL_NUMBER, 4);
+    map<int, DeviceMetadata>::const_iterator it = metadata.find(device);
+    if (it != metadata.end() && it->second.hasSerialNumber)
+        return it->second.serialNumber;
+
+    int serialNumber = parseSerialNumber(transact(Request::serialNumber(device)));
+    DeviceMetadata& cache = metadata[device];
+    cache.hasSerialNumber = true;
+    cache.serialNumber = serialNumber;
+    return serialNumber;
+}
 
+bool DriverClass5_20::verifySerialNumber(int device)
+{
+    int serialNumber = parseSerialNumber(transact(Request::serialNumber(device)));
+    DeviceMetadata& cache = metadata[device];
+    bool match = !cache.hasSerialNumber || cache.serialNumber == serialNumber;
+    if (!match)
+    {
+        LOG_WARN_S << "serial number of device " << device << " changed, clearing its metadata";
+        cache = DeviceMetadata();
+    }
+    cache.hasSerialNumber = true;
+    cache.serialNumber = serialNumber;
+    return match;
+}
+
+DeviceMetadata DriverClass5_20::getMetadata(int device) const
+{
+    map<int, DeviceMetadata>::const_iterator it = metadata.find(device);
+    if (it == metadata.end())
+        return DeviceMetadata();
+    return it->second;
+}
+
+void DriverClass5_20::invalidateMetadata(int device)
+{
+    metadata.erase(device);
+}
+
+int DriverClass5_20::parseSerialNumber(PacketView const& response)
+{
     return static_cast<int>(response[0]) << 24 |
         static_cast<int>(response[1]) << 16 |
         static_cast<int>(response[2]) << 8 |
@@ -61,49 +294,209 @@ float DriverClass5_20::readTemperatureOfPressureSensor(int id, int device)
 
 float DriverClass5_20::readChannel(CHANNEL_ID id, int device)
 {
-    Packet packet(device, FUNCTION_READ_CHANNEL);
-    packet.addByte(id);
-    writePacket(packet);
-    Packet response = readResponse(device, FUNCTION_READ_CHANNEL, 5);
+    Sample sample = tryReadChannel(id, device);
+    if (sample.status == Sample::STATUS_TIMEOUT || sample.status == Sample::STATUS_DEVICE_ERROR)
+        throwFailure(sample.status, device, FUNCTION_READ_CHANNEL, sample.error);
+    return checkChannelStatus(sample.status, id, device, sample.value);
+}
 
-    float value = Packet::parseFloat(&response[0]);
-    int stat = response[4];
-    if (stat & 0x8) // not ready
-        throw PoweringUp(device);
-    else if (stat & 0x7)
+Sample DriverClass5_20::tryReadChannel(CHANNEL_ID id, int device)
+{
+    PacketView response;
+    Sample::STATUS status = tryTransact(Request::readChannel(id, device), response);
+    return decodeChannelSample(id, device, status, response);
+}
+
+Sample DriverClass5_20::decodeChannelSample(CHANNEL_ID id, int device,
+        Sample::STATUS status, PacketView const& response)
+{
+    Sample sample;
+    sample.device = device;
+    sample.channel = id;
+    sample.status = status;
+    if (status == Sample::STATUS_TIMEOUT)
     {
-        LOG_WARN_S << "saturated analog input on device " << device;
-        return base::unknown<float>();
+        sample.time = base::Time::now();
+        return sample;
     }
-    else if (stat & id)
+
+    sample.time = lastSampleTime;
+    sample.timeUncertainty = lastSampleUncertainty;
+    if (status == Sample::STATUS_DEVICE_ERROR)
+        sample.error = response.getErrorCode();
+    else
+    {
+        sample.status = decodeChannel(id, response, sample.value);
+        if (sample.status == Sample::STATUS_POWERING_UP)
+            ++statistics.poweringUp;
+    }
+    return sample;
+}
+
+Sample DriverClass5_20::tryReadPressure(int id, int device)
+{
+    if (id < 0 || id > 1)
     {
-        LOG_WARN_S << "measure or computation error on channel " << id << " on device " << device;
-        return base::unknown<float>();
+        Sample sample;
+        sample.time = base::Time::now();
+        sample.device = device;
+        sample.channel = id;
+        sample.status = Sample::STATUS_CHANNEL_ERROR;
+        return sample;
     }
+    return tryReadChannel(static_cast<CHANNEL_ID>(CHANNEL_PRESSURE0 + id), device);
+}
+
+vector<float> DriverClass5_20::readChannels(vector<CHANNEL_ID> const& channels, int device)
+{
+    vector<Sample> samples;
+    readChannels(channels, samples, device);
+
+    vector<float> values;
+    values.reserve(samples.size());
+    for (size_t i = 0; i < samples.size(); ++i)
+        values.push_back(checkChannelStatus(samples[i].status, channels[i], device, samples[i].value));
+    return values;
+}
+
+void DriverClass5_20::readChannels(vector<CHANNEL_ID> const& channels, vector<Sample>& samples, int device)
+{
+    tryReadChannels(channels, samples, device);
+
+    // Report the first failure. A timeout ends the reads, so only device
+    // errors can precede it
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        if (samples[i].status == Sample::STATUS_DEVICE_ERROR ||
+                samples[i].status == Sample::STATUS_TIMEOUT)
+            throwFailure(samples[i].status, device, FUNCTION_READ_CHANNEL, samples[i].error);
+    }
+}
+
+void DriverClass5_20::tryReadChannels(vector<CHANNEL_ID> const& channels, vector<Sample>& samples, int device)
+{
+    waitLateResponses();
+    samples.clear();
+    writeBuffer.clear();
+    for (size_t i = 0; i < channels.size(); ++i)
+    {
+        RequestFrames::Frame const& frame = RequestFrames::readChannel(channels[i], device);
+        writeBuffer.insert(writeBuffer.end(), frame.data, frame.data + frame.size);
+    }
+    flushWriteBuffer(channels.size());
+    base::Time transactionStart = writeStartTime;
+
+    // Each response is decoded as soon as it is received, as the next read
+    // reuses the receive buffer. All responses are consumed even if one of
+    // them is an exception, so that they do not get mistaken for the
+    // responses to the next requests
+    //
+    // On timeout, the requests whose responses are missing are sent again
+    size_t frameSize = channels.empty() ? 0 : writeBuffer.size() / channels.size();
+    int retries = 0;
+    bool lateDuplicates = false;
+    for (size_t i = 0; i < channels.size(); ++i)
+    {
+        Sample sample;
+        sample.device = device;
+        sample.channel = channels[i];
+
+        PacketView response;
+        sample.status = receiveResponseWithRetries(device, FUNCTION_READ_CHANNEL, 5,
+                &writeBuffer[i * frameSize], (channels.size() - i) * frameSize,
+                retries, response);
+        if (retries && sample.status != Sample::STATUS_TIMEOUT)
+            lateDuplicates = true;
+
+        if (sample.status == Sample::STATUS_TIMEOUT)
+        {
+            sample.time = base::Time::now();
+            for (; i < channels.size(); ++i)
+            {
+                sample.channel = channels[i];
+                samples.push_back(sample);
+            }
+            break;
+        }
+
+        samples.push_back(decodeChannelSample(channels[i], device, sample.status, response));
+    }
+
+    if (lateDuplicates)
+        discardDuplicateResponses(device, FUNCTION_READ_CHANNEL, 5, transactionStart);
+}
 
+float DriverClass5_20::parseChannel(CHANNEL_ID id, int device, PacketView const& response)
+{
+    float value;
+    Sample::STATUS status = decodeChannel(id, response, value);
+    return checkChannelStatus(status, id, device, value);
+}
+
+float DriverClass5_20::checkChannelStatus(Sample::STATUS status, CHANNEL_ID id, int device, float value)
+{
+    switch(status)
+    {
+        case Sample::STATUS_POWERING_UP:
+            throw PoweringUp(device);
+        case Sample::STATUS_SATURATED:
+            LOG_WARN_S << "saturated analog input on device " << device;
+            break;
+        case Sample::STATUS_CHANNEL_ERROR:
+            LOG_WARN_S << "measure or computation error on channel " << id << " on device " << device;
+            break;
+        default:
+            break;
+    }
     return value;
 }
 
+Sample::STATUS DriverClass5_20::decodeChannel(CHANNEL_ID id, PacketView const& response, float& value)
+{
+    int stat = response[4];
+    Sample::STATUS status = Sample::STATUS_OK;
+    if (stat & 0x8) // not ready
+        status = Sample::STATUS_POWERING_UP;
+    else if (stat & 0x7)
+        status = Sample::STATUS_SATURATED;
+    else if (stat & id)
+        status = Sample::STATUS_CHANNEL_ERROR;
+
+    if (status == Sample::STATUS_OK)
+        value = Packet::parseFloat(&response[0]);
+    else
+        value = base::unknown<float>();
+    return status;
+}
+
 bool DriverClass5_20::isAbsolute(int device)
 {
-    Packet packet(device, FUNCTION_CONFIGURATION_READ);
-    packet.addByte(14);
-    writePacket(packet);
-    Packet response = readResponse(device, FUNCTION_CONFIGURATION_READ, 1);
+    map<int, DeviceMetadata>::const_iterator it = metadata.find(device);
+    if (it != metadata.end() && it->second.hasAbsolute)
+        return it->second.absolute;
+
+    bool absolute = parseIsAbsolute(transact(Request::isAbsolute(device)));
+    DeviceMetadata& cache = metadata[device];
+    cache.hasAbsolute = true;
+    cache.absolute = absolute;
+    return absolute;
+}
+
+bool DriverClass5_20::parseIsAbsolute(PacketView const& response)
+{
     return (response[0] != 0);
 }
 
 void DriverClass5_20::echo(int device)
 {
-    uint8_t payload[4] = { 0, 0, 0xE, 0x8 };
-    Packet packet(device, FUNCTION_ECHO);
-    packet.addBytes(payload, payload + 4);
-    writePacket(packet);
-    Packet response = readResponse(device, FUNCTION_ECHO, 4);
+    checkEcho(transact(Request::echo(device)));
+}
 
+void DriverClass5_20::checkEcho(PacketView const& response)
+{
     for (int i = 0; i < 4; ++i)
     {
-        if (response[i] != payload[i])
+        if (response[i] != RequestFrames::ECHO_PAYLOAD[i])
             throw std::runtime_error("communication error while performing echo");
     }
 }
@@ -112,56 +505,435 @@ void DriverClass5_20::writePacket(Packet const& packet)
 {
     writeBuffer.clear();
     packet.marshal(writeBuffer);
-    LOG_DEBUG_S << "sending " << binary_com(&writeBuffer[0], writeBuffer.size());
-    iodrivers_base::Driver::writePacket(&writeBuffer[0], writeBuffer.size());
+    flushWriteBuffer();
 }
 
-Packet DriverClass5_20::readPacket()
+void DriverClass5_20::flushWriteBuffer(int frameCount)
 {
-    byte buffer[Packet::MAXIMUM_PACKET_SIZE];
-    int packet_size = iodrivers_base::Driver::readPacket(buffer, Packet::MAXIMUM_PACKET_SIZE);
-    // The Velki docs specify a silence of 1ms between reception of data and
-    // sending again
-    usleep(1000);
-    Packet packet;
-    packet.unmarshal(buffer, packet_size);
-    return packet;
+    writeFrame(&writeBuffer[0], writeBuffer.size(), frameCount);
 }
 
-Packet DriverClass5_20::readResponse(int address, int function, int expectedSize)
+void DriverClass5_20::writeFrame(byte const* frame, int size, int frameCount)
 {
-    expectedAddress = address;
-    expectedFunction = function;
-    expectedPayloadSize = expectedSize;
-    Packet packet = readPacket();
+    waitInterFrameSilence();
+    writeStartTime = base::Time::now();
+    trace->record(TraceRing::SENT, frame, size);
+    iodrivers_base::Driver::writePacket(frame, size);
+    writeEndTime = base::Time::now();
+    responseTimeOrigin = writeEndTime;
+    writeSize = size;
+    writeFrameCount = frameCount;
+    responsesSinceWrite = 0;
+    statistics.writeTime.record(writeEndTime - writeStartTime);
+    firstByteReceived = false;
+    if (recorder)
+        recorder->record(FrameLog::SENT, frame, size);
+}
 
-    if (packet.hasError())
-        throw Error(address, function, packet.getErrorCode());
+PacketView DriverClass5_20::readPacket(base::Time const& timeout)
+{
+    int packet_size;
+    try
+    {
+        packet_size = iodrivers_base::Driver::readPacket(readBuffer, Packet::MAXIMUM_PACKET_SIZE, timeout);
+    }
+    catch(iodrivers_base::TimeoutError const&)
+    {
+        ++statistics.timeouts;
+        trace->record(TraceRing::TIMEOUT, expectedAddress, expectedFunction);
+        throw;
+    }
+
+    base::Time previousReception = lastReceptionTime;
+    lastReceptionTime = base::Time::now();
+    trace->record(TraceRing::RECEIVED, readBuffer, packet_size);
+    if (recorder)
+        recorder->record(FrameLog::RECEIVED, readBuffer, packet_size);
+    // extractPacket already validated the frame, no need to check the CRC
+    // again
+    PacketView packet(readBuffer, packet_size);
+    recordResponse(packet, previousReception);
     return packet;
 }
 
-int DriverClass5_20::extractPacket(uint8_t const* buffer, size_t buffer_size) const
+base::Time DriverClass5_20::getRequestEndTime(int frame) const
+{
+    frame = std::min(frame, writeFrameCount - 1);
+    base::Time writeDuration = writeEndTime - writeStartTime;
+    boost::int64_t written = writeDuration.toMicroseconds() * (frame + 1) / writeFrameCount;
+    int bytes = writeSize / writeFrameCount * (frame + 1);
+    return std::max(writeStartTime + base::Time::fromMicroseconds(written),
+            writeStartTime + getTransmissionTime(bytes));
+}
+
+void DriverClass5_20::recordResponse(PacketView const& response, base::Time const& previousReception)
+{
+    // The device starts processing a request once it has been received and
+    // the response to the previous one has been sent
+    base::Time responseTime = lastReceptionTime - std::max(responseTimeOrigin, previousReception);
+    getResponseTimes(response.getAddress(), response.getFunction()).record(responseTime);
+
+    ++statistics.responses;
+    // All the responses to the requests sent in one write are measured from
+    // the start of that write
+    base::Time roundTrip = lastReceptionTime - writeStartTime;
+    statistics.roundTripByFunction[response.getFunction()].record(roundTrip);
+    statistics.roundTripByDevice[response.getAddress()].record(roundTrip);
+    lastSampleTime = lastReceptionTime;
+    lastSampleUncertainty = base::Time();
+    if (response.getFunction() == FUNCTION_READ_CHANNEL && !response.hasError())
+    {
+        base::Time requestEnd = std::max(getRequestEndTime(responsesSinceWrite), previousReception);
+        base::Time responseStart = lastReceptionTime - getTransmissionTime(response.getPayloadSize() + 4);
+        timestampEstimators[response.getAddress()].update(requestEnd, std::max(requestEnd, responseStart),
+                lastSampleTime, lastSampleUncertainty);
+    }
+
+    if (response.hasError())
+    {
+        ++statistics.errors[response.getErrorCode()];
+        // The device has most likely been power-cycled, what we know about
+        // it may be outdated
+        if (response.getErrorCode() == Error::ERROR_DEVICE_NOT_INITIALIZED)
+            metadata.erase(response.getAddress());
+    }
+    ++responsesSinceWrite;
+}
+
+AdaptiveTimeout& DriverClass5_20::getResponseTimes(int address, int function)
+{
+    pair<int, int> key(address, function);
+    map<pair<int, int>, AdaptiveTimeout>::iterator it = responseTimes.find(key);
+    if (it == responseTimes.end())
+        it = responseTimes.insert(make_pair(key, AdaptiveTimeout(adaptiveTimeoutPercentile))).first;
+    return it->second;
+}
+
+void DriverClass5_20::recordTimeout(int address, int function)
+{
+    // Only the responses that come within the timeout get recorded, so the
+    // estimate could otherwise never grow back
+    responseTimes.erase(make_pair(address, function));
+}
+
+void DriverClass5_20::waitLateResponses()
+{
+    if (!lateResponses.count)
+        return;
+
+    base::Time deadline = lateResponses.origin + getReadTimeout();
+    base::Time previousReception = lateResponses.origin;
+    // Do not use readBuffer, the caller may still be using a response
+    byte buffer[Packet::MAXIMUM_PACKET_SIZE];
+    expectResponse(lateResponses.address, lateResponses.function, lateResponses.expectedSize);
+    try
+    {
+        base::Time now;
+        while (lateResponses.count && (now = base::Time::now()) < deadline)
+        {
+            int packet_size = iodrivers_base::Driver::readPacket(buffer, Packet::MAXIMUM_PACKET_SIZE,
+                    deadline - now);
+            lastReceptionTime = base::Time::now();
+            trace->record(TraceRing::RECEIVED, buffer, packet_size);
+            if (recorder)
+                recorder->record(FrameLog::RECEIVED, buffer, packet_size);
+            getResponseTimes(lateResponses.address, lateResponses.function)
+                .record(lastReceptionTime - previousReception);
+            previousReception = lastReceptionTime;
+            --lateResponses.count;
+        }
+    }
+    catch(iodrivers_base::TimeoutError const&) {}
+    lateResponses.count = 0;
+}
+
+Sample::STATUS DriverClass5_20::receiveResponse(int address, int function, int expectedSize,
+        base::Time const& timeout, PacketView& response)
+{
+    expectResponse(address, function, expectedSize);
+    // iodrivers_base reports timeouts with an exception. A timeout costs
+    // far more than the unwinding anyway
+    try
+    {
+        response = readPacket(timeout);
+    }
+    catch(iodrivers_base::TimeoutError const&)
+    {
+        return Sample::STATUS_TIMEOUT;
+    }
+
+    return response.hasError() ? Sample::STATUS_DEVICE_ERROR : Sample::STATUS_OK;
+}
+
+Sample::STATUS DriverClass5_20::receiveResponseWithRetries(int address, int function, int expectedSize,
+        byte const* requests, int requestsSize, int& retries, PacketView& response)
+{
+    while (true)
+    {
+        // The retries wait for the read timeout, as the device may have
+        // slowed down since its response times got learned
+        base::Time timeout = retries ? getReadTimeout() : getResponseTimeout(address, function);
+        Sample::STATUS status = receiveResponse(address, function, expectedSize, timeout, response);
+        if (status != Sample::STATUS_TIMEOUT)
+            return status;
+
+        recordTimeout(address, function);
+        // The requests that are sent again have the size of the ones of
+        // the previous write
+        int frameCount = requestsSize / (writeSize / writeFrameCount);
+        if (retries >= maxRetries)
+        {
+            if (timeout < getReadTimeout())
+            {
+                lateResponses.address = address;
+                lateResponses.function = function;
+                lateResponses.expectedSize = expectedSize;
+                lateResponses.count = frameCount;
+                lateResponses.origin = responseTimeOrigin;
+            }
+            return status;
+        }
+
+        ++retries;
+        ++statistics.retries;
+        trace->record(TraceRing::RETRY, address, function);
+        // The response may still answer the first attempt
+        base::Time origin = responseTimeOrigin;
+        writeFrame(requests, requestsSize, frameCount);
+        responseTimeOrigin = origin;
+    }
+}
+
+void DriverClass5_20::discardDuplicateResponses(int address, int function, int expectedSize,
+        base::Time const& transactionStart)
+{
+    // The duplicates answer requests that got sent before the response we
+    // already have, so they come within one response time. Use the learned
+    // one if there is one. Otherwise, the device answered within the time
+    // the transaction took so far
+    base::Time now = base::Time::now();
+    base::Time wait = now - transactionStart + getInterFrameSilence() + adaptiveTimeoutMargin;
+    map<pair<int, int>, AdaptiveTimeout>::const_iterator it =
+        responseTimes.find(make_pair(address, function));
+    if (it != responseTimes.end())
+        wait = it->second.getTimeout(adaptiveTimeoutMargin, wait);
+    base::Time deadline = now + wait;
+
+    // Do not use readBuffer, the caller may still be using the response
+    byte buffer[Packet::MAXIMUM_PACKET_SIZE];
+    expectResponse(address, function, expectedSize);
+    try
+    {
+        while ((now = base::Time::now()) < deadline)
+        {
+            int packet_size = iodrivers_base::Driver::readPacket(buffer, Packet::MAXIMUM_PACKET_SIZE,
+                    deadline - now);
+            lastReceptionTime = base::Time::now();
+            trace->record(TraceRing::RECEIVED, buffer, packet_size);
+            if (recorder)
+                recorder->record(FrameLog::RECEIVED, buffer, packet_size);
+        }
+    }
+    catch(iodrivers_base::TimeoutError const&) {}
+}
+
+PacketView DriverClass5_20::transact(Request const& request)
 {
-    LOG_DEBUG_S << "parsing " << buffer_size << " bytes: " << binary_com(buffer, buffer_size);
-    // All packets have address, function and CRC on top of payload
-    size_t expectedPacketSize = expectedPayloadSize + 4;
-    if (buffer_size < expectedPacketSize)
-        return 0;
-    if (buffer[0] != expectedAddress)
+    PacketView response;
+    Sample::STATUS status = tryTransact(request, response);
+    if (status != Sample::STATUS_OK)
+    {
+        throwFailure(status, request.address, request.function,
+                status == Sample::STATUS_DEVICE_ERROR ? response.getErrorCode() : 0);
+    }
+    return response;
+}
+
+Sample::STATUS DriverClass5_20::tryTransact(Request const& request, PacketView& response)
+{
+    waitLateResponses();
+    writeFrame(request.frame->data, request.frame->size);
+    base::Time transactionStart = writeStartTime;
+    int retries = 0;
+    Sample::STATUS status = receiveResponseWithRetries(request.address, request.function,
+            request.responseSize, request.frame->data, request.frame->size,
+            retries, response);
+    // If the retries timed out as well, the device is most likely gone
+    if (retries && status != Sample::STATUS_TIMEOUT)
+        discardDuplicateResponses(request.address, request.function, request.responseSize,
+                transactionStart);
+    return status;
+}
+
+void DriverClass5_20::throwFailure(Sample::STATUS status, int device, int function, int error) const
+{
+    if (status == Sample::STATUS_TIMEOUT)
+    {
+        throw iodrivers_base::TimeoutError(
+                firstByteReceived ? iodrivers_base::TimeoutError::PACKET : iodrivers_base::TimeoutError::FIRST_BYTE,
+                "no response from the device");
+    }
+    throw Error(device, function, static_cast<Error::ERROR_CODE>(error));
+}
+
+void DriverClass5_20::submit(Request const& request, AsyncCallback const& callback)
+{
+    PendingRequest pending;
+    pending.request = request;
+    pending.callback = callback;
+    asyncQueue.push_back(pending);
+    sendNextAsyncRequest();
+}
+
+bool DriverClass5_20::hasPendingRequests() const
+{
+    return !asyncQueue.empty();
+}
+
+base::Time DriverClass5_20::getNextAsyncDeadline() const
+{
+    if (asyncInFlight)
+        return asyncDeadline;
+    else if (asyncQueue.empty())
+        return base::Time();
+    else if (lastReceptionTime.isNull())
+        return base::Time::now();
+    else
+        return lastReceptionTime + getInterFrameSilence();
+}
+
+void DriverClass5_20::processAsync()
+{
+    byte response[Packet::MAXIMUM_PACKET_SIZE];
+    int responseSize = readAsyncInput(response);
+    if (responseSize)
+    {
+        // The response has left asyncBuffer, the callback may therefore
+        // submit requests and process them
+        PacketView packet(response, responseSize);
+        completeAsyncRequest(packet.hasError() ? ASYNC_DEVICE_ERROR : ASYNC_OK, packet);
+    }
+    else if (asyncInFlight && base::Time::now() >= asyncDeadline)
     {
-        LOG_DEBUG_S << "  unexpected address";
-        return -1;
+        ++statistics.timeouts;
+        Request const& request = asyncQueue.front().request;
+        trace->record(TraceRing::TIMEOUT, request.address, request.function);
+        recordTimeout(request.address, request.function);
+        asyncBuffer.clear();
+        completeAsyncRequest(ASYNC_TIMEOUT, PacketView());
     }
-    if ((buffer[1] & 0x7F) != expectedFunction)
+    sendNextAsyncRequest();
+}
+
+int DriverClass5_20::readAsyncInput(byte* response)
+{
+    byte buffer[256];
+    while (true)
     {
-        LOG_DEBUG_S << "  unexpected function";
-        return -1;
+        ssize_t count = ::read(getFileDescriptor(), buffer, sizeof(buffer));
+        if (count > 0)
+            asyncBuffer.insert(asyncBuffer.end(), buffer, buffer + count);
+        else if (count == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        else if (errno != EINTR)
+            throw iodrivers_base::UnixError("processAsync(): error while reading the port");
     }
-    if (!Packet::isChecksumValid(buffer, buffer + expectedPacketSize))
+
+    while (asyncInFlight && !asyncBuffer.empty())
     {
-        LOG_DEBUG_S << "  invalid checksum";
-        return -1;
+        int result = extractPacket(&asyncBuffer[0], asyncBuffer.size());
+        if (result == 0)
+            return 0;
+        else if (result < 0)
+        {
+            asyncBuffer.erase(asyncBuffer.begin(), asyncBuffer.begin() - result);
+            continue;
+        }
+
+        base::Time previousReception = lastReceptionTime;
+        lastReceptionTime = base::Time::now();
+        std::copy(asyncBuffer.begin(), asyncBuffer.begin() + result, response);
+        // There is only one request in flight, whatever follows its
+        // response is not for us
+        asyncBuffer.clear();
+        trace->record(TraceRing::RECEIVED, response, result);
+        if (recorder)
+            recorder->record(FrameLog::RECEIVED, response, result);
+        recordResponse(PacketView(response, result), previousReception);
+        return result;
     }
-    return expectedPacketSize;
+
+    // Whatever is left has been received while no request was in flight
+    if (!asyncInFlight)
+        asyncBuffer.clear();
+    return 0;
+}
+
+void DriverClass5_20::sendNextAsyncRequest()
+{
+    if (asyncInFlight || asyncQueue.empty())
+        return;
+
+    base::Time now = base::Time::now();
+    if (!lastReceptionTime.isNull() && now - lastReceptionTime < getInterFrameSilence())
+        return;
+
+    Request const& request = asyncQueue.front().request;
+    expectResponse(request.address, request.function, request.responseSize);
+    writeFrame(request.frame->data, request.frame->size);
+    asyncInFlight = true;
+    asyncDeadline = now + getResponseTimeout(request.address, request.function);
+}
+
+void DriverClass5_20::completeAsyncRequest(ASYNC_STATUS status, PacketView const& response)
+{
+    AsyncCallback callback = asyncQueue.front().callback;
+    asyncQueue.pop_front();
+    asyncInFlight = false;
+    // The callback is allowed to submit new requests
+    callback(status, response);
 }
 
+void DriverClass5_20::expectResponse(int address, int function, int payloadSize)
+{
+    expectedAddress = address;
+    expectedFunction = function;
+    expectedPayloadSize = payloadSize;
+    scanner.expect(address, function, payloadSize);
+}
+
+boost::uint64_t DriverClass5_20::getDiscardedBytes() const
+{
+    return scanner.getDiscardedBytes();
+}
+
+DriverStatistics DriverClass5_20::getStatistics() const
+{
+    DriverStatistics result = statistics;
+    result.crcFailures = scanner.getCRCFailures();
+    result.discardedBytes = scanner.getDiscardedBytes();
+    return result;
+}
+
+void DriverClass5_20::resetStatistics()
+{
+    statistics = DriverStatistics();
+    scanner.resetCounters();
+}
+
+int DriverClass5_20::extractPacket(uint8_t const* buffer, size_t buffer_size) const
+{
+    if (!firstByteReceived && buffer_size > 0)
+    {
+        firstByteReceived = true;
+        statistics.firstByteTime.record(base::Time::now() - writeEndTime);
+    }
+    int result = scanner.scan(buffer, buffer_size);
+    if (result < 0)
+    {
+        trace->record(TraceRing::DISCARDED, buffer, -result);
+        if (recorder)
+            recorder->record(FrameLog::RECEIVED, buffer, -result);
+    }
+    return result;
+}
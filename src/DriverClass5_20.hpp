@@ -1,16 +1,29 @@
 #ifndef PRESSURE_VELKI_DRIVER_CLASS5_20_HPP
 #define PRESSURE_VELKI_DRIVER_CLASS5_20_HPP
 
+#include <deque>
+#include <map>
 #include <boost/cstdint.hpp>
+#include <boost/function.hpp>
 #include <base/Pressure.hpp>
 #include <iodrivers_base/Driver.hpp>
 #include <pressure_velki/Packet.hpp>
+#include <pressure_velki/PacketView.hpp>
+#include <pressure_velki/FrameScanner.hpp>
 #include <pressure_velki/DeviceInfo.hpp>
+#include <pressure_velki/Sample.hpp>
+#include <pressure_velki/FrameLog.hpp>
+#include <pressure_velki/DriverStatistics.hpp>
+#include <pressure_velki/RequestFrames.hpp>
+#include <pressure_velki/AdaptiveTimeout.hpp>
+#include <pressure_velki/TraceRing.hpp>
+#include <pressure_velki/TimestampEstimator.hpp>
 
 namespace pressure_velki
 {
     class DriverClass5_20 : public iodrivers_base::Driver
     {
+    public:
         enum FUNCTIONS
         {
             FUNCTION_ECHO = 8,
@@ -30,10 +43,178 @@ namespace pressure_velki
             CHANNEL_TEMPERATURE_OF_PRESSURE1
         };
 
-    public:
+        /** A request, along with what is needed to match its response */
+        struct Request
+        {
+            /** The ready-to-send frame. It points to static storage, see
+             * RequestFrames
+             */
+            RequestFrames::Frame const* frame;
+            int address;
+            FUNCTIONS function;
+            /** The payload size of the expected response */
+            int responseSize;
+
+            Request();
+            Request(int address, FUNCTIONS function, int responseSize,
+                    RequestFrames::Frame const& frame);
+
+            static Request initialize(int device);
+            static Request serialNumber(int device);
+            static Request echo(int device);
+            static Request isAbsolute(int device);
+            static Request readChannel(CHANNEL_ID channel, int device);
+        };
+
+        /** Outcome of a request submitted with submit() */
+        enum ASYNC_STATUS
+        {
+            ASYNC_OK,
+            /** The device did not reply within the read timeout */
+            ASYNC_TIMEOUT,
+            /** The device replied with an exception. Use
+             * Packet::getErrorCode() to get the error
+             */
+            ASYNC_DEVICE_ERROR
+        };
+
+        /** Callback called when a submitted request completes
+         *
+         * The packet is the response. It is empty if the request timed out.
+         * It points to the driver's receive buffer, and is therefore only
+         * valid during the callback.
+         */
+        typedef boost::function<void (ASYNC_STATUS, PacketView const&)> AsyncCallback;
+
         DriverClass5_20();
 
+        /** Opens the given URI
+         *
+         * This is iodrivers_base::Driver::openURI. In addition, if the URI is
+         * a serial URI (serial://PATH:BAUDRATE), the baud rate is used to
+         * compute the inter-frame silence (see setBaudrate)
+         */
+        void openURI(std::string const& uri);
+
+        /** Sets the baud rate of the line
+         *
+         * It does not change the port configuration. It is only used to
+         * compute the silence that is required between the reception of a
+         * frame and the sending of the next one, which is 3.5 character
+         * times (the Modbus rule) with a minimum of 1ms (required by the
+         * Velki docs). Set it to zero if the baud rate is unknown, in which
+         * case only the 1ms minimum is applied.
+         */
+        void setBaudrate(int baudrate);
+
+        /** Returns the baud rate set with setBaudrate or openURI, or zero if it
+         * is unknown
+         */
+        int getBaudrate() const;
+
+        /** Returns the silence required between the reception of a frame and
+         * the sending of the next one
+         */
+        base::Time getInterFrameSilence() const;
+
+        /** Changes the minimum inter-frame silence
+         *
+         * It is 1ms by default, as required by the Velki docs. Only change it
+         * if the other end is not a Velki device, as e.g. during a replay.
+         */
+        void setMinimumInterFrameSilence(base::Time const& silence);
+
+        /** Returns the minimum inter-frame silence */
+        base::Time getMinimumInterFrameSilence() const;
+
+        /** Returns the time it takes to transmit the given number of bytes
+         * at the baud rate set with setBaudrate, or zero if it is unknown
+         */
+        base::Time getTransmissionTime(int bytes) const;
+
+        /** Sets how long before handling a request the device acquires the
+         * values it returns
+         *
+         * The samples returned by the driver are timestamped with the
+         * estimated acquisition time, see TimestampEstimator. This delay
+         * cannot be observed on the bus, and is zero by default.
+         */
+        void setConversionDelay(int device, base::Time const& delay,
+                base::Time const& uncertainty = base::Time());
+
+        /** Returns the estimated time the device takes to handle a channel
+         * read, or a null time if no channel has been read from it yet
+         */
+        base::Time getProcessingDelay(int device) const;
+
+        /** Enables or disables the adaptive response timeouts
+         *
+         * When enabled, the driver learns how long each device takes to
+         * respond to each kind of request, and waits for a response for at
+         * most the given percentile of these response times plus a margin.
+         * The read timeout (setReadTimeout) is used until enough responses
+         * have been received, and remains the upper bound. This prevents a
+         * single unresponsive device from stalling the whole bus for the
+         * full read timeout.
+         *
+         * A timeout makes the driver forget what it learned about the device
+         * and function, as the device may have slowed down. Retries, and the
+         * requests that follow until enough responses got received again,
+         * wait for the read timeout. A response that comes after a shorter
+         * timeout is still waited for, and discarded, before the next
+         * request is sent.
+         *
+         * It is disabled by default, in which case the driver always waits
+         * for the read timeout.
+         */
+        void setAdaptiveTimeout(bool enable, double percentile = 0.99,
+                base::Time const& margin = base::Time::fromMilliseconds(5));
+
+        /** Returns whether the adaptive timeouts are enabled */
+        bool isAdaptiveTimeoutEnabled() const;
+
+        /** Returns how long the driver currently waits for the response of
+         * the given device to a request with the given function
+         */
+        base::Time getResponseTimeout(int device, int function) const;
+
+        /** Sets how many times a request is sent again when its response
+         * times out, before the TimeoutError is reported. It is 0 by
+         * default.
+         *
+         * Retries only apply to the blocking methods.
+         */
+        void setMaxRetries(int retries);
+
+        /** Returns the number of retries set with setMaxRetries */
+        int getMaxRetries() const;
+
+        /** Sets a recorder to which all sent and received data is appended
+         *
+         * Received bytes that get discarded because they are not part of a
+         * valid frame are recorded as well, so that a replay goes through
+         * the same resynchronization. The recorder is not owned by the
+         * driver. Set to NULL to stop recording.
+         */
+        void setRecorder(FrameRecorder* recorder);
+
+        /** Sets the ring in which the I/O events are traced
+         *
+         * Tracing is always on. By default, the driver traces in its own
+         * ring, which holds the last TraceRing::DEFAULT_CAPACITY events. Use
+         * a file-backed ring to be able to look at the trace after a crash.
+         * The ring is not owned by the driver. Set to NULL to go back to the
+         * driver's own ring.
+         */
+        void setTrace(TraceRing* trace);
+
+        /** Returns the ring in which the I/O events are traced */
+        TraceRing& getTrace() const;
+
         /** Initialize the given device, and wait for the reply
+         *
+         * It always communicates with the device. The device's cached
+         * metadata is cleared and replaced by the returned information.
          *
          * @param device the device ID. You can use the special value
          *   Packet::ADDRESS_POINT_TO_POINT if there is only one device
@@ -44,12 +225,35 @@ namespace pressure_velki
          */
         DeviceInfo initialize(int device = Packet::ADDRESS_POINT_TO_POINT);
 
-        /** Query and return the device's serial number
+        /** Return the device's serial number
          *
-         * This can be used as some form of diagnostics
+         * The device is only queried if the serial number is not in the
+         * metadata cache. This can be used as some form of diagnostics
          */
         int getSerialNumber(int device = Packet::ADDRESS_POINT_TO_POINT);
 
+        /** Query the device's serial number, and clear the device's cached
+         * metadata if it does not match the cached serial number
+         *
+         * Use it to detect that a device got replaced by another one with
+         * the same address.
+         *
+         * @return false if the serial number did not match
+         */
+        bool verifySerialNumber(int device = Packet::ADDRESS_POINT_TO_POINT);
+
+        /** Returns what is known about a device without communicating
+         *
+         * The metadata is filled by initialize(), getSerialNumber() and
+         * isAbsolute(). It is cleared when the device is initialized again,
+         * when it replies that it is not initialized (e.g. after a power
+         * cycle) and when verifySerialNumber() detects a different device.
+         */
+        DeviceMetadata getMetadata(int device = Packet::ADDRESS_POINT_TO_POINT) const;
+
+        /** Clears the cached metadata of a device */
+        void invalidateMetadata(int device = Packet::ADDRESS_POINT_TO_POINT);
+
         /** Send an echo to the given device and wait for the response */
         void echo(int device = Packet::ADDRESS_POINT_TO_POINT);
 
@@ -68,30 +272,336 @@ namespace pressure_velki
         float readTemperatureOfPressureSensor(int id, int device = Packet::ADDRESS_POINT_TO_POINT);
 
         /** Returns whether the sensor measures absolute or relative pressures
+         *
+         * The device is only queried if the information is not in the
+         * metadata cache
          */
         bool isAbsolute(int device = Packet::ADDRESS_POINT_TO_POINT);
 
+        /** Read several channels of the same device in one go
+         *
+         * All the requests are sent in a single write, and the responses are
+         * then read back in order. This saves one round-trip per channel
+         * compared to calling readChannel repeatedly. The device must be able
+         * to queue all the requests, i.e. their total size must stay within
+         * DeviceInfo::internalBufferSize.
+         *
+         * Pressures are in bar and temperatures in celsius. Saturated
+         * channels and channels with a measure error are reported as NaN.
+         *
+         * @param channels the channels to read
+         * @return the channel values, in the same order than \c channels
+         * @throw PoweringUp if the device is still powering up
+         */
+        std::vector<float> readChannels(std::vector<CHANNEL_ID> const& channels,
+                int device = Packet::ADDRESS_POINT_TO_POINT);
+
+        /** Read several channels of the same device in one go, and report
+         * each channel's status
+         *
+         * Unlike the other overload, channels whose device is powering up are
+         * reported through Sample::status instead of an exception.
+         *
+         * @param samples the samples, in the same order than \c channels.
+         *   The vector is cleared first
+         * @throw Error if the device replied with an exception
+         */
+        void readChannels(std::vector<CHANNEL_ID> const& channels,
+                std::vector<Sample>& samples,
+                int device = Packet::ADDRESS_POINT_TO_POINT);
+
+        /** Read one channel, and report failures through the sample's status
+         * instead of exceptions
+         *
+         * Unlike readChannel and readPressure, it does not throw when the
+         * device is powering up, replies with an exception or does not
+         * reply. Only errors of the port itself (iodrivers_base::UnixError)
+         * are reported by exception. Use it in polling loops, where these
+         * failures are part of the normal operation.
+         *
+         * @return the sample. Its status is Sample::STATUS_TIMEOUT if the
+         *   device did not reply, and Sample::STATUS_DEVICE_ERROR, with
+         *   Sample::error set, if it replied with an exception
+         */
+        Sample tryReadChannel(CHANNEL_ID channel, int device = Packet::ADDRESS_POINT_TO_POINT);
+
+        /** Read one pressure channel without throwing, see tryReadChannel
+         *
+         * @param the pressure channel to read (either 0 or 1). The status is
+         *   Sample::STATUS_CHANNEL_ERROR for any other value
+         * @return the sample, whose value is the pressure in bar
+         */
+        Sample tryReadPressure(int id, int device = Packet::ADDRESS_POINT_TO_POINT);
+
+        /** Read several channels of the same device in one go without
+         * throwing, see tryReadChannel and readChannels
+         *
+         * When a response is missing, its channel and all the following
+         * ones are reported with Sample::STATUS_TIMEOUT.
+         *
+         * @param samples the samples, in the same order than \c channels.
+         *   The vector is cleared first
+         */
+        void tryReadChannels(std::vector<CHANNEL_ID> const& channels,
+                std::vector<Sample>& samples,
+                int device = Packet::ADDRESS_POINT_TO_POINT);
+
+        /** Builds the sample of a READ_CHANNEL transaction, the way
+         * tryReadChannel does
+         *
+         * It must be called right after the response got received, e.g. from
+         * the callback given to submit(), as the sample gets timestamped with
+         * the reception time estimated for the last response. Samples of
+         * powering-up devices are counted in the statistics.
+         *
+         * @param status Sample::STATUS_OK if a response got received,
+         *   Sample::STATUS_DEVICE_ERROR if it is an exception and
+         *   Sample::STATUS_TIMEOUT if there is none
+         */
+        Sample decodeChannelSample(CHANNEL_ID channel, int device,
+                Sample::STATUS status, PacketView const& response);
+
+        /** Queues a request in the non-blocking mode
+         *
+         * In the non-blocking mode, the driver never waits on the port.
+         * Instead, the caller should wait for getFileDescriptor() to become
+         * readable, or for getNextAsyncDeadline() to be reached, and then call
+         * processAsync(). This allows to handle many ports in a single
+         * select/epoll loop.
+         *
+         * Requests are sent one at a time, in the order in which they got
+         * submitted. The callback is called from within processAsync() once
+         * the response got received or the read timeout expired.
+         *
+         * Do not mix the blocking methods and the non-blocking mode while
+         * some submitted requests are still pending.
+         */
+        void submit(Request const& request, AsyncCallback const& callback);
+
+        /** Advances the non-blocking mode
+         *
+         * It reads whatever data is available, completes the current request
+         * if its response got received or if it timed out, and sends the next
+         * request if the line is free.
+         */
+        void processAsync();
+
+        /** Returns the time at which processAsync() should be called even if
+         * no data is received, or a null time if no request is pending
+         */
+        base::Time getNextAsyncDeadline() const;
+
+        /** Returns true if some submitted requests have not completed yet */
+        bool hasPendingRequests() const;
+
+        /** Returns the number of received bytes that got discarded because
+         * they were not part of a valid response
+         */
+        boost::uint64_t getDiscardedBytes() const;
+
+        /** Returns the timing and error statistics accumulated since the
+         * construction of the driver or the last call to resetStatistics()
+         *
+         * Like the rest of the driver, it is not thread-safe: call it from
+         * the thread that does the I/O.
+         */
+        DriverStatistics getStatistics() const;
+
+        /** Clears the statistics returned by getStatistics() */
+        void resetStatistics();
+
+        /** Interprets the response to a FUNCTION_INITIALIZE request */
+        static DeviceInfo parseInitialize(PacketView const& response);
+
+        /** Interprets the response to a FUNCTION_SERIAL_NUMBER request */
+        static int parseSerialNumber(PacketView const& response);
+
+        /** Interprets the response to the configuration read done by
+         * isAbsolute()
+         */
+        static bool parseIsAbsolute(PacketView const& response);
+
+        /** Verifies the response to a FUNCTION_ECHO request
+         *
+         * @throw std::runtime_error if the response does not match the request
+         */
+        static void checkEcho(PacketView const& response);
+
+        /** Interprets the response to a FUNCTION_READ_CHANNEL request
+         *
+         * @return the channel value, NaN if the channel is saturated or had
+         *   a measure error
+         * @throw PoweringUp if the device is still powering up
+         */
+        static float parseChannel(CHANNEL_ID channel, int device, PacketView const& response);
+
+        /** Interprets the response to a FUNCTION_READ_CHANNEL request without
+         * throwing
+         *
+         * @param value set to the channel value, or NaN if the status is not
+         *   Sample::STATUS_OK
+         */
+        static Sample::STATUS decodeChannel(CHANNEL_ID channel, PacketView const& response, float& value);
+
+        /** Reports a channel status the way parseChannel does
+         *
+         * @return value
+         * @throw PoweringUp if the status is Sample::STATUS_POWERING_UP
+         */
+        static float checkChannelStatus(Sample::STATUS status, CHANNEL_ID channel, int device, float value);
+
     protected:
         std::vector<byte> writeBuffer;
 
+        int baudrate;
+        base::Time minimumInterFrameSilence;
+        FrameRecorder* recorder;
+
+        TraceRing defaultTrace;
+        /** The ring in use, either defaultTrace or the one given to
+         * setTrace()
+         */
+        TraceRing* trace;
+
+        /** Time at which the last frame got received */
+        base::Time lastReceptionTime;
+
+        /** The statistics. It is mutable as extractPacket() updates it */
+        mutable DriverStatistics statistics;
+        /** Time at which the last write started */
+        base::Time writeStartTime;
+        /** Time at which the last write ended */
+        base::Time writeEndTime;
+        /** Size of the last write */
+        int writeSize;
+        /** Number of request frames in the last write */
+        int writeFrameCount;
+        /** Number of responses received since the last write */
+        int responsesSinceWrite;
+        /** Time from which the response times are measured. It is the end
+         * of the last write, except during a retry where it stays the end
+         * of the first attempt, as the response may answer that attempt
+         */
+        base::Time responseTimeOrigin;
+        /** Whether some data has been received since the last write */
+        mutable bool firstByteReceived;
+
+        /** Updates the statistics, the adaptive timeouts and the sample
+         * timestamping with a frame that just got received
+         *
+         * @param previousReception the reception time of the previous frame
+         */
+        void recordResponse(PacketView const& response, base::Time const& previousReception);
+
+        /** Acquisition time of the value in the last received frame, and
+         * the uncertainty on it. Set by recordResponse()
+         */
+        base::Time lastSampleTime;
+        base::Time lastSampleUncertainty;
+        /** The model of each device used to timestamp the samples */
+        std::map<int, TimestampEstimator> timestampEstimators;
+
+        /** The metadata cache */
+        std::map<int, DeviceMetadata> metadata;
+
+        bool adaptiveTimeoutEnabled;
+        double adaptiveTimeoutPercentile;
+        base::Time adaptiveTimeoutMargin;
+        int maxRetries;
+        /** The response times of each device, per function */
+        std::map<std::pair<int, int>, AdaptiveTimeout> responseTimes;
+
+        /** Returns the response times of a device for a function */
+        AdaptiveTimeout& getResponseTimes(int address, int function);
+
+        /** Forgets the response times learned for a device and function
+         * after a timeout, so that the driver waits for the read timeout
+         * until the new response times got learned. The device may have
+         * slowed down
+         */
+        void recordTimeout(int address, int function);
+
+        /** Responses that may still come after their request timed out
+         * before the read timeout, when no retry followed
+         */
+        struct LateResponses
+        {
+            int address;
+            int function;
+            int expectedSize;
+            /** The number of responses, zero if none is expected */
+            int count;
+            /** The end of the write of the requests */
+            base::Time origin;
+        };
+        LateResponses lateResponses;
+
+        /** Waits for the late responses until the read timeout elapsed
+         * since their requests, and discards them
+         *
+         * Otherwise, they would be taken for the responses to the next
+         * requests. Their response times are recorded, so that the adaptive
+         * timeout follows a device that slowed down.
+         */
+        void waitLateResponses();
+
+        /** Waits until the inter-frame silence has elapsed since the
+         * reception of the last frame
+         */
+        void waitInterFrameSilence();
+
         /** Read one channel */
         float readChannel(CHANNEL_ID channel, int device);
 
         /** Write one packet */
         void writePacket(Packet const& packet);
 
-        /** Reads one packet */
-        Packet readPacket();
+        /** Write the current content of writeBuffer
+         *
+         * @param frameCount the number of request frames in writeBuffer,
+         *   which must all have the same size
+         */
+        void flushWriteBuffer(int frameCount = 1);
+
+        /** Write a ready-made frame, or several concatenated frames of the
+         * same size
+         */
+        void writeFrame(byte const* frame, int size, int frameCount = 1);
+
+        /** Returns the estimated time at which the given request frame of
+         * the last write was fully transmitted
+         *
+         * The write may return before the data is actually on the line, and
+         * the device may handle the first requests of a batch while the
+         * next ones are still being sent
+         */
+        base::Time getRequestEndTime(int frame) const;
+
+        /** Buffer in which readPacket() receives the frames */
+        byte readBuffer[Packet::MAXIMUM_PACKET_SIZE];
+
+        /** Reads one packet
+         *
+         * The returned view points to readBuffer, and is therefore only valid
+         * until the next call
+         */
+        PacketView readPacket(base::Time const& timeout);
 
         /** Information about the packet that should be expected during the next
          * response read.
          *
-         * @see readResponse
+         * @see receiveResponse
          */
         int expectedAddress;
         int expectedFunction;
         int expectedPayloadSize;
 
+        /** Sets the expected* fields and the scanner's expectations */
+        void expectResponse(int address, int function, int payloadSize);
+
+        /** Finds the expected response in the received data */
+        mutable FrameScanner scanner;
+
         /** Read the response to a request
          *
          * @param address the device address. The response will have to come
@@ -99,8 +609,103 @@ namespace pressure_velki
          * @param function the request's function. The response should refer to
          *   the same function
          * @param expectedSize the expected size of the payload
+         * @param timeout how long to wait for the response
+         * @param response set to the response, which is an exception
+         *   response if the status is STATUS_DEVICE_ERROR. It is only valid
+         *   until the next read
+         * @return Sample::STATUS_OK, Sample::STATUS_DEVICE_ERROR or
+         *   Sample::STATUS_TIMEOUT
+         */
+        Sample::STATUS receiveResponse(int address, int function, int expectedSize,
+                base::Time const& timeout, PacketView& response);
+
+        /** Read the response to a request, and send the requests again if it
+         * times out
+         *
+         * The first attempt waits for the adaptive response timeout, the
+         * retries for the read timeout.
+         *
+         * @param requests the requests that should be sent again. It is the
+         *   request whose response is expected, followed by the requests
+         *   sent after it whose responses have not been read yet
+         * @param retries the number of retries already done for this set
+         *   of requests. It is incremented on each retry, and the
+         *   TimeoutError is thrown once it reaches the maximum
+         */
+        Sample::STATUS receiveResponseWithRetries(int address, int function, int expectedSize,
+                byte const* requests, int requestsSize, int& retries,
+                PacketView& response);
+
+        /** Reads and discards the responses to the requests that were sent
+         * again, as the responses to the first attempts may have been late
+         * instead of lost
+         *
+         * Only call it when the device did respond after a retry. It waits
+         * for the device's learned response time if there is one, and
+         * otherwise for as long as the transaction took so far
+         *
+         * @param transactionStart the time the first attempt got sent
+         */
+        void discardDuplicateResponses(int address, int function, int expectedSize,
+                base::Time const& transactionStart);
+
+        /** Sends a request and reads its response
+         *
+         * @return the response. It is only valid until the next read
+         * @throw Error if the device replied with an exception
+         * @throw iodrivers_base::TimeoutError if the device did not reply
+         */
+        PacketView transact(Request const& request);
+
+        /** Sends a request and reads its response without throwing
+         *
+         * @see receiveResponse
+         */
+        Sample::STATUS tryTransact(Request const& request, PacketView& response);
+
+        /** Throws the exception that corresponds to a failed transaction
+         *
+         * @param status either Sample::STATUS_TIMEOUT or
+         *   Sample::STATUS_DEVICE_ERROR
          */
-        Packet readResponse(int address, int function, int expectedSize);
+        void throwFailure(Sample::STATUS status, int device, int function, int error) const;
+
+        struct PendingRequest
+        {
+            Request request;
+            AsyncCallback callback;
+        };
+
+        /** The requests submitted in the non-blocking mode. The first one is
+         * the request being processed
+         */
+        std::deque<PendingRequest> asyncQueue;
+        /** Whether the first request of asyncQueue has been sent */
+        bool asyncInFlight;
+        /** Time at which the request in flight times out */
+        base::Time asyncDeadline;
+        /** Data received in the non-blocking mode but not yet processed */
+        std::vector<byte> asyncBuffer;
+
+        /** Reads all data available and extracts the response to the
+         * request in flight if it is there
+         *
+         * The response is removed from asyncBuffer. It is up to the caller
+         * to complete the request.
+         *
+         * @param response buffer of at least Packet::MAXIMUM_PACKET_SIZE
+         *   bytes in which the response is copied
+         * @return the size of the response, or zero if it is not complete yet
+         */
+        int readAsyncInput(byte* response);
+
+        /** Sends the next queued request if there is no request in flight
+         * and the inter-frame silence has elapsed
+         */
+        void sendNextAsyncRequest();
+
+        /** Removes the request in flight and calls its callback */
+        void completeAsyncRequest(ASYNC_STATUS status, PacketView const& response);
 
 
         /** Packet extraction routine used by iodrivers_base::Driver */
@@ -0,0 +1,67 @@
+#include <pressure_velki/DriverStatistics.hpp>
+#include <pressure_velki/Errors.hpp>
+#include <ostream>
+#include <sstream>
+
+using namespace pressure_velki;
+using namespace std;
+
+DriverStatistics::DriverStatistics()
+    : responses(0)
+    , timeouts(0)
+    , retries(0)
+    , crcFailures(0)
+    , discardedBytes(0)
+    , poweringUp(0)
+{
+}
+
+static void dumpHistogram(ostream& io, string const& name, LatencyHistogram const& histogram)
+{
+    io << name << " (us): count=" << histogram.getCount();
+    if (histogram.getCount() != 0)
+    {
+        io << " min=" << histogram.getMin().toMicroseconds()
+            << " mean=" << histogram.getMean().toMicroseconds()
+            << " p50=" << histogram.getPercentile(0.5).toMicroseconds()
+            << " p90=" << histogram.getPercentile(0.9).toMicroseconds()
+            << " p99=" << histogram.getPercentile(0.99).toMicroseconds()
+            << " max=" << histogram.getMax().toMicroseconds();
+    }
+    io << "\n";
+}
+
+void DriverStatistics::dump(ostream& io) const
+{
+    io << "responses: " << responses << "\n"
+        << "timeouts: " << timeouts << "\n"
+        << "retries: " << retries << "\n"
+        << "CRC failures: " << crcFailures << "\n"
+        << "discarded bytes: " << discardedBytes << "\n"
+        << "powering up: " << poweringUp << "\n";
+    for (map<int, boost::uint64_t>::const_iterator it = errors.begin(); it != errors.end(); ++it)
+    {
+        io << "error " << it->first << " ("
+            << Error::errorMessage(0, static_cast<Error::ERROR_CODE>(it->first))
+            << "): " << it->second << "\n";
+    }
+
+    dumpHistogram(io, "write time", writeTime);
+    dumpHistogram(io, "time to first byte", firstByteTime);
+    for (map<int, LatencyHistogram>::const_iterator it = roundTripByFunction.begin();
+            it != roundTripByFunction.end(); ++it)
+    {
+        ostringstream name;
+        name << "round trip for function " << it->first;
+        dumpHistogram(io, name.str(), it->second);
+    }
+    for (map<int, LatencyHistogram>::const_iterator it = roundTripByDevice.begin();
+            it != roundTripByDevice.end(); ++it)
+    {
+        ostringstream name;
+        name << "round trip for device " << it->first;
+        dumpHistogram(io, name.str(), it->second);
+    }
+    io << flush;
+}
+
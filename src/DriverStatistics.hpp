@@ -0,0 +1,57 @@
+#ifndef PRESSURE_VELKI_DRIVER_STATISTICS_HPP
+#define PRESSURE_VELKI_DRIVER_STATISTICS_HPP
+
+#include <map>
+#include <iosfwd>
+#include <boost/cstdint.hpp>
+#include <pressure_velki/LatencyHistogram.hpp>
+
+namespace pressure_velki
+{
+    /** Timing and error statistics of a DriverClass5_20
+     *
+     * @see DriverClass5_20::getStatistics
+     */
+    struct DriverStatistics
+    {
+        /** Time spent writing requests to the port */
+        LatencyHistogram writeTime;
+        /** Time between the end of a write and the reception of the first
+         * byte of the response
+         */
+        LatencyHistogram firstByteTime;
+        /** Time between the start of a write and the complete reception of a
+         * response, per function code. When several requests are sent in one
+         * write, all their responses are measured from the start of that
+         * write
+         */
+        std::map<int, LatencyHistogram> roundTripByFunction;
+        /** Same as roundTripByFunction, but per device address */
+        std::map<int, LatencyHistogram> roundTripByDevice;
+
+        /** Number of responses received */
+        boost::uint64_t responses;
+        /** Number of responses that did not arrive in time */
+        boost::uint64_t timeouts;
+        /** Number of times requests got sent again after a timeout */
+        boost::uint64_t retries;
+        /** Number of frames with the expected address and function but an
+         * invalid checksum
+         */
+        boost::uint64_t crcFailures;
+        /** Number of received bytes that had to be discarded */
+        boost::uint64_t discardedBytes;
+        /** Number of channel reads that reported the device as powering up */
+        boost::uint64_t poweringUp;
+        /** Number of exception responses, per error code */
+        std::map<int, boost::uint64_t> errors;
+
+        DriverStatistics();
+
+        /** Writes a human-readable summary */
+        void dump(std::ostream& io) const;
+    };
+}
+
+#endif
+
@@ -0,0 +1,243 @@
+#include <pressure_velki/FrameLog.hpp>
+#include <iodrivers_base/Driver.hpp>
+#include <boost/atomic.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace pressure_velki;
+using boost::uint8_t;
+using boost::uint64_t;
+
+static const char MAGIC[8] = { 'V', 'E', 'L', 'K', 'I', 'L', 'O', 'G' };
+static const size_t GROWTH = 1024 * 1024;
+
+static void writeLE(uint8_t* buffer, uint64_t value, int size)
+{
+    for (int i = 0; i < size; ++i)
+        buffer[i] = value >> (8 * i);
+}
+
+static uint64_t readLE(uint8_t const* buffer, int size)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < size; ++i)
+        value |= static_cast<uint64_t>(buffer[i]) << (8 * i);
+    return value;
+}
+
+uint64_t FrameLog::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+FrameRecorder::FrameRecorder()
+    : fd(-1)
+    , mapping(0)
+    , mappingSize(0)
+    , used(0)
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+void FrameRecorder::open(std::string const& path)
+{
+    close();
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        throw iodrivers_base::UnixError("cannot create frame log " + path);
+
+    grow(GROWTH);
+    memcpy(mapping, MAGIC, 8);
+    writeLE(mapping + 8, FrameLog::VERSION, 4);
+    writeLE(mapping + 12, 0, 4);
+    used = FrameLog::HEADER_SIZE;
+}
+
+void FrameRecorder::grow(size_t minimumSize)
+{
+    size_t new_size = mappingSize;
+    while (new_size < minimumSize)
+        new_size += GROWTH;
+    if (ftruncate(fd, new_size) == -1)
+        throw iodrivers_base::UnixError("cannot grow frame log");
+
+    if (mapping)
+        munmap(mapping, mappingSize);
+    void* result = mmap(0, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (result == MAP_FAILED)
+    {
+        mapping = 0;
+        mappingSize = 0;
+        throw iodrivers_base::UnixError("cannot map frame log");
+    }
+    mapping = static_cast<uint8_t*>(result);
+    mappingSize = new_size;
+}
+
+void FrameRecorder::close()
+{
+    if (fd == -1)
+        return;
+
+    if (mapping)
+        munmap(mapping, mappingSize);
+    if (ftruncate(fd, used) == -1)
+    {
+        // Leave the zeroed tail in, readers stop at it anyway
+    }
+    ::close(fd);
+    fd = -1;
+    mapping = 0;
+    mappingSize = 0;
+    used = 0;
+}
+
+bool FrameRecorder::isOpen() const
+{
+    return fd != -1;
+}
+
+void FrameRecorder::record(FrameLog::DIRECTION direction, uint8_t const* data, size_t size)
+{
+    if (fd == -1)
+        throw std::logic_error("FrameRecorder::record() called on a closed recorder");
+
+    uint64_t time = FrameLog::now();
+    while (true)
+    {
+        size_t chunk = std::min<size_t>(size, 255);
+        size_t record_size = FrameLog::RECORD_HEADER_SIZE + chunk;
+        if (used + record_size > mappingSize)
+            grow(used + record_size);
+
+        uint8_t* record = mapping + used;
+        writeLE(record + 8, direction, 1);
+        writeLE(record + 9, chunk, 1);
+        memcpy(record + FrameLog::RECORD_HEADER_SIZE, data, chunk);
+        // Write the timestamp last, as a non-zero timestamp is what makes
+        // the record valid. The fence keeps the compiler and the CPU from
+        // making it visible before the rest of the record
+        boost::atomic_thread_fence(boost::memory_order_release);
+        writeLE(record, time, 8);
+        used += record_size;
+
+        if (chunk == size)
+            return;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+size_t FrameRecorder::getSize() const
+{
+    return used;
+}
+
+FrameLogReader::FrameLogReader()
+    : fd(-1)
+    , mapping(0)
+    , size(0)
+    , position(0)
+{
+}
+
+FrameLogReader::~FrameLogReader()
+{
+    close();
+}
+
+void FrameLogReader::open(std::string const& path)
+{
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw iodrivers_base::UnixError("cannot open frame log " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+        close();
+        throw iodrivers_base::UnixError("cannot stat frame log " + path);
+    }
+    size = info.st_size;
+    if (size < static_cast<size_t>(FrameLog::HEADER_SIZE))
+    {
+        close();
+        throw std::runtime_error(path + " is not a frame log");
+    }
+
+    void* result = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (result == MAP_FAILED)
+    {
+        close();
+        throw iodrivers_base::UnixError("cannot map frame log " + path);
+    }
+    mapping = static_cast<uint8_t const*>(result);
+
+    if (memcmp(mapping, MAGIC, 8) != 0)
+    {
+        close();
+        throw std::runtime_error(path + " is not a frame log");
+    }
+    if (readLE(mapping + 8, 4) != static_cast<uint64_t>(FrameLog::VERSION))
+    {
+        close();
+        throw std::runtime_error(path + " has an unsupported frame log version");
+    }
+    position = FrameLog::HEADER_SIZE;
+}
+
+void FrameLogReader::close()
+{
+    if (mapping)
+        munmap(const_cast<uint8_t*>(mapping), size);
+    if (fd != -1)
+        ::close(fd);
+    fd = -1;
+    mapping = 0;
+    size = 0;
+    position = 0;
+}
+
+bool FrameLogReader::next(FrameLog::Record& record)
+{
+    if (position + FrameLog::RECORD_HEADER_SIZE > size)
+        return false;
+
+    uint8_t const* header = mapping + position;
+    uint64_t time = readLE(header, 8);
+    if (time == 0)
+        return false;
+    // Pairs with the fence in FrameRecorder::record(), for logs that are
+    // read while being recorded
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    int data_size = header[9];
+    if (position + FrameLog::RECORD_HEADER_SIZE + data_size > size)
+        return false;
+
+    record.time = time;
+    record.direction = static_cast<FrameLog::DIRECTION>(header[8]);
+    record.data = header + FrameLog::RECORD_HEADER_SIZE;
+    record.size = data_size;
+    position += FrameLog::RECORD_HEADER_SIZE + data_size;
+    return true;
+}
+
+void FrameLogReader::rewind()
+{
+    if (mapping)
+        position = FrameLog::HEADER_SIZE;
+}
+
@@ -0,0 +1,122 @@
+#ifndef PRESSURE_VELKI_FRAME_LOG_HPP
+#define PRESSURE_VELKI_FRAME_LOG_HPP
+
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace pressure_velki
+{
+    /** Binary log of the data exchanged with the devices
+     *
+     * The file starts with the 8-byte magic "VELKILOG" followed by a 32-bit
+     * version and 32 reserved bits. It is then a sequence of records made of
+     *
+     * - 8 bytes: monotonic timestamp in microseconds
+     * - 1 byte: direction (FrameLog::SENT or FrameLog::RECEIVED)
+     * - 1 byte: data size N
+     * - N bytes: data
+     *
+     * All integers are little-endian. A record with a zero timestamp marks
+     * the end of the log. This is what the unused part of a log looks like
+     * if the process crashed while recording.
+     */
+    namespace FrameLog
+    {
+        enum DIRECTION
+        {
+            SENT = 0,
+            RECEIVED = 1
+        };
+
+        static const int HEADER_SIZE = 16;
+        static const int RECORD_HEADER_SIZE = 10;
+        static const int VERSION = 1;
+
+        struct Record
+        {
+            /** Monotonic timestamp in microseconds */
+            boost::uint64_t time;
+            DIRECTION direction;
+            boost::uint8_t const* data;
+            int size;
+        };
+
+        /** Returns the current time of the clock used in the logs, in
+         * microseconds
+         */
+        boost::uint64_t now();
+    }
+
+    /** Appends frames to a memory-mapped frame log
+     *
+     * The file is grown by chunks and mapped in memory, so that recording a
+     * frame is a memcpy. The file is truncated to its actual size when the
+     * recorder is closed.
+     */
+    class FrameRecorder : boost::noncopyable
+    {
+        int fd;
+        boost::uint8_t* mapping;
+        size_t mappingSize;
+        size_t used;
+
+        void grow(size_t minimumSize);
+
+    public:
+        FrameRecorder();
+        ~FrameRecorder();
+
+        /** Creates a new log, overwriting any existing file */
+        void open(std::string const& path);
+
+        /** Flushes and closes the log */
+        void close();
+
+        bool isOpen() const;
+
+        /** Appends a record. Data longer than 255 bytes is split in several
+         * records
+         */
+        void record(FrameLog::DIRECTION direction, boost::uint8_t const* data, size_t size);
+
+        /** Returns the number of bytes used in the file so far */
+        size_t getSize() const;
+    };
+
+    /** Reads a frame log, mapping it in memory */
+    class FrameLogReader : boost::noncopyable
+    {
+        int fd;
+        boost::uint8_t const* mapping;
+        size_t size;
+        size_t position;
+
+    public:
+        FrameLogReader();
+        ~FrameLogReader();
+
+        /** Opens a log
+         *
+         * @throw std::runtime_error if the file is not a frame log
+         */
+        void open(std::string const& path);
+
+        void close();
+
+        /** Reads the next record
+         *
+         * The record data points into the mapped file, and stays valid until
+         * the reader is closed
+         *
+         * @return false at the end of the log
+         */
+        bool next(FrameLog::Record& record);
+
+        /** Goes back to the first record */
+        void rewind();
+    };
+}
+
+#endif
+
@@ -0,0 +1,178 @@
+#include <pressure_velki/FrameReplay.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+#include <base/Logging.hpp>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+using namespace pressure_velki;
+using boost::uint8_t;
+using boost::uint64_t;
+
+FrameReplay::FrameReplay()
+    : fd(-1)
+    , driver(0)
+    , realTime(false)
+    , running(false)
+    , finished(false)
+    , mismatches(0)
+{
+}
+
+FrameReplay::~FrameReplay()
+{
+    stop();
+    if (fd != -1)
+        ::close(fd);
+}
+
+void FrameReplay::open(std::string const& path)
+{
+    reader.open(path);
+}
+
+void FrameReplay::setRealTime(bool enable)
+{
+    realTime = enable;
+}
+
+void FrameReplay::attach(DriverClass5_20& driver)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+        throw iodrivers_base::UnixError("FrameReplay: cannot create the socket pair");
+
+    detach();
+    fd = fds[0];
+    this->driver = &driver;
+    savedSilence = driver.getMinimumInterFrameSilence();
+    driver.setFileDescriptor(fds[1]);
+    if (!realTime)
+        driver.setMinimumInterFrameSilence(base::Time());
+}
+
+void FrameReplay::detach()
+{
+    stop();
+    if (driver)
+    {
+        driver->close();
+        driver->setMinimumInterFrameSilence(savedSilence);
+        driver = 0;
+    }
+    if (fd != -1)
+        ::close(fd);
+    fd = -1;
+}
+
+void FrameReplay::start()
+{
+    if (fd == -1)
+        throw std::logic_error("FrameReplay::start() called before attach()");
+    if (running)
+        return;
+
+    reader.rewind();
+    finished = false;
+    running = true;
+    thread = boost::thread(&FrameReplay::run, this);
+}
+
+void FrameReplay::stop()
+{
+    if (!running)
+        return;
+    running = false;
+    thread.join();
+}
+
+bool FrameReplay::isFinished() const
+{
+    return finished;
+}
+
+uint64_t FrameReplay::getMismatches() const
+{
+    return mismatches;
+}
+
+bool FrameReplay::readFromDriver(uint8_t* buffer, int size)
+{
+    int received = 0;
+    while (received < size)
+    {
+        if (!running)
+            return false;
+
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(fd, &set);
+        timeval timeout = { 0, 100000 };
+        int ret = select(fd + 1, &set, 0, 0, &timeout);
+        if (ret < 0 && errno != EINTR)
+            throw iodrivers_base::UnixError("FrameReplay: select failed");
+        if (ret <= 0)
+            continue;
+
+        ssize_t count = ::read(fd, buffer + received, size - received);
+        if (count == 0)
+            return false;
+        else if (count < 0 && errno != EINTR && errno != EAGAIN)
+            throw iodrivers_base::UnixError("FrameReplay: read failed");
+        else if (count > 0)
+            received += count;
+    }
+    return true;
+}
+
+void FrameReplay::writeToDriver(uint8_t const* buffer, int size)
+{
+    int written = 0;
+    while (written < size)
+    {
+        ssize_t count = ::write(fd, buffer + written, size - written);
+        if (count < 0 && errno != EINTR && errno != EAGAIN)
+            throw iodrivers_base::UnixError("FrameReplay: write failed");
+        else if (count > 0)
+            written += count;
+    }
+}
+
+void FrameReplay::run()
+{
+    uint64_t log_start = 0;
+    uint64_t replay_start = FrameLog::now();
+
+    FrameLog::Record record;
+    uint8_t buffer[256];
+    while (running && reader.next(record))
+    {
+        if (log_start == 0)
+            log_start = record.time;
+
+        if (record.direction == FrameLog::SENT)
+        {
+            if (!readFromDriver(buffer, record.size))
+                break;
+            if (memcmp(buffer, record.data, record.size) != 0)
+            {
+                LOG_WARN_S << "replay: the driver sent something different from the log";
+                ++mismatches;
+            }
+            continue;
+        }
+
+        if (realTime)
+        {
+            uint64_t target = replay_start + (record.time - log_start);
+            uint64_t now = FrameLog::now();
+            if (target > now)
+                usleep(target - now);
+        }
+        writeToDriver(record.data, record.size);
+    }
+    finished = true;
+}
+
@@ -0,0 +1,87 @@
+#ifndef PRESSURE_VELKI_FRAME_REPLAY_HPP
+#define PRESSURE_VELKI_FRAME_REPLAY_HPP
+
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <base/Time.hpp>
+#include <pressure_velki/FrameLog.hpp>
+
+namespace pressure_velki
+{
+    class DriverClass5_20;
+
+    /** Replays a frame log into a driver
+     *
+     * attach() connects the driver to one end of a socket pair, and the
+     * replay feeds the received frames of the log to the other end. The
+     * replay runs in lockstep with the driver: every sent record is only
+     * considered done once the driver wrote the same number of bytes. The
+     * code that uses the driver must therefore issue the same requests as
+     * the code that recorded the log.
+     *
+     * In real-time mode, received frames are delayed as in the log. Otherwise,
+     * they are fed as soon as the driver wrote the corresponding request, and
+     * the driver's minimum inter-frame silence is removed until detach(),
+     * which allows to profile the decoding of hours of traffic in seconds.
+     */
+    class FrameReplay
+    {
+        FrameLogReader reader;
+        int fd;
+        DriverClass5_20* driver;
+        base::Time savedSilence;
+        bool realTime;
+        boost::atomic<bool> running;
+        boost::atomic<bool> finished;
+        boost::atomic<boost::uint64_t> mismatches;
+        boost::thread thread;
+
+        void run();
+        bool readFromDriver(boost::uint8_t* buffer, int size);
+        void writeToDriver(boost::uint8_t const* buffer, int size);
+
+    public:
+        FrameReplay();
+        ~FrameReplay();
+
+        /** Opens the log that should be replayed */
+        void open(std::string const& path);
+
+        /** Sets whether the received frames should be delayed as in the log.
+         * It is false by default
+         */
+        void setRealTime(bool enable);
+
+        /** Connects the driver to the replay
+         *
+         * This replaces any port the driver may have opened
+         */
+        void attach(DriverClass5_20& driver);
+
+        /** Stops the replay and gives the driver its minimum inter-frame
+         * silence back
+         *
+         * The driver is left without a port. Call it before the driver gets
+         * destroyed if the replay outlives it.
+         */
+        void detach();
+
+        /** Starts feeding the driver in a background thread */
+        void start();
+
+        /** Stops the replay */
+        void stop();
+
+        /** Returns true once the whole log has been replayed */
+        bool isFinished() const;
+
+        /** Returns the number of sent records whose data did not match what
+         * the driver wrote
+         */
+        boost::uint64_t getMismatches() const;
+    };
+}
+
+#endif
+
@@ -0,0 +1,82 @@
+#include <pressure_velki/FrameScanner.hpp>
+#include <pressure_velki/Packet.hpp>
+#include <string.h>
+
+using namespace pressure_velki;
+
+FrameScanner::FrameScanner()
+    : address(-1)
+    , function(-1)
+    , payloadSize(0)
+    , discardedBytes(0)
+    , crcFailures(0)
+{
+}
+
+void FrameScanner::expect(int address, int function, int payloadSize)
+{
+    this->address = address;
+    this->function = function;
+    this->payloadSize = payloadSize;
+}
+
+size_t FrameScanner::findNextCandidate(boost::uint8_t const* buffer, size_t size) const
+{
+    boost::uint8_t const* it = buffer + 1;
+    boost::uint8_t const* end = buffer + size;
+    while (it != end)
+    {
+        it = static_cast<boost::uint8_t const*>(memchr(it, address, end - it));
+        if (!it)
+            return size;
+        // The last byte is a candidate as long as its function byte has not
+        // been received yet
+        if (it + 1 == end || (it[1] & 0x7F) == function)
+            return it - buffer;
+        ++it;
+    }
+    return size;
+}
+
+int FrameScanner::scan(boost::uint8_t const* buffer, size_t size)
+{
+    if (size == 0)
+        return 0;
+
+    bool candidate = (buffer[0] == address) &&
+        (size < 2 || (buffer[1] & 0x7F) == function);
+    if (candidate)
+    {
+        if (size < 2)
+            return 0;
+
+        // Exception responses have a single byte of payload, the error code
+        size_t packet_size = (buffer[1] & 0x80) ? 5 : payloadSize + 4;
+        if (size < packet_size)
+            return 0;
+        if (Packet::isChecksumValid(buffer, buffer + packet_size))
+            return packet_size;
+        ++crcFailures;
+    }
+
+    size_t skip = findNextCandidate(buffer, size);
+    discardedBytes += skip;
+    return -static_cast<int>(skip);
+}
+
+boost::uint64_t FrameScanner::getDiscardedBytes() const
+{
+    return discardedBytes;
+}
+
+boost::uint64_t FrameScanner::getCRCFailures() const
+{
+    return crcFailures;
+}
+
+void FrameScanner::resetCounters()
+{
+    discardedBytes = 0;
+    crcFailures = 0;
+}
+
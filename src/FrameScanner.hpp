@@ -0,0 +1,68 @@
+#ifndef PRESSURE_VELKI_FRAME_SCANNER_HPP
+#define PRESSURE_VELKI_FRAME_SCANNER_HPP
+
+#include <boost/cstdint.hpp>
+#include <stddef.h>
+
+namespace pressure_velki
+{
+    /** Finds the expected response in a possibly corrupted stream
+     *
+     * scan() follows the iodrivers_base::Driver::extractPacket contract.
+     * When the data at the start of the buffer cannot be the expected
+     * response, it does not drop a single byte and let the caller try again.
+     * It looks ahead for the next position where both the address and the
+     * function match, and skips directly to it. Only candidates that have
+     * the right address and function get their checksum verified. This keeps
+     * the work linear in the number of bytes received, even on a noisy
+     * line.
+     */
+    class FrameScanner
+    {
+        int address;
+        int function;
+        int payloadSize;
+
+        boost::uint64_t discardedBytes;
+        boost::uint64_t crcFailures;
+
+        /** Returns the offset of the first position after the start of the
+         * buffer that could be the start of the expected response
+         */
+        size_t findNextCandidate(boost::uint8_t const* buffer, size_t size) const;
+
+    public:
+        FrameScanner();
+
+        /** Sets the response that should be looked for
+         *
+         * @param address the address of the device that should reply
+         * @param function the function of the request
+         * @param payloadSize the payload size of a successful response.
+         *   Exception responses are recognized as well.
+         */
+        void expect(int address, int function, int payloadSize);
+
+        /** Looks for the expected response at the start of the buffer
+         *
+         * @return the size of the response if the buffer starts with it, 0 if
+         *   more data is needed to decide and -N if the first N bytes should be
+         *   discarded
+         */
+        int scan(boost::uint8_t const* buffer, size_t size);
+
+        /** Returns the number of bytes scan() asked to discard so far */
+        boost::uint64_t getDiscardedBytes() const;
+
+        /** Returns the number of candidates that had the expected address and
+         * function but an invalid checksum
+         */
+        boost::uint64_t getCRCFailures() const;
+
+        /** Resets the counters */
+        void resetCounters();
+    };
+}
+
+#endif
+
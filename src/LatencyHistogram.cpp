@@ -0,0 +1,118 @@
+#include <pressure_velki/LatencyHistogram.hpp>
+#include <algorithm>
+#include <string.h>
+
+using namespace pressure_velki;
+using boost::uint64_t;
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+int LatencyHistogram::getBucketIndex(uint64_t value)
+{
+    if (value < static_cast<uint64_t>(SUB_BUCKET_COUNT))
+        return value;
+
+    int magnitude = 63 - __builtin_clzll(value);
+    if (magnitude >= 32)
+        return BUCKET_COUNT - 1;
+
+    int shift = magnitude - SUB_BUCKET_BITS;
+    int sub_bucket = (value >> shift) - SUB_BUCKET_COUNT;
+    return SUB_BUCKET_COUNT * (shift + 1) + sub_bucket;
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(int index)
+{
+    if (index < SUB_BUCKET_COUNT)
+        return index;
+
+    int shift = index / SUB_BUCKET_COUNT - 1;
+    int sub_bucket = index % SUB_BUCKET_COUNT;
+    return ((static_cast<uint64_t>(SUB_BUCKET_COUNT + sub_bucket + 1)) << shift) - 1;
+}
+
+void LatencyHistogram::record(base::Time const& duration)
+{
+    int64_t microseconds = duration.toMicroseconds();
+    record(static_cast<uint64_t>(microseconds < 0 ? 0 : microseconds));
+}
+
+void LatencyHistogram::record(uint64_t microseconds)
+{
+    ++counts[getBucketIndex(microseconds)];
+    if (count == 0 || microseconds < min)
+        min = microseconds;
+    if (microseconds > max)
+        max = microseconds;
+    ++count;
+    sum += microseconds;
+}
+
+void LatencyHistogram::reset()
+{
+    memset(counts, 0, sizeof(counts));
+    count = 0;
+    sum = 0;
+    min = 0;
+    max = 0;
+}
+
+void LatencyHistogram::merge(LatencyHistogram const& other)
+{
+    if (other.count == 0)
+        return;
+
+    for (int i = 0; i < BUCKET_COUNT; ++i)
+        counts[i] += other.counts[i];
+    if (count == 0 || other.min < min)
+        min = other.min;
+    if (other.max > max)
+        max = other.max;
+    count += other.count;
+    sum += other.sum;
+}
+
+uint64_t LatencyHistogram::getCount() const
+{
+    return count;
+}
+
+base::Time LatencyHistogram::getMin() const
+{
+    return base::Time::fromMicroseconds(min);
+}
+
+base::Time LatencyHistogram::getMax() const
+{
+    return base::Time::fromMicroseconds(max);
+}
+
+base::Time LatencyHistogram::getMean() const
+{
+    if (count == 0)
+        return base::Time();
+    return base::Time::fromMicroseconds(sum / count);
+}
+
+base::Time LatencyHistogram::getPercentile(double fraction) const
+{
+    if (count == 0)
+        return base::Time();
+
+    uint64_t target = static_cast<uint64_t>(fraction * count + 0.5);
+    if (target == 0)
+        target = 1;
+
+    uint64_t accumulated = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i)
+    {
+        accumulated += counts[i];
+        if (accumulated >= target)
+            return base::Time::fromMicroseconds(std::min(getBucketUpperBound(i), max));
+    }
+    return base::Time::fromMicroseconds(max);
+}
+
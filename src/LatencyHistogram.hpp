@@ -0,0 +1,65 @@
+#ifndef PRESSURE_VELKI_LATENCY_HISTOGRAM_HPP
+#define PRESSURE_VELKI_LATENCY_HISTOGRAM_HPP
+
+#include <boost/cstdint.hpp>
+#include <base/Time.hpp>
+
+namespace pressure_velki
+{
+    /** Fixed-memory histogram of durations
+     *
+     * It uses a log-linear bucketing, as HDR histograms do: durations below 16
+     * microseconds get their own bucket, and each power of two above that is
+     * split in 16 buckets. The relative error on the reported values is
+     * therefore below 6.25%, over a range going from one microsecond to more
+     * than one hour.
+     */
+    class LatencyHistogram
+    {
+    public:
+        static const int SUB_BUCKET_BITS = 4;
+        static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+        static const int MAGNITUDE_COUNT = 32 - SUB_BUCKET_BITS;
+        static const int BUCKET_COUNT = SUB_BUCKET_COUNT * (MAGNITUDE_COUNT + 1);
+
+    private:
+        boost::uint32_t counts[BUCKET_COUNT];
+        boost::uint64_t count;
+        boost::uint64_t sum;
+        boost::uint64_t min;
+        boost::uint64_t max;
+
+        static int getBucketIndex(boost::uint64_t value);
+        static boost::uint64_t getBucketUpperBound(int index);
+
+    public:
+        LatencyHistogram();
+
+        /** Adds a duration */
+        void record(base::Time const& duration);
+
+        /** Adds a duration in microseconds */
+        void record(boost::uint64_t microseconds);
+
+        /** Removes all recorded durations */
+        void reset();
+
+        /** Adds the durations of another histogram to this one */
+        void merge(LatencyHistogram const& other);
+
+        boost::uint64_t getCount() const;
+        base::Time getMin() const;
+        base::Time getMax() const;
+        base::Time getMean() const;
+
+        /** Returns the duration below which the given fraction of the
+         * recorded durations are
+         *
+         * @param fraction between 0 and 1, e.g. 0.99 for the 99th percentile
+         */
+        base::Time getPercentile(double fraction) const;
+    };
+}
+
+#endif
+
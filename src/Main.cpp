@@ -1,36 +1,387 @@
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
 #include <pressure_velki/DriverClass5_20.hpp>
-#include <base/Pressure.hpp>
+#include <pressure_velki/BusDiscovery.hpp>
+#include <pressure_velki/LatencyHistogram.hpp>
+#include "ChannelNames.hpp"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 using namespace pressure_velki;
 using namespace std;
 
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleInterrupt(int)
+{
+    interrupted = 1;
+}
+
+namespace
+{
+    enum FORMAT
+    {
+        FORMAT_CSV,
+        FORMAT_BINARY
+    };
+
+    struct Options
+    {
+        vector<int> devices;
+        vector<DriverClass5_20::CHANNEL_ID> channels;
+        double rate;
+        FORMAT format;
+        string output;
+        double summaryPeriod;
+        double duration;
+        string trace;
+        bool initialize;
+        bool scan;
+        int maxMisses;
+
+        Options()
+            : rate(0)
+            , format(FORMAT_CSV)
+            , summaryPeriod(1)
+            , duration(0)
+            , initialize(true)
+            , scan(false)
+            , maxMisses(0) {}
+    };
+
+    char const* const STATUS_NAMES[] = { "ok", "saturated", "channel_error",
+        "powering_up", "timeout", "device_error" };
+
+    const char BINARY_MAGIC[8] = { 'V', 'E', 'L', 'K', 'I', 'S', 'M', 'P' };
+    const int BINARY_VERSION = 1;
+    const int BINARY_RECORD_SIZE = 16;
+
+    void usage(char const* name)
+    {
+        cerr << "usage: " << name << " [OPTIONS] URI\n"
+            << "reads channels of Velki class 5.20 devices and writes the samples on the\n"
+            << "standard output\n"
+            << "\n"
+            << "  -d ADDRESS    read this device. Repeat for several devices. Defaults\n"
+            << "                to the point-to-point address\n"
+            << "  -c CHANNELS   comma-separated list of channels among calc, p0, p1, t,\n"
+            << "                t0 and t1 (temperatures of p0 and p1). Defaults to\n"
+            << "                p0,t0,p1,t1\n"
+            << "  -r RATE       target number of cycles per second, where a cycle reads\n"
+            << "                all channels of all devices once. Defaults to 0, which\n"
+            << "                runs as fast as the bus allows\n"
+            << "  -f FORMAT     csv (the default) or binary\n"
+            << "  -o FILE       write the samples in FILE instead of the standard output\n"
+            << "  -s SECONDS    period of the rate and latency summaries written on the\n"
+            << "                standard error. Defaults to 1, set to 0 to disable\n"
+            << "  -t SECONDS    stop after this duration. Defaults to 0, which runs\n"
+            << "                until interrupted with Ctrl+C\n"
+            << "  -T FILE       keep the last I/O events in FILE. Display them with\n"
+            << "                pressure_velki_trace_dump\n"
+            << "  -n            do not initialize the devices\n"
+            << "  -S            list the devices present on the bus (addresses 1 to 249)\n"
+            << "                instead of reading them\n"
+            << "  -m MISSES     with -S, stop after that many consecutive empty\n"
+            << "                addresses. Defaults to 0, which scans all addresses\n"
+            << "\n"
+            << "The CSV columns are time (in seconds), device, channel, value (in bar or\n"
+            << "celsius) and status. The binary format is the 8-byte magic VELKISMP, a\n"
+            << "32-bit version and the 32-bit record size, followed by 16-byte records:\n"
+            << "the 64-bit time in microseconds, the device, channel and status bytes,\n"
+            << "one padding byte and the value as a 32-bit float. All fields are\n"
+            << "little-endian" << endl;
+    }
+
+    void writeLE(unsigned char* buffer, boost::uint64_t value, int size)
+    {
+        for (int i = 0; i < size; ++i)
+            buffer[i] = value >> (8 * i);
+    }
+
+    void writeHeader(FILE* output, FORMAT format)
+    {
+        if (format == FORMAT_CSV)
+        {
+            fputs("time,device,channel,value,status\n", output);
+            return;
+        }
+
+        unsigned char header[16];
+        memcpy(header, BINARY_MAGIC, 8);
+        writeLE(header + 8, BINARY_VERSION, 4);
+        writeLE(header + 12, BINARY_RECORD_SIZE, 4);
+        fwrite(header, 1, 16, output);
+    }
+
+    void writeSample(FILE* output, FORMAT format, Sample const& sample)
+    {
+        boost::int64_t time = sample.time.toMicroseconds();
+        if (format == FORMAT_CSV)
+        {
+            fprintf(output, "%lld.%06lld,%d,%s,%.7g,%s\n",
+                    static_cast<long long>(time / 1000000),
+                    static_cast<long long>(time % 1000000),
+                    sample.device, CHANNEL_NAMES[sample.channel],
+                    sample.value, STATUS_NAMES[sample.status]);
+            return;
+        }
+
+        unsigned char record[BINARY_RECORD_SIZE];
+        writeLE(record, time, 8);
+        record[8] = sample.device;
+        record[9] = sample.channel;
+        record[10] = sample.status;
+        record[11] = 0;
+        boost::uint32_t value;
+        memcpy(&value, &sample.value, 4);
+        writeLE(record + 12, value, 4);
+        fwrite(record, 1, BINARY_RECORD_SIZE, output);
+    }
+
+    /** What happened since the last summary */
+    struct Summary
+    {
+        base::Time start;
+        int cycles;
+        int lateCycles;
+        int samples;
+        int failures[6];
+        /** Time taken by reading all channels of one device */
+        LatencyHistogram latency;
+
+        explicit Summary(base::Time const& start)
+            : start(start)
+            , cycles(0)
+            , lateCycles(0)
+            , samples(0)
+        {
+            fill(failures, failures + 6, 0);
+        }
+
+        void merge(Summary const& other)
+        {
+            cycles += other.cycles;
+            lateCycles += other.lateCycles;
+            samples += other.samples;
+            for (int i = 0; i < 6; ++i)
+                failures[i] += other.failures[i];
+            latency.merge(other.latency);
+        }
+
+        void write(FILE* io, base::Time const& origin, base::Time const& now) const
+        {
+            double elapsed = (now - start).toSeconds();
+            if (elapsed <= 0)
+                return;
+
+            fprintf(io, "[%8.1fs] %.1f cycles/s %.1f samples/s, %d late cycles,"
+                    " failures: %d saturated %d channel errors %d powering up"
+                    " %d timeouts %d device errors",
+                    (now - origin).toSeconds(), cycles / elapsed, samples / elapsed, lateCycles,
+                    failures[Sample::STATUS_SATURATED], failures[Sample::STATUS_CHANNEL_ERROR],
+                    failures[Sample::STATUS_POWERING_UP], failures[Sample::STATUS_TIMEOUT],
+                    failures[Sample::STATUS_DEVICE_ERROR]);
+            if (latency.getCount())
+            {
+                fprintf(io, ", latency p50=%lldus p99=%lldus max=%lldus",
+                        static_cast<long long>(latency.getPercentile(0.5).toMicroseconds()),
+                        static_cast<long long>(latency.getPercentile(0.99).toMicroseconds()),
+                        static_cast<long long>(latency.getMax().toMicroseconds()));
+            }
+            fputs("\n", io);
+        }
+    };
+}
+
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    Options options;
+    options.channels.push_back(DriverClass5_20::CHANNEL_PRESSURE0);
+    options.channels.push_back(DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE0);
+    options.channels.push_back(DriverClass5_20::CHANNEL_PRESSURE1);
+    options.channels.push_back(DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE1);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:c:r:f:o:s:t:T:nSm:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'd': options.devices.push_back(atoi(optarg)); break;
+            case 'c':
+                if (!parseChannels(optarg, options.channels))
+                {
+                    cerr << "invalid channel list " << optarg << endl;
+                    return 1;
+                }
+                break;
+            case 'r': options.rate = atof(optarg); break;
+            case 'f':
+                if (string(optarg) == "csv")
+                    options.format = FORMAT_CSV;
+                else if (string(optarg) == "binary")
+                    options.format = FORMAT_BINARY;
+                else
+                {
+                    cerr << "unknown format " << optarg << endl;
+                    return 1;
+                }
+                break;
+            case 'o': options.output = optarg; break;
+            case 's': options.summaryPeriod = atof(optarg); break;
+            case 't': options.duration = atof(optarg); break;
+            case 'T': options.trace = optarg; break;
+            case 'n': options.initialize = false; break;
+            case 'S': options.scan = true; break;
+            case 'm': options.maxMisses = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1)
     {
-        cerr << "usage: " << argv[0] << " DEVICE" << endl;
+        usage(argv[0]);
         return 1;
     }
+    if (options.devices.empty())
+        options.devices.push_back(static_cast<int>(Packet::ADDRESS_POINT_TO_POINT));
 
+    boost::scoped_ptr<TraceRing> trace;
     DriverClass5_20 driver;
-    driver.openURI(argv[1]);
-    DeviceInfo info = driver.initialize();
-    cout << "Device: class=" << info.deviceClass << ", group=" << info.deviceGroup << "\n" <<
-        "Firmware: year=" << info.firmwareYear << ", week=" << info.firmwareWeek << "\n" <<
-        "Internal buffer size: " << info.internalBufferSize << " bytes" << endl;
+    if (!options.trace.empty())
+    {
+        trace.reset(new TraceRing(options.trace, 16384));
+        driver.setTrace(trace.get());
+    }
+    driver.openURI(argv[optind]);
 
-    bool absolute = driver.isAbsolute();
-    cout << "This device measures " << (absolute ? "absolute" : "relative") << " pressures" << endl;
+    if (options.scan)
+    {
+        BusDiscovery discovery(driver);
+        discovery.setMaxConsecutiveMisses(options.maxMisses);
+        base::Time scanStart = base::Time::now();
+        vector<BusDiscovery::Device> devices = discovery.scan();
+        cout << "address,serial,class,group,firmware_year,firmware_week,buffer_size\n";
+        for (size_t i = 0; i < devices.size(); ++i)
+        {
+            BusDiscovery::Device const& device = devices[i];
+            cout << device.address << "," << device.serialNumber << "," <<
+                device.info.deviceClass << "," << device.info.deviceGroup << "," <<
+                device.info.firmwareYear << "," << device.info.firmwareWeek << "," <<
+                device.info.internalBufferSize << "\n";
+        }
+        cout << flush;
+        cerr << "Found " << devices.size() << " devices with " << discovery.getProbeCount() <<
+            " probes in " << (base::Time::now() - scanStart).toSeconds() << "s" << endl;
+        return 0;
+    }
+
+    // The samples go to stdout, everything else to stderr
+    for (size_t i = 0; i < options.devices.size() && options.initialize; ++i)
+    {
+        int device = options.devices[i];
+        DeviceInfo info = driver.initialize(device);
+        cerr << "Device " << device << ": class=" << info.deviceClass << ", group=" << info.deviceGroup << "\n" <<
+            "  Firmware: year=" << info.firmwareYear << ", week=" << info.firmwareWeek << "\n" <<
+            "  Internal buffer size: " << info.internalBufferSize << " bytes\n" <<
+            "  Measures " << (driver.isAbsolute(device) ? "absolute" : "relative") << " pressures" << endl;
+    }
+
+    FILE* output = stdout;
+    if (!options.output.empty())
+    {
+        output = fopen(options.output.c_str(), "wb");
+        if (!output)
+        {
+            perror(options.output.c_str());
+            return 1;
+        }
+    }
+    // Flushing on every sample is what limits the rate, let the buffer fill
+    // up instead
+    static char outputBuffer[1 << 20];
+    setvbuf(output, outputBuffer, _IOFBF, sizeof(outputBuffer));
+    writeHeader(output, options.format);
+
+    base::Time start = base::Time::now();
+    base::Time end;
+    if (options.duration > 0)
+        end = start + base::Time::fromSeconds(options.duration);
+    base::Time period;
+    if (options.rate > 0)
+        period = base::Time::fromSeconds(1.0 / options.rate);
+    base::Time summaryPeriod = base::Time::fromSeconds(options.summaryPeriod);
+
+    Summary total(start);
+    Summary summary(start);
+    base::Time nextCycle = start;
+    vector<Sample> samples;
 
-    while (true)
+    // Stop on Ctrl+C and display the statistics
+    signal(SIGINT, handleInterrupt);
+    while (!interrupted)
     {
-        cout
-            << "P0=" << driver.readPressure(0).toBar() << "bar T0=" << driver.readTemperatureOfPressureSensor(0) << "C"
-            << " "
-            << "P1=" << driver.readPressure(1).toBar() << "bar T1=" << driver.readTemperatureOfPressureSensor(1) << "C"
-            << endl;
+        base::Time now = base::Time::now();
+        if (!end.isNull() && now >= end)
+            break;
+        if (!summaryPeriod.isNull() && now - summary.start >= summaryPeriod)
+        {
+            summary.write(stderr, start, now);
+            total.merge(summary);
+            summary = Summary(now);
+        }
+
+        try
+        {
+            for (size_t i = 0; i < options.devices.size(); ++i)
+            {
+                base::Time readStart = base::Time::now();
+                driver.tryReadChannels(options.channels, samples, options.devices[i]);
+                summary.latency.record(base::Time::now() - readStart);
+                for (size_t s = 0; s < samples.size(); ++s)
+                {
+                    writeSample(output, options.format, samples[s]);
+                    ++summary.failures[samples[s].status];
+                }
+                summary.samples += samples.size();
+            }
+        }
+        catch(iodrivers_base::UnixError const&)
+        {
+            // The signal interrupted a read
+            if (interrupted)
+                break;
+            throw;
+        }
+        ++summary.cycles;
+
+        if (period.isNull())
+            continue;
+        nextCycle = nextCycle + period;
+        now = base::Time::now();
+        if (nextCycle > now)
+            usleep((nextCycle - now).toMicroseconds());
+        else
+        {
+            ++summary.lateCycles;
+            nextCycle = now;
+        }
     }
 
+    if (output != stdout)
+        fclose(output);
+    else
+        fflush(output);
+
+    total.merge(summary);
+    fputs("Total: ", stderr);
+    total.write(stderr, start, base::Time::now());
+    driver.getStatistics().dump(cerr);
     return 0;
 }
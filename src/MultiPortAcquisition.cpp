@@ -0,0 +1,235 @@
+#include <pressure_velki/MultiPortAcquisition.hpp>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace pressure_velki;
+using namespace std;
+
+bool MultiPortAcquisition::PendingSample::operator < (PendingSample const& other) const
+{
+    return sample.time < other.sample.time;
+}
+
+MultiPortAcquisition::MultiPortAcquisition(size_t ringCapacity)
+    : ringCapacity(ringCapacity)
+    , workerCount(0)
+    , snapshotPeriod(base::Time::fromMilliseconds(100))
+    , maximumDelay(base::Time::fromSeconds(1))
+    , running(false)
+{
+}
+
+MultiPortAcquisition::~MultiPortAcquisition()
+{
+    stop();
+    for (size_t i = 0; i < ports.size(); ++i)
+        delete ports[i];
+}
+
+int MultiPortAcquisition::addPort()
+{
+    if (isRunning())
+        throw std::logic_error("cannot add ports while the acquisition runs");
+
+    ports.push_back(new Acquisition(ringCapacity));
+    portTimes.push_back(base::Time());
+    return ports.size() - 1;
+}
+
+int MultiPortAcquisition::getPortCount() const
+{
+    return ports.size();
+}
+
+Acquisition& MultiPortAcquisition::getPort(int port)
+{
+    return *ports.at(port);
+}
+
+void MultiPortAcquisition::addDevice(int port, int device, Acquisition::Channels const& channels)
+{
+    if (isRunning())
+        throw std::logic_error("cannot add devices while the acquisition runs");
+
+    ports.at(port)->addDevice(device, channels);
+    for (size_t i = 0; i < channels.size(); ++i)
+    {
+        Sensor sensor;
+        sensor.port = port;
+        sensor.device = device;
+        sensor.channel = channels[i];
+        sensorIndices[make_pair(port, make_pair(device, static_cast<int>(channels[i])))] = sensors.size();
+        sensors.push_back(sensor);
+
+        Sample sample;
+        sample.device = device;
+        sample.channel = channels[i];
+        current.push_back(sample);
+    }
+}
+
+vector<MultiPortAcquisition::Sensor> const& MultiPortAcquisition::getSensors() const
+{
+    return sensors;
+}
+
+void MultiPortAcquisition::setWorkerCount(int count)
+{
+    workerCount = count;
+}
+
+void MultiPortAcquisition::setPeriod(base::Time const& period)
+{
+    this->period = period;
+}
+
+void MultiPortAcquisition::setSnapshotPeriod(base::Time const& period)
+{
+    snapshotPeriod = period;
+}
+
+void MultiPortAcquisition::setMaximumDelay(base::Time const& delay)
+{
+    maximumDelay = delay;
+}
+
+void MultiPortAcquisition::start()
+{
+    if (isRunning())
+        return;
+
+    running = true;
+    nextSnapshot = base::Time::now() + snapshotPeriod;
+    if (workerCount <= 0 || workerCount >= static_cast<int>(ports.size()))
+    {
+        for (size_t i = 0; i < ports.size(); ++i)
+        {
+            ports[i]->setPeriod(period);
+            ports[i]->start();
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < ports.size(); ++i)
+            ports[i]->clearFailure();
+        for (int i = 0; i < workerCount; ++i)
+            workers.create_thread(boost::bind(&MultiPortAcquisition::runWorker, this, i));
+    }
+}
+
+void MultiPortAcquisition::stop()
+{
+    if (!isRunning())
+        return;
+
+    running = false;
+    for (size_t i = 0; i < ports.size(); ++i)
+        ports[i]->stop();
+    workers.join_all();
+}
+
+bool MultiPortAcquisition::isRunning() const
+{
+    return running;
+}
+
+void MultiPortAcquisition::runWorker(int worker)
+{
+    base::Time next_cycle = base::Time::now();
+    while (running)
+    {
+        // A failed port is left alone, the others keep being polled
+        for (size_t i = worker; i < ports.size(); i += workerCount)
+        {
+            if (!ports[i]->hasFailed())
+                ports[i]->tryPollOnce();
+        }
+        if (period.isNull())
+            continue;
+
+        next_cycle = next_cycle + period;
+        base::Time now = base::Time::now();
+        if (next_cycle > now)
+            usleep((next_cycle - now).toMicroseconds());
+        else
+            next_cycle = now;
+    }
+}
+
+size_t MultiPortAcquisition::update(vector<Snapshot>& snapshots)
+{
+    if (ports.empty())
+        return 0;
+    if (nextSnapshot.isNull())
+        nextSnapshot = base::Time::now() + snapshotPeriod;
+
+    size_t first_new = pending.size();
+    for (size_t port = 0; port < ports.size(); ++port)
+    {
+        drained.clear();
+        ports[port]->drain(drained);
+        for (size_t i = 0; i < drained.size(); ++i)
+        {
+            Sample const& sample = drained[i];
+            portTimes[port] = std::max(portTimes[port], sample.time);
+
+            map<pair<int, pair<int, int> >, int>::const_iterator it =
+                sensorIndices.find(make_pair(static_cast<int>(port), make_pair(sample.device, sample.channel)));
+            if (it == sensorIndices.end())
+                continue;
+
+            PendingSample entry;
+            entry.sample = sample;
+            entry.sensor = it->second;
+            pending.push_back(entry);
+        }
+    }
+    // The samples of each port are already ordered, and the ones that
+    // were pending are ordered as well
+    stable_sort(pending.begin() + first_new, pending.end());
+    inplace_merge(pending.begin(), pending.begin() + first_new, pending.end());
+
+    // Snapshots can be produced up to the time all ports have reached,
+    // without waiting more than maximumDelay for any of them. Failed ports
+    // will not deliver anything anymore
+    base::Time watermark;
+    for (size_t port = 0; port < ports.size(); ++port)
+    {
+        if (ports[port]->hasFailed())
+            continue;
+        if (watermark.isNull() || portTimes[port] < watermark)
+            watermark = portTimes[port];
+    }
+    watermark = std::max(watermark, base::Time::now() - maximumDelay);
+
+    size_t count = 0;
+    size_t applied = 0;
+    while (nextSnapshot <= watermark)
+    {
+        for (; applied < pending.size() && pending[applied].sample.time <= nextSnapshot; ++applied)
+        {
+            Sample& sample = current[pending[applied].sensor];
+            if (pending[applied].sample.time >= sample.time)
+                sample = pending[applied].sample;
+        }
+
+        Snapshot snapshot;
+        snapshot.time = nextSnapshot;
+        snapshots.push_back(snapshot);
+        snapshots.back().samples = current;
+        ++count;
+        nextSnapshot = nextSnapshot + snapshotPeriod;
+    }
+    pending.erase(pending.begin(), pending.begin() + applied);
+    return count;
+}
+
+boost::uint64_t MultiPortAcquisition::getOverruns() const
+{
+    boost::uint64_t overruns = 0;
+    for (size_t i = 0; i < ports.size(); ++i)
+        overruns += ports[i]->getOverruns();
+    return overruns;
+}
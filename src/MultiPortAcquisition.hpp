@@ -0,0 +1,154 @@
+#ifndef PRESSURE_VELKI_MULTI_PORT_ACQUISITION_HPP
+#define PRESSURE_VELKI_MULTI_PORT_ACQUISITION_HPP
+
+#include <map>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <pressure_velki/Acquisition.hpp>
+
+namespace pressure_velki
+{
+    /** Continuous acquisition on several ports, with time-aligned output
+     *
+     * Each port is an Acquisition, i.e. has its own driver and its own
+     * lock-free sample ring. By default, each port is polled by its own
+     * thread. With many ports, setWorkerCount() allows to share a smaller
+     * number of threads, each polling a fixed subset of the ports in turn.
+     * Either way, a port is only ever accessed by a single thread, so the
+     * ports do not contend on any lock.
+     *
+     * The consumer side, update(), merges the samples of all ports into
+     * snapshots taken every snapshot period. A snapshot holds, for each
+     * sensor (i.e. port, device and channel), the latest sample received at
+     * or before the snapshot time. A snapshot is only produced once all
+     * ports have delivered samples past its time, or once it is older than
+     * the maximum delay, so that a slow port does not hold back the others.
+     *
+     * A port that fails (see Acquisition::hasFailed) is not polled anymore,
+     * and the snapshots stop waiting for it. The other ports are not
+     * affected.
+     *
+     * update() must always be called from the same thread.
+     */
+    class MultiPortAcquisition
+    {
+    public:
+        struct Sensor
+        {
+            int port;
+            int device;
+            int channel;
+        };
+
+        struct Snapshot
+        {
+            base::Time time;
+            /** The latest sample of each sensor, in the order of
+             * getSensors(). Sensors with no sample yet have a null time
+             */
+            std::vector<Sample> samples;
+        };
+
+    private:
+        size_t ringCapacity;
+        std::vector<Acquisition*> ports;
+        std::vector<Sensor> sensors;
+        std::map<std::pair<int, std::pair<int, int> >, int> sensorIndices;
+
+        int workerCount;
+        base::Time period;
+        base::Time snapshotPeriod;
+        base::Time maximumDelay;
+
+        boost::atomic<bool> running;
+        boost::thread_group workers;
+
+        struct PendingSample
+        {
+            Sample sample;
+            int sensor;
+
+            bool operator < (PendingSample const& other) const;
+        };
+
+        /** Samples received but not yet part of a snapshot, ordered by time */
+        std::vector<PendingSample> pending;
+        /** Time of the latest sample received from each port */
+        std::vector<base::Time> portTimes;
+        /** The latest sample of each sensor, as of the last snapshot */
+        std::vector<Sample> current;
+        base::Time nextSnapshot;
+        std::vector<Sample> drained;
+
+        void runWorker(int worker);
+
+    public:
+        /**
+         * @param ringCapacity the capacity of the sample ring of each port
+         */
+        explicit MultiPortAcquisition(size_t ringCapacity = 4096);
+        ~MultiPortAcquisition();
+
+        /** Adds a port and returns its index
+         *
+         * Use getPort(index).getDriver() to open and configure it
+         */
+        int addPort();
+
+        /** Returns the number of ports */
+        int getPortCount() const;
+
+        /** Returns a port's acquisition */
+        Acquisition& getPort(int port);
+
+        /** Adds a device and the channels that should be read on it */
+        void addDevice(int port, int device, Acquisition::Channels const& channels);
+
+        /** Returns all sensors, in the order in which they appear in the
+         * snapshots
+         */
+        std::vector<Sensor> const& getSensors() const;
+
+        /** Sets the number of threads that poll the ports
+         *
+         * The default (zero) is to use one thread per port.
+         */
+        void setWorkerCount(int count);
+
+        /** Sets the period of a polling cycle of each port. The default
+         * (zero) is to poll as fast as possible
+         */
+        void setPeriod(base::Time const& period);
+
+        /** Sets the interval between two snapshots. It is 100ms by default */
+        void setSnapshotPeriod(base::Time const& period);
+
+        /** Sets how long update() waits for a slow port before producing a
+         * snapshot without its samples. It is 1s by default
+         */
+        void setMaximumDelay(base::Time const& delay);
+
+        /** Starts acquiring */
+        void start();
+
+        /** Stops acquiring, and waits for all threads to finish */
+        void stop();
+
+        bool isRunning() const;
+
+        /** Appends the snapshots that are ready at the end of \c snapshots
+         *
+         * @return the number of snapshots added
+         */
+        size_t update(std::vector<Snapshot>& snapshots);
+
+        /** Returns the number of samples that got dropped on all ports
+         * because update() was not called often enough
+         */
+        boost::uint64_t getOverruns() const;
+    };
+}
+
+#endif
+
@@ -1,48 +1,22 @@
 #include <pressure_velki/Packet.hpp>
-#include <boost/crc.hpp>
+#include <pressure_velki/Crc16.hpp>
 #include <pressure_velki/Errors.hpp>
 #include <string.h>
 
 using namespace pressure_velki;
 using namespace std;
 
-// I've tried to use boost's CRC implementation, but could not manage to
-// configure it to match the CRC expected by Velki. This is the CRC calculation
-// from the Velki docs.
-static boost::uint16_t crc(byte const* begin, byte const* end)
-{
-    unsigned int crc = 0xFFFF;
-    
-    for (byte const* it = begin; it != end; ++it)
-    {
-        crc ^= *it;
-        for (int n = 0; n < 8; ++n)
-        {
-            if (crc & 0x1)
-            {
-                crc >>= 1;
-                crc ^= 0xA001;
-            }
-            else
-            {
-                crc >>= 1;
-            }
-        }
-    }
-
-    return crc;
-}
-
-
 Packet::Packet()
-    : address(0)
+    : error(false)
+    , address(0)
     , function(0)
     , payload_size(0)
 {
 }
 
 Packet::Packet(byte address, byte function)
-    : address(address)
+    : error(false)
+    , address(address)
     , function(function)
     , payload_size(0)
 {
@@ -108,14 +82,14 @@ void Packet::marshal(vector<byte>& buffer) const
     buffer.insert(buffer.end(), payload, payload + payload_size);
     byte* crc_begin = &buffer[buffer.size() - 2 - payload_size];
     
-    boost::uint16_t checksum = crc(crc_begin, &buffer[buffer.size()]);
+    boost::uint16_t checksum = Crc16::compute(crc_begin, crc_begin + 2 + payload_size);
     buffer.push_back(checksum >> 8);
     buffer.push_back(checksum & 0xFF);
 }
 
 bool Packet::isChecksumValid(byte const* begin, byte const* end)
 {
-    boost::uint16_t expected_checksum = crc(begin, end - 2);
+    boost::uint16_t expected_checksum = Crc16::compute(begin, end - 2);
     boost::uint16_t actual_checksum =
         static_cast<boost::uint16_t>(*(end - 2)) << 8 |
         static_cast<boost::uint16_t>(*(end - 1));
@@ -129,7 +103,7 @@ bool Packet::unmarshal(byte const* buffer, int size)
 
     address  = buffer[0];
     function = buffer[1] & 0x7F;
-    error    = (buffer[1] >> 15) == 1;
+    error    = (buffer[1] >> 7) == 1;
 
     payload_size = size - 4;
     memcpy(payload, buffer + 2, payload_size);
@@ -143,6 +117,8 @@ float Packet::parseFloat(byte const* buffer)
     raw |= static_cast<uint32_t>(buffer[1]) << 16;
     raw |= static_cast<uint32_t>(buffer[2]) << 8;
     raw |= static_cast<uint32_t>(buffer[3]) << 0;
-    return reinterpret_cast<float&>(raw);
+    float value;
+    memcpy(&value, &raw, sizeof(value));
+    return value;
 }
 
@@ -0,0 +1,66 @@
+#include <pressure_velki/PacketView.hpp>
+
+using namespace pressure_velki;
+
+PacketView::PacketView()
+    : buffer(0)
+    , size(0)
+{
+}
+
+PacketView::PacketView(byte const* buffer, int size)
+    : buffer(buffer)
+    , size(size)
+{
+}
+
+bool PacketView::isEmpty() const
+{
+    return size == 0;
+}
+
+byte PacketView::getAddress() const
+{
+    return buffer[0];
+}
+
+byte PacketView::getFunction() const
+{
+    return buffer[1] & 0x7F;
+}
+
+bool PacketView::hasError() const
+{
+    return (buffer[1] & 0x80) != 0;
+}
+
+Error::ERROR_CODE PacketView::getErrorCode() const
+{
+    return static_cast<Error::ERROR_CODE>(buffer[2]);
+}
+
+int PacketView::getPayloadSize() const
+{
+    return size - 4;
+}
+
+byte const& PacketView::operator [](int i) const
+{
+    return buffer[2 + i];
+}
+
+byte const* PacketView::getPayload() const
+{
+    return buffer + 2;
+}
+
+byte const* PacketView::getFrame() const
+{
+    return buffer;
+}
+
+int PacketView::getFrameSize() const
+{
+    return size;
+}
+
@@ -0,0 +1,68 @@
+#ifndef PRESSURE_VELKI_PACKET_VIEW_HPP
+#define PRESSURE_VELKI_PACKET_VIEW_HPP
+
+#include <pressure_velki/Packet.hpp>
+#include <pressure_velki/Errors.hpp>
+
+namespace pressure_velki
+{
+    /** Non-owning view on a received packet
+     *
+     * Unlike Packet, it does not copy the data out of the receive buffer. It
+     * is therefore only valid as long as the buffer it points to is left
+     * untouched.
+     *
+     * It does not validate the checksum. It must be built from a frame that
+     * has already been validated, as the ones returned by
+     * DriverClass5_20::extractPacket.
+     */
+    class PacketView
+    {
+        byte const* buffer;
+        int size;
+
+    public:
+        /** Creates an empty view */
+        PacketView();
+
+        /** Creates a view on a complete frame
+         *
+         * @param buffer the frame, starting with the address byte
+         * @param size the frame size, including the checksum
+         */
+        PacketView(byte const* buffer, int size);
+
+        /** Returns true if this view does not point to any frame */
+        bool isEmpty() const;
+
+        /** Return the device address */
+        byte getAddress() const;
+
+        /** Return the function, without the error flag */
+        byte getFunction() const;
+
+        /** Returns true if the error flag is set */
+        bool hasError() const;
+
+        /** If this packet is an error response, returns the error code */
+        Error::ERROR_CODE getErrorCode() const;
+
+        /** Return the number of bytes in payload */
+        int getPayloadSize() const;
+
+        /** Get the n-th payload byte */
+        byte const& operator [](int i) const;
+
+        /** Get the payload data */
+        byte const* getPayload() const;
+
+        /** Returns the whole frame, including address, function and checksum */
+        byte const* getFrame() const;
+
+        /** Returns the size of the whole frame */
+        int getFrameSize() const;
+    };
+}
+
+#endif
+
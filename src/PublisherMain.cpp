@@ -0,0 +1,112 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <pressure_velki/Acquisition.hpp>
+#include <pressure_velki/SharedSamples.hpp>
+#include "ChannelNames.hpp"
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace pressure_velki;
+using namespace std;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleInterrupt(int)
+{
+    interrupted = 1;
+}
+
+static void usage(char const* name)
+{
+    cerr << "usage: " << name << " [-d ADDRESS]... [-c CHANNELS] [-r RATE] [-s NAME] [-C CAPACITY] URI\n"
+        << "polls Velki class 5.20 devices and publishes the samples in shared memory,\n"
+        << "where any number of local processes can read them with SharedSampleReader\n"
+        << "\n"
+        << "  -d ADDRESS    read this device. Repeat for several devices. Defaults\n"
+        << "                to the point-to-point address\n"
+        << "  -c CHANNELS   comma-separated list of channels among calc, p0, p1, t,\n"
+        << "                t0 and t1. Defaults to p0,t0,p1,t1\n"
+        << "  -r RATE       target number of polling cycles per second. Defaults to\n"
+        << "                0, which polls as fast as the bus allows\n"
+        << "  -s NAME       name of the shared memory. Defaults to /pressure_velki\n"
+        << "  -C CAPACITY   number of samples kept in shared memory. Defaults to "
+        << SharedSamples::DEFAULT_CAPACITY << endl;
+}
+
+int main(int argc, char** argv)
+{
+    vector<int> devices;
+    Acquisition::Channels channels;
+    channels.push_back(DriverClass5_20::CHANNEL_PRESSURE0);
+    channels.push_back(DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE0);
+    channels.push_back(DriverClass5_20::CHANNEL_PRESSURE1);
+    channels.push_back(DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE1);
+    double rate = 0;
+    string name = "/pressure_velki";
+    size_t capacity = SharedSamples::DEFAULT_CAPACITY;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:c:r:s:C:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'd': devices.push_back(atoi(optarg)); break;
+            case 'c':
+                if (!parseChannels(optarg, channels))
+                {
+                    cerr << "invalid channel list " << optarg << endl;
+                    return 1;
+                }
+                break;
+            case 'r': rate = atof(optarg); break;
+            case 's': name = optarg; break;
+            case 'C': capacity = atol(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (devices.empty())
+        devices.push_back(static_cast<int>(Packet::ADDRESS_POINT_TO_POINT));
+
+    SharedSampleWriter writer;
+    writer.create(name, capacity);
+
+    // Nobody consumes the acquisition's own ring, the samples only go to
+    // shared memory
+    Acquisition acquisition(1);
+    DriverClass5_20& driver = acquisition.getDriver();
+    driver.openURI(argv[optind]);
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        driver.initialize(devices[i]);
+        acquisition.addDevice(devices[i], channels);
+    }
+    if (rate > 0)
+        acquisition.setPeriod(base::Time::fromSeconds(1.0 / rate));
+    acquisition.setSharedWriter(&writer);
+
+    signal(SIGINT, handleInterrupt);
+    signal(SIGTERM, handleInterrupt);
+    acquisition.start();
+    cerr << "publishing in " << name << endl;
+
+    while (!interrupted && acquisition.isRunning())
+        usleep(100000);
+
+    acquisition.stop();
+    driver.getStatistics().dump(cerr);
+    if (acquisition.hasFailed())
+    {
+        cerr << "acquisition failed: " << acquisition.getFailure() << endl;
+        return 1;
+    }
+    return 0;
+}
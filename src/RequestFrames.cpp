@@ -0,0 +1,96 @@
+#include <pressure_velki/RequestFrames.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+#include <pressure_velki/Crc16.hpp>
+#include <stdexcept>
+#include <string.h>
+
+using namespace pressure_velki;
+
+const byte RequestFrames::ECHO_PAYLOAD[4] = { 0, 0, 0xE, 0x8 };
+
+namespace
+{
+    enum FRAME_INDEX
+    {
+        FRAME_INITIALIZE,
+        FRAME_SERIAL_NUMBER,
+        FRAME_ECHO,
+        FRAME_IS_ABSOLUTE,
+        FRAME_READ_CHANNEL,
+        FRAME_COUNT = FRAME_READ_CHANNEL + RequestFrames::CHANNEL_COUNT
+    };
+
+    typedef RequestFrames::Frame Frame;
+
+    void build(Frame& frame, int address, int function, byte const* payload, int payload_size)
+    {
+        frame.data[0] = address;
+        frame.data[1] = function;
+        memcpy(frame.data + 2, payload, payload_size);
+        boost::uint16_t crc = Crc16::compute(frame.data, frame.data + 2 + payload_size);
+        frame.data[2 + payload_size] = crc >> 8;
+        frame.data[3 + payload_size] = crc & 0xFF;
+        frame.size = 4 + payload_size;
+    }
+
+    /** The frames of all addresses: 256 times FRAME_COUNT (10) frames of 12
+     * bytes, i.e. 30kB
+     */
+    struct Frames
+    {
+        Frame frames[256][FRAME_COUNT];
+
+        Frames()
+        {
+            byte const is_absolute[1] = { 14 };
+            for (int address = 0; address < 256; ++address)
+            {
+                Frame* f = frames[address];
+                build(f[FRAME_INITIALIZE], address, DriverClass5_20::FUNCTION_INITIALIZE, 0, 0);
+                build(f[FRAME_SERIAL_NUMBER], address, DriverClass5_20::FUNCTION_SERIAL_NUMBER, 0, 0);
+                build(f[FRAME_ECHO], address, DriverClass5_20::FUNCTION_ECHO, RequestFrames::ECHO_PAYLOAD, 4);
+                build(f[FRAME_IS_ABSOLUTE], address, DriverClass5_20::FUNCTION_CONFIGURATION_READ, is_absolute, 1);
+                for (int channel = 0; channel < RequestFrames::CHANNEL_COUNT; ++channel)
+                {
+                    byte payload[1] = { static_cast<byte>(channel) };
+                    build(f[FRAME_READ_CHANNEL + channel], address, DriverClass5_20::FUNCTION_READ_CHANNEL, payload, 1);
+                }
+            }
+        }
+    };
+
+    Frame const& get(int address, int index)
+    {
+        static Frames const frames;
+        if (address < 0 || address > 255)
+            throw std::invalid_argument("invalid device address");
+        return frames.frames[address][index];
+    }
+}
+
+Frame const& RequestFrames::initialize(int address)
+{
+    return get(address, FRAME_INITIALIZE);
+}
+
+Frame const& RequestFrames::serialNumber(int address)
+{
+    return get(address, FRAME_SERIAL_NUMBER);
+}
+
+Frame const& RequestFrames::echo(int address)
+{
+    return get(address, FRAME_ECHO);
+}
+
+Frame const& RequestFrames::isAbsolute(int address)
+{
+    return get(address, FRAME_IS_ABSOLUTE);
+}
+
+Frame const& RequestFrames::readChannel(int channel, int address)
+{
+    if (channel < 0 || channel >= CHANNEL_COUNT)
+        throw std::invalid_argument("invalid channel");
+    return get(address, FRAME_READ_CHANNEL + channel);
+}
@@ -0,0 +1,43 @@
+#ifndef PRESSURE_VELKI_REQUEST_FRAMES_HPP
+#define PRESSURE_VELKI_REQUEST_FRAMES_HPP
+
+#include <pressure_velki/Packet.hpp>
+
+namespace pressure_velki
+{
+    /** Ready-to-send frames for all the requests the driver uses
+     *
+     * The driver only ever sends a handful of requests, whose content only
+     * depends on the device address. Their frames, CRC included, are built
+     * once for all addresses on first use, so that sending a request is a
+     * single write of a constant buffer.
+     */
+    class RequestFrames
+    {
+    public:
+        /** Size of the largest frame (the echo request) */
+        static const int MAXIMUM_FRAME_SIZE = 8;
+
+        /** Number of channels that can be read with readChannel */
+        static const int CHANNEL_COUNT = 6;
+
+        /** The payload of the echo request, which the device sends back */
+        static const byte ECHO_PAYLOAD[4];
+
+        struct Frame
+        {
+            byte data[MAXIMUM_FRAME_SIZE];
+            int size;
+        };
+
+        static Frame const& initialize(int address);
+        static Frame const& serialNumber(int address);
+        static Frame const& echo(int address);
+        /** Configuration read of the absolute / relative flag */
+        static Frame const& isAbsolute(int address);
+        static Frame const& readChannel(int channel, int address);
+    };
+}
+
+#endif
+
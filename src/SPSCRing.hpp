@@ -0,0 +1,109 @@
+#ifndef PRESSURE_VELKI_SPSC_RING_HPP
+#define PRESSURE_VELKI_SPSC_RING_HPP
+
+#include <vector>
+#include <stdexcept>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+namespace pressure_velki
+{
+    /** Lock-free single-producer / single-consumer ring buffer
+     *
+     * push() must only be called from one thread (the producer), and pop()
+     * and peek() from one other thread (the consumer). All operations are
+     * wait-free.
+     *
+     * When the ring is full, push() drops the new element and counts an
+     * overrun. The producer never blocks on a slow consumer.
+     */
+    template<typename T>
+    class SPSCRing
+    {
+        std::vector<T> slots;
+        /** Index of the next slot to be written. Only written by the producer */
+        boost::atomic<size_t> head;
+        /** Index of the next slot to be read. Only written by the consumer */
+        boost::atomic<size_t> tail;
+        boost::atomic<boost::uint64_t> overruns;
+
+    public:
+        explicit SPSCRing(size_t capacity)
+            : slots(capacity)
+            , head(0)
+            , tail(0)
+            , overruns(0)
+        {
+            if (capacity == 0)
+                throw std::invalid_argument("SPSCRing: capacity must be strictly positive");
+        }
+
+        size_t capacity() const { return slots.size(); }
+
+        /** Appends an element. Producer side
+         *
+         * @return false if the ring was full and the element got dropped
+         */
+        bool push(T const& value)
+        {
+            size_t h = head.load(boost::memory_order_relaxed);
+            size_t t = tail.load(boost::memory_order_acquire);
+            if (h - t == slots.size())
+            {
+                overruns.fetch_add(1, boost::memory_order_relaxed);
+                return false;
+            }
+            slots[h % slots.size()] = value;
+            head.store(h + 1, boost::memory_order_release);
+            return true;
+        }
+
+        /** Removes the oldest element. Consumer side
+         *
+         * @return false if the ring was empty
+         */
+        bool pop(T& value)
+        {
+            size_t t = tail.load(boost::memory_order_relaxed);
+            size_t h = head.load(boost::memory_order_acquire);
+            if (t == h)
+                return false;
+            value = slots[t % slots.size()];
+            tail.store(t + 1, boost::memory_order_release);
+            return true;
+        }
+
+        /** Reads an element without removing it. Consumer side
+         *
+         * @param age zero for the newest element, one for the one before, ...
+         * @return false if there are not that many elements in the ring
+         */
+        bool peek(size_t age, T& value) const
+        {
+            size_t t = tail.load(boost::memory_order_relaxed);
+            size_t h = head.load(boost::memory_order_acquire);
+            if (age >= h - t)
+                return false;
+            value = slots[(h - 1 - age) % slots.size()];
+            return true;
+        }
+
+        /** Returns the number of elements in the ring */
+        size_t size() const
+        {
+            return head.load(boost::memory_order_acquire) -
+                tail.load(boost::memory_order_acquire);
+        }
+
+        /** Returns the number of elements dropped by push() because the ring
+         * was full
+         */
+        boost::uint64_t getOverruns() const
+        {
+            return overruns.load(boost::memory_order_relaxed);
+        }
+    };
+}
+
+#endif
+
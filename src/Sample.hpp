@@ -0,0 +1,65 @@
+#ifndef PRESSURE_VELKI_SAMPLE_HPP
+#define PRESSURE_VELKI_SAMPLE_HPP
+
+#include <base/Time.hpp>
+#include <base/Pressure.hpp>
+#include <base/Float.hpp>
+
+namespace pressure_velki
+{
+    /** A single channel reading */
+    struct Sample
+    {
+        enum STATUS
+        {
+            STATUS_OK,
+            /** The analog input is saturated */
+            STATUS_SATURATED,
+            /** The device reported a measure or computation error */
+            STATUS_CHANNEL_ERROR,
+            /** The device is still powering up */
+            STATUS_POWERING_UP,
+            /** The device did not reply */
+            STATUS_TIMEOUT,
+            /** The device replied with an exception */
+            STATUS_DEVICE_ERROR
+        };
+
+        /** The estimated time at which the device acquired the value, or
+         * the time at which the read failed
+         */
+        base::Time time;
+        /** The maximum error on \c time */
+        base::Time timeUncertainty;
+        /** The device address */
+        int device;
+        /** The channel, as a DriverClass5_20::CHANNEL_ID */
+        int channel;
+        /** The value, in bar for pressures and celsius for temperatures. It
+         * is NaN unless status is STATUS_OK
+         */
+        float value;
+        STATUS status;
+        /** The error code sent by the device if status is
+         * STATUS_DEVICE_ERROR, as an Error::ERROR_CODE
+         */
+        int error;
+
+        Sample()
+            : device(0)
+            , channel(0)
+            , value(base::unknown<float>())
+            , status(STATUS_OK)
+            , error(0) {}
+
+        bool isValid() const { return status == STATUS_OK; }
+
+        /** Returns the value as a pressure. Only meaningful for pressure
+         * channels
+         */
+        base::Pressure getPressure() const { return base::Pressure::fromBar(value); }
+    };
+}
+
+#endif
+
@@ -0,0 +1,362 @@
+#include <pressure_velki/SharedSamples.hpp>
+#include <iodrivers_base/Driver.hpp>
+#include <stdexcept>
+#include <new>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/atomic.hpp>
+#include <boost/static_assert.hpp>
+
+using namespace pressure_velki;
+using namespace std;
+using boost::int32_t;
+using boost::int64_t;
+using boost::uint8_t;
+using boost::uint32_t;
+using boost::uint64_t;
+
+namespace
+{
+    const char MAGIC[8] = { 'V', 'E', 'L', 'K', 'I', 'S', 'H', 'M' };
+    const int LATEST_COUNT = SharedSamples::DEVICE_COUNT * SharedSamples::CHANNEL_COUNT;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t capacity;
+        /** Number of samples published so far */
+        boost::atomic<uint64_t> published;
+        /** Time of the last publication, in microseconds */
+        boost::atomic<int64_t> lastUpdate;
+        uint8_t reserved[32];
+    };
+
+    /** A sample. Slots are one cache line, so that the writer never shares
+     * a cache line it is updating with a slot a reader is reading
+     */
+    struct Slot
+    {
+        /** The seqlock counter. It is odd while the slot is written */
+        boost::atomic<uint32_t> sequence;
+        int32_t device;
+        /** Index of the sample in the published samples */
+        uint64_t index;
+        int64_t time;
+        int64_t timeUncertainty;
+        int32_t channel;
+        float value;
+        int32_t status;
+        int32_t error;
+        uint8_t reserved[16];
+    };
+
+    BOOST_STATIC_ASSERT(sizeof(Header) == 64);
+    BOOST_STATIC_ASSERT(sizeof(Slot) == 64);
+
+    size_t mappingSizeFor(uint32_t capacity)
+    {
+        return sizeof(Header) + (LATEST_COUNT + capacity) * sizeof(Slot);
+    }
+
+    Header* headerOf(uint8_t* mapping)
+    {
+        return reinterpret_cast<Header*>(mapping);
+    }
+
+    Slot* latestSlots(uint8_t* mapping)
+    {
+        return reinterpret_cast<Slot*>(mapping + sizeof(Header));
+    }
+
+    Slot* ringSlots(uint8_t* mapping)
+    {
+        return latestSlots(mapping) + LATEST_COUNT;
+    }
+
+    void writeSlot(Slot& slot, Sample const& sample, uint64_t index)
+    {
+        uint32_t sequence = slot.sequence.load(boost::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_release);
+
+        slot.device = sample.device;
+        slot.index = index;
+        slot.time = sample.time.toMicroseconds();
+        slot.timeUncertainty = sample.timeUncertainty.toMicroseconds();
+        slot.channel = sample.channel;
+        slot.value = sample.value;
+        slot.status = sample.status;
+        slot.error = sample.error;
+
+        slot.sequence.store(sequence + 2, boost::memory_order_release);
+    }
+
+    /** Copies a slot
+     *
+     * @return false if the slot is empty, or if the writer updated it during
+     *   the copy
+     */
+    bool readSlot(Slot const& slot, Sample& sample, uint64_t& index)
+    {
+        uint32_t sequence = slot.sequence.load(boost::memory_order_acquire);
+        if (sequence == 0 || (sequence & 1))
+            return false;
+
+        sample.device = slot.device;
+        index = slot.index;
+        sample.time = base::Time::fromMicroseconds(slot.time);
+        sample.timeUncertainty = base::Time::fromMicroseconds(slot.timeUncertainty);
+        sample.channel = slot.channel;
+        sample.value = slot.value;
+        sample.status = static_cast<Sample::STATUS>(slot.status);
+        sample.error = slot.error;
+
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        return slot.sequence.load(boost::memory_order_relaxed) == sequence;
+    }
+}
+
+SharedSampleWriter::SharedSampleWriter()
+    : mapping(0)
+    , mappingSize(0)
+{
+}
+
+SharedSampleWriter::~SharedSampleWriter()
+{
+    close();
+}
+
+void SharedSampleWriter::create(string const& name, size_t capacity)
+{
+    close();
+    if (capacity == 0 || capacity > (1U << 24))
+        throw std::invalid_argument("SharedSampleWriter: capacity must be between 1 and 2^24");
+    uint32_t rounded = 1;
+    while (rounded < capacity)
+        rounded <<= 1;
+
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1)
+        throw iodrivers_base::UnixError("cannot create shared memory " + name);
+
+    size_t size = mappingSizeFor(rounded);
+    if (ftruncate(fd, size) == -1)
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        throw iodrivers_base::UnixError("cannot resize shared memory " + name);
+    }
+    void* result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (result == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        throw iodrivers_base::UnixError("cannot map shared memory " + name);
+    }
+
+    this->name = name;
+    mapping = static_cast<uint8_t*>(result);
+    mappingSize = size;
+
+    // The memory is zero-filled, which is an empty ring and latest table
+    Header* header = headerOf(mapping);
+    new (&header->published) boost::atomic<uint64_t>(0);
+    new (&header->lastUpdate) boost::atomic<int64_t>(0);
+    if (!header->published.is_lock_free())
+    {
+        close();
+        throw std::runtime_error("SharedSampleWriter: 64-bit atomics are not lock-free on this platform");
+    }
+    Slot* slots = latestSlots(mapping);
+    for (uint32_t i = 0; i < LATEST_COUNT + rounded; ++i)
+        new (&slots[i].sequence) boost::atomic<uint32_t>(0);
+    header->version = SharedSamples::VERSION;
+    header->capacity = rounded;
+    // Readers check the magic, write it last
+    boost::atomic_thread_fence(boost::memory_order_release);
+    memcpy(header->magic, MAGIC, 8);
+}
+
+void SharedSampleWriter::close()
+{
+    if (!mapping)
+        return;
+    munmap(mapping, mappingSize);
+    shm_unlink(name.c_str());
+    mapping = 0;
+    mappingSize = 0;
+    name.clear();
+}
+
+bool SharedSampleWriter::isOpen() const
+{
+    return mapping != 0;
+}
+
+void SharedSampleWriter::publish(Sample const& sample)
+{
+    if (!mapping)
+        throw std::logic_error("SharedSampleWriter::publish() called on a closed writer");
+
+    Header* header = headerOf(mapping);
+    uint64_t index = header->published.load(boost::memory_order_relaxed);
+    writeSlot(ringSlots(mapping)[index & (header->capacity - 1)], sample, index);
+    if (sample.device >= 0 && sample.device < SharedSamples::DEVICE_COUNT &&
+            sample.channel >= 0 && sample.channel < SharedSamples::CHANNEL_COUNT)
+    {
+        writeSlot(latestSlots(mapping)[sample.device * SharedSamples::CHANNEL_COUNT + sample.channel],
+                sample, index);
+    }
+    header->published.store(index + 1, boost::memory_order_release);
+    header->lastUpdate.store(base::Time::now().toMicroseconds(), boost::memory_order_relaxed);
+}
+
+SharedSampleReader::SharedSampleReader()
+    : mapping(0)
+    , mappingSize(0)
+{
+}
+
+SharedSampleReader::~SharedSampleReader()
+{
+    close();
+}
+
+void SharedSampleReader::open(string const& name)
+{
+    close();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        throw iodrivers_base::UnixError("cannot open shared memory " + name);
+
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+        ::close(fd);
+        throw iodrivers_base::UnixError("cannot stat shared memory " + name);
+    }
+    size_t size = info.st_size;
+    if (size < sizeof(Header))
+    {
+        ::close(fd);
+        throw std::runtime_error(name + " is not a shared sample ring");
+    }
+
+    void* result = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (result == MAP_FAILED)
+        throw iodrivers_base::UnixError("cannot map shared memory " + name);
+    mapping = static_cast<uint8_t*>(result);
+    mappingSize = size;
+
+    Header const* header = headerOf(mapping);
+    string error;
+    if (memcmp(header->magic, MAGIC, 8) != 0)
+        error = name + " is not a shared sample ring";
+    else if (header->version != static_cast<uint32_t>(SharedSamples::VERSION))
+        error = name + " has an unsupported version";
+    else if (size < mappingSizeFor(header->capacity))
+        error = name + " is truncated";
+    if (!error.empty())
+    {
+        close();
+        throw std::runtime_error(error);
+    }
+}
+
+void SharedSampleReader::close()
+{
+    if (!mapping)
+        return;
+    munmap(mapping, mappingSize);
+    mapping = 0;
+    mappingSize = 0;
+}
+
+bool SharedSampleReader::isOpen() const
+{
+    return mapping != 0;
+}
+
+size_t SharedSampleReader::getCapacity() const
+{
+    return headerOf(mapping)->capacity;
+}
+
+uint64_t SharedSampleReader::getPublishedCount() const
+{
+    return headerOf(mapping)->published.load(boost::memory_order_acquire);
+}
+
+base::Time SharedSampleReader::getLastUpdate() const
+{
+    return base::Time::fromMicroseconds(headerOf(mapping)->lastUpdate.load(boost::memory_order_relaxed));
+}
+
+SharedSamples::READ_STATUS SharedSampleReader::read(uint64_t index, Sample& sample) const
+{
+    Header const* header = headerOf(mapping);
+    uint64_t published = header->published.load(boost::memory_order_acquire);
+    if (index >= published)
+        return SharedSamples::READ_NOT_YET;
+    if (published - index > header->capacity)
+        return SharedSamples::READ_OVERWRITTEN;
+
+    // The slot can only change under our feet if the writer is overwriting
+    // it with a newer sample
+    uint64_t slotIndex;
+    if (!readSlot(ringSlots(mapping)[index & (header->capacity - 1)], sample, slotIndex) ||
+            slotIndex != index)
+        return SharedSamples::READ_OVERWRITTEN;
+    return SharedSamples::READ_OK;
+}
+
+uint64_t SharedSampleReader::readSince(uint64_t& next, vector<Sample>& samples) const
+{
+    uint64_t published = getPublishedCount();
+    if (next >= published)
+        return 0;
+
+    uint64_t capacity = getCapacity();
+    uint64_t lost = 0;
+    if (published - next > capacity)
+    {
+        lost = published - capacity - next;
+        next = published - capacity;
+    }
+
+    Sample sample;
+    for (; next < published; ++next)
+    {
+        if (read(next, sample) == SharedSamples::READ_OK)
+            samples.push_back(sample);
+        else
+            ++lost;
+    }
+    return lost;
+}
+
+bool SharedSampleReader::latest(int device, int channel, Sample& sample) const
+{
+    if (device < 0 || device >= SharedSamples::DEVICE_COUNT ||
+            channel < 0 || channel >= SharedSamples::CHANNEL_COUNT)
+        return false;
+
+    Slot const& slot = latestSlots(mapping)[device * SharedSamples::CHANNEL_COUNT + channel];
+    for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt)
+    {
+        // An empty slot stays empty until the writer publishes in it
+        if (slot.sequence.load(boost::memory_order_relaxed) == 0)
+            return false;
+        uint64_t index;
+        if (readSlot(slot, sample, index))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,144 @@
+#ifndef PRESSURE_VELKI_SHARED_SAMPLES_HPP
+#define PRESSURE_VELKI_SHARED_SAMPLES_HPP
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <pressure_velki/Sample.hpp>
+
+namespace pressure_velki
+{
+    /** Samples shared between processes through POSIX shared memory
+     *
+     * One process, the writer, publishes samples. Any number of local
+     * processes can read them, without system calls and without ever
+     * blocking the writer.
+     *
+     * The shared memory holds a ring of the last published samples, and a
+     * table of the latest sample of each device and channel. Each slot is
+     * protected by a seqlock: the writer makes its counter odd while it
+     * writes the slot, and readers retry or give up when they see an odd
+     * or changed counter. The layout is in the host's byte order, and
+     * only meant to be shared on one machine.
+     */
+    namespace SharedSamples
+    {
+        static const int VERSION = 1;
+        /** Size of the latest-sample table. Devices are 0 to 255 */
+        static const int DEVICE_COUNT = 256;
+        static const int CHANNEL_COUNT = 6;
+        static const int DEFAULT_CAPACITY = 65536;
+
+        /** Outcome of a read of the sample ring */
+        enum READ_STATUS
+        {
+            READ_OK,
+            /** The sample has not been published yet */
+            READ_NOT_YET,
+            /** The sample has already been overwritten */
+            READ_OVERWRITTEN
+        };
+    }
+
+    /** Publishes samples in shared memory. See SharedSamples */
+    class SharedSampleWriter : boost::noncopyable
+    {
+        std::string name;
+        boost::uint8_t* mapping;
+        size_t mappingSize;
+
+    public:
+        SharedSampleWriter();
+        ~SharedSampleWriter();
+
+        /** Creates the shared memory
+         *
+         * An existing shared memory with the same name is removed first.
+         * Readers that still have it open keep on seeing the old one, which
+         * does not get updated anymore
+         *
+         * @param name the name of the shared memory, e.g. "/pressure_velki".
+         *   It must start with a slash
+         * @param capacity the number of samples in the ring. It is rounded
+         *   up to a power of two
+         */
+        void create(std::string const& name, size_t capacity = SharedSamples::DEFAULT_CAPACITY);
+
+        /** Unmaps and removes the shared memory */
+        void close();
+
+        bool isOpen() const;
+
+        /** Publishes a sample. It is wait-free */
+        void publish(Sample const& sample);
+    };
+
+    /** Wait-free access to the samples published by a SharedSampleWriter
+     *
+     * A reader must only be used by one thread. Open one reader per thread
+     * if needed.
+     */
+    class SharedSampleReader : boost::noncopyable
+    {
+        boost::uint8_t* mapping;
+        size_t mappingSize;
+
+    public:
+        /** The number of times latest() tries to read a slot that the writer
+         * is updating, before giving up
+         */
+        static const int MAX_ATTEMPTS = 16;
+
+        SharedSampleReader();
+        ~SharedSampleReader();
+
+        /** Opens an existing shared memory
+         *
+         * @throw std::runtime_error if it has not been created by a
+         *   SharedSampleWriter
+         */
+        void open(std::string const& name);
+
+        void close();
+
+        bool isOpen() const;
+
+        /** Returns the number of samples in the ring */
+        size_t getCapacity() const;
+
+        /** Returns the number of samples published so far. It is the index
+         * of the next sample
+         */
+        boost::uint64_t getPublishedCount() const;
+
+        /** Returns the time at which the writer published its last sample,
+         * which tells whether it is still alive
+         */
+        base::Time getLastUpdate() const;
+
+        /** Reads the sample with the given index, 0 being the first sample
+         * ever published
+         */
+        SharedSamples::READ_STATUS read(boost::uint64_t index, Sample& sample) const;
+
+        /** Appends the samples published since \c next at the end of \c
+         * samples, and updates \c next
+         *
+         * Start with getPublishedCount() to only get new samples.
+         *
+         * @return the number of samples that got overwritten before they
+         *   could be read
+         */
+        boost::uint64_t readSince(boost::uint64_t& next, std::vector<Sample>& samples) const;
+
+        /** Reads the latest sample of a channel
+         *
+         * @return false if no sample has been published for this channel,
+         *   or if the writer kept updating it during MAX_ATTEMPTS attempts
+         */
+        bool latest(int device, int channel, Sample& sample) const;
+    };
+}
+
+#endif
@@ -0,0 +1,476 @@
+#include <pressure_velki/Simulator.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+#include <pressure_velki/Crc16.hpp>
+#include <pressure_velki/Errors.hpp>
+#include <iodrivers_base/Driver.hpp>
+#include <boost/lexical_cast.hpp>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/select.h>
+
+using namespace pressure_velki;
+using namespace std;
+
+typedef DriverClass5_20 D;
+
+/** Returns the payload size of requests for the given function, or -1 if
+ * the function is unknown
+ */
+static int getRequestPayloadSize(int function)
+{
+    switch(function)
+    {
+        case D::FUNCTION_ECHO: return 4;
+        case D::FUNCTION_INITIALIZE: return 0;
+        case D::FUNCTION_SERIAL_NUMBER: return 0;
+        case D::FUNCTION_CONFIGURATION_READ: return 1;
+        case D::FUNCTION_READ_CHANNEL: return 1;
+        default: return -1;
+    }
+}
+
+static void appendFloat(vector<byte>& buffer, float value)
+{
+    boost::uint32_t raw;
+    memcpy(&raw, &value, 4);
+    buffer.push_back(raw >> 24);
+    buffer.push_back(raw >> 16);
+    buffer.push_back(raw >> 8);
+    buffer.push_back(raw);
+}
+
+Simulator::Simulator()
+    : master_fd(-1)
+    , slave_fd(-1)
+    , pointToPointAddress(-1)
+    , noiseProbability(0)
+    , maxNoiseSize(0)
+    , randomSeed(0)
+    , requestCount(0)
+    , running(false)
+{
+}
+
+Simulator::~Simulator()
+{
+    stop();
+    close();
+}
+
+void Simulator::open()
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd == -1)
+        throw iodrivers_base::UnixError("cannot open a pseudo-terminal");
+    if (grantpt(fd) == -1 || unlockpt(fd) == -1)
+    {
+        ::close(fd);
+        throw iodrivers_base::UnixError("cannot unlock the pseudo-terminal");
+    }
+
+    master_fd = fd;
+    slave_path = ptsname(fd);
+
+    // Keep the slave side open so that the master does not get EIO while no
+    // driver is connected, and make sure the line is raw
+    slave_fd = ::open(slave_path.c_str(), O_RDWR | O_NOCTTY);
+    if (slave_fd == -1)
+    {
+        close();
+        throw iodrivers_base::UnixError("cannot open " + slave_path);
+    }
+    struct termios tio;
+    tcgetattr(slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave_fd, TCSANOW, &tio);
+
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+}
+
+void Simulator::close()
+{
+    if (slave_fd != -1)
+        ::close(slave_fd);
+    if (master_fd != -1)
+        ::close(master_fd);
+    slave_fd = -1;
+    master_fd = -1;
+}
+
+string Simulator::getSlavePath() const
+{
+    return slave_path;
+}
+
+string Simulator::getURI(int baudrate) const
+{
+    return "serial://" + slave_path + ":" + boost::lexical_cast<string>(baudrate);
+}
+
+void Simulator::addDevice(int address, int serialNumber)
+{
+    if (address <= Packet::ADDRESS_BROADCAST || address >= Packet::ADDRESS_POINT_TO_POINT)
+        throw std::invalid_argument("invalid device address");
+
+    Device device;
+    device.address = address;
+    device.serialNumber = serialNumber;
+    device.info.deviceClass = 5;
+    device.info.deviceGroup = 20;
+    device.info.firmwareYear = 10;
+    device.info.firmwareWeek = 20;
+    device.info.internalBufferSize = 64;
+    device.absolute = true;
+    device.initialized = false;
+    device.poweringUpReads = 0;
+    device.saturation = 0;
+    device.channelErrors = 0;
+    device.injectedError = 0;
+    for (int i = 0; i < 6; ++i)
+        device.values[i] = 0;
+
+    boost::mutex::scoped_lock lock(mutex);
+    devices[address] = device;
+    if (pointToPointAddress == -1)
+        pointToPointAddress = address;
+}
+
+Simulator::Device& Simulator::getDevice(int address)
+{
+    map<int, Device>::iterator it = devices.find(address);
+    if (it == devices.end())
+        throw std::invalid_argument("no simulated device at this address");
+    return it->second;
+}
+
+Simulator::Device Simulator::getDeviceState(int address) const
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return const_cast<Simulator*>(this)->getDevice(address);
+}
+
+void Simulator::setChannelValue(int address, int channel, float value)
+{
+    if (channel < 0 || channel >= 6)
+        throw std::invalid_argument("invalid channel");
+    boost::mutex::scoped_lock lock(mutex);
+    getDevice(address).values[channel] = value;
+}
+
+void Simulator::setAbsolute(int address, bool absolute)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    getDevice(address).absolute = absolute;
+}
+
+void Simulator::setInitialized(int address, bool initialized)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    getDevice(address).initialized = initialized;
+}
+
+void Simulator::setPoweringUpReads(int address, int count)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    getDevice(address).poweringUpReads = count;
+}
+
+void Simulator::setSaturation(int address, int bits)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    getDevice(address).saturation = bits & 0x7;
+}
+
+void Simulator::setChannelErrors(int address, int bits)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    getDevice(address).channelErrors = bits;
+}
+
+void Simulator::injectError(int address, int errorCode)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    getDevice(address).injectedError = errorCode;
+}
+
+void Simulator::setLatency(base::Time const& latency)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    this->latency = latency;
+}
+
+void Simulator::setNoise(double probability, int maxSize)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    noiseProbability = probability;
+    maxNoiseSize = maxSize;
+}
+
+int Simulator::getRequestCount() const
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return requestCount;
+}
+
+bool Simulator::process(base::Time const& timeout)
+{
+    if (master_fd == -1)
+        throw std::logic_error("Simulator::process() called before open()");
+
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(master_fd, &set);
+    timeval tv;
+    tv.tv_sec = timeout.toMicroseconds() / 1000000;
+    tv.tv_usec = timeout.toMicroseconds() % 1000000;
+    int ret = select(master_fd + 1, &set, 0, 0, &tv);
+    if (ret < 0 && errno != EINTR)
+        throw iodrivers_base::UnixError("Simulator::process(): select failed");
+    if (ret <= 0)
+        return false;
+
+    byte buffer[256];
+    while (true)
+    {
+        ssize_t count = ::read(master_fd, buffer, sizeof(buffer));
+        if (count > 0)
+            inputBuffer.insert(inputBuffer.end(), buffer, buffer + count);
+        else
+            break;
+    }
+
+    bool processed = false;
+    while (processRequest())
+        processed = true;
+    return processed;
+}
+
+bool Simulator::processRequest()
+{
+    if (inputBuffer.size() < 4)
+        return false;
+
+    int packet_size = -1;
+    int payload_size = getRequestPayloadSize(inputBuffer[1]);
+    if (payload_size >= 0)
+    {
+        if (inputBuffer.size() < static_cast<size_t>(payload_size + 4))
+            return false;
+        if (Packet::isChecksumValid(&inputBuffer[0], &inputBuffer[0] + payload_size + 4))
+            packet_size = payload_size + 4;
+    }
+    else
+    {
+        // Unknown function, the only way to find the packet boundary is to
+        // look for a valid checksum
+        size_t max_size = min<size_t>(inputBuffer.size(), Packet::MAXIMUM_PACKET_SIZE);
+        for (size_t size = 4; size <= max_size; ++size)
+        {
+            if (Packet::isChecksumValid(&inputBuffer[0], &inputBuffer[0] + size))
+            {
+                packet_size = size;
+                break;
+            }
+        }
+        if (packet_size == -1 && inputBuffer.size() < static_cast<size_t>(Packet::MAXIMUM_PACKET_SIZE))
+            return false;
+    }
+
+    if (packet_size == -1)
+    {
+        // Garbage on the line, resynchronize
+        inputBuffer.erase(inputBuffer.begin());
+        return true;
+    }
+
+    vector<byte> response;
+    bool respond;
+    base::Time response_latency;
+    double noise_probability;
+    int noise_size;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        ++requestCount;
+        respond = handleRequest(&inputBuffer[0], packet_size, response);
+        response_latency = latency;
+        noise_probability = noiseProbability;
+        noise_size = maxNoiseSize;
+    }
+    inputBuffer.erase(inputBuffer.begin(), inputBuffer.begin() + packet_size);
+    if (!respond)
+        return true;
+
+    if (!response_latency.isNull())
+        usleep(response_latency.toMicroseconds());
+
+    if (noise_size > 0 && rand_r(&randomSeed) < noise_probability * RAND_MAX)
+    {
+        vector<byte> noise(1 + rand_r(&randomSeed) % noise_size);
+        for (size_t i = 0; i < noise.size(); ++i)
+            noise[i] = rand_r(&randomSeed);
+        sendResponse(noise);
+    }
+    sendResponse(response);
+    return true;
+}
+
+bool Simulator::handleRequest(byte const* request, int size, vector<byte>& response)
+{
+    int address = request[0];
+    int function = request[1];
+    byte const* payload = request + 2;
+
+    int device_address = address;
+    if (address == Packet::ADDRESS_POINT_TO_POINT)
+        device_address = pointToPointAddress;
+    map<int, Device>::iterator it = devices.find(device_address);
+    if (it == devices.end())
+        return false;
+    Device& device = it->second;
+
+    int error = 0;
+    vector<byte> data;
+    if (device.injectedError)
+    {
+        error = device.injectedError;
+        device.injectedError = 0;
+    }
+    else if (!device.initialized && function != D::FUNCTION_INITIALIZE && function != D::FUNCTION_ECHO)
+        error = Error::ERROR_DEVICE_NOT_INITIALIZED;
+    else
+    {
+        switch(function)
+        {
+            case D::FUNCTION_ECHO:
+                data.insert(data.end(), payload, payload + 4);
+                break;
+            case D::FUNCTION_INITIALIZE:
+                data.push_back(device.info.deviceClass);
+                data.push_back(device.info.deviceGroup);
+                data.push_back(device.info.firmwareYear);
+                data.push_back(device.info.firmwareWeek);
+                data.push_back(device.info.internalBufferSize);
+                data.push_back(device.initialized ? 1 : 0);
+                device.initialized = true;
+                break;
+            case D::FUNCTION_SERIAL_NUMBER:
+                data.push_back(device.serialNumber >> 24);
+                data.push_back(device.serialNumber >> 16);
+                data.push_back(device.serialNumber >> 8);
+                data.push_back(device.serialNumber);
+                break;
+            case D::FUNCTION_CONFIGURATION_READ:
+                if (payload[0] == 14)
+                    data.push_back(device.absolute ? 1 : 0);
+                else
+                    error = Error::ERROR_INCORRECT_PARAMETERS;
+                break;
+            case D::FUNCTION_READ_CHANNEL:
+            {
+                int channel = payload[0];
+                if (channel >= 6)
+                {
+                    error = Error::ERROR_INCORRECT_PARAMETERS;
+                    break;
+                }
+
+                int status = device.saturation | device.channelErrors;
+                if (device.poweringUpReads > 0)
+                {
+                    status |= 0x8;
+                    --device.poweringUpReads;
+                }
+                appendFloat(data, device.values[channel]);
+                data.push_back(status);
+                break;
+            }
+            default:
+                error = Error::ERROR_NOT_IMPLEMENTED;
+        }
+    }
+
+    response.push_back(address);
+    if (error)
+    {
+        response.push_back(function | 0x80);
+        response.push_back(error);
+    }
+    else
+    {
+        response.push_back(function);
+        response.insert(response.end(), data.begin(), data.end());
+    }
+    boost::uint16_t crc = Crc16::compute(&response[0], &response[0] + response.size());
+    response.push_back(crc >> 8);
+    response.push_back(crc & 0xFF);
+    return true;
+}
+
+void Simulator::sendResponse(vector<byte> const& response)
+{
+    size_t written = 0;
+    while (written < response.size())
+    {
+        ssize_t count = ::write(master_fd, &response[written], response.size() - written);
+        if (count > 0)
+            written += count;
+        else if (count < 0 && errno == EAGAIN)
+        {
+            // The driver does not read fast enough, wait for room in the
+            // pseudo-terminal. Drop the rest of the response if it does not
+            // read at all, so that stop() does not hang
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(master_fd, &set);
+            timeval tv;
+            tv.tv_sec = 1;
+            tv.tv_usec = 0;
+            int ret = select(master_fd + 1, 0, &set, 0, &tv);
+            if (ret < 0 && errno != EINTR)
+                throw iodrivers_base::UnixError("Simulator: select failed while writing a response");
+            if (ret == 0)
+                return;
+        }
+        else if (count < 0 && errno != EINTR)
+            throw iodrivers_base::UnixError("Simulator: failed to write response");
+    }
+}
+
+void Simulator::start()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    if (running)
+        return;
+    running = true;
+    thread = boost::thread(&Simulator::run, this);
+}
+
+void Simulator::stop()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (!running)
+            return;
+        running = false;
+    }
+    thread.join();
+}
+
+void Simulator::run()
+{
+    while (true)
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            if (!running)
+                return;
+        }
+        process(base::Time::fromMilliseconds(10));
+    }
+}
+
@@ -0,0 +1,158 @@
+#ifndef PRESSURE_VELKI_SIMULATOR_HPP
+#define PRESSURE_VELKI_SIMULATOR_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <base/Time.hpp>
+#include <pressure_velki/Packet.hpp>
+#include <pressure_velki/DeviceInfo.hpp>
+
+namespace pressure_velki
+{
+    /** Simulation of Velki class 5.20 devices on a pseudo-terminal
+     *
+     * The simulator opens a pseudo-terminal and answers the requests that
+     * DriverClass5_20 sends on it. Open the driver with getURI() to talk to
+     * it.
+     *
+     * It can simulate many devices on the same line. As on a real bus, the
+     * devices only answer requests addressed to them.
+     * Packet::ADDRESS_POINT_TO_POINT is answered by the device that was added
+     * first.
+     *
+     * All methods are thread-safe, so the simulation can be modified while
+     * start() runs it in a background thread.
+     */
+    class Simulator
+    {
+    public:
+        struct Device
+        {
+            int address;
+            int serialNumber;
+            DeviceInfo info;
+            bool absolute;
+            bool initialized;
+            /** How many of the next READ_CHANNEL requests are answered
+             * with the powering-up flag
+             */
+            int poweringUpReads;
+            /** Saturation bits (0x7) reported in READ_CHANNEL responses */
+            int saturation;
+            /** Channel error bits reported in READ_CHANNEL responses */
+            int channelErrors;
+            /** Error code the next response is replaced with, zero for none */
+            int injectedError;
+            float values[6];
+        };
+
+    private:
+        int master_fd;
+        int slave_fd;
+        std::string slave_path;
+
+        mutable boost::mutex mutex;
+        std::map<int, Device> devices;
+        int pointToPointAddress;
+        base::Time latency;
+        double noiseProbability;
+        int maxNoiseSize;
+        unsigned int randomSeed;
+        int requestCount;
+        std::vector<byte> inputBuffer;
+
+        bool running;
+        boost::thread thread;
+
+        void run();
+        Device& getDevice(int address);
+        bool processRequest();
+        bool handleRequest(byte const* request, int size, std::vector<byte>& response);
+        void sendResponse(std::vector<byte> const& response);
+
+    public:
+        Simulator();
+        ~Simulator();
+
+        /** Opens the pseudo-terminal */
+        void open();
+
+        /** Closes the pseudo-terminal */
+        void close();
+
+        /** Path of the device the driver should open */
+        std::string getSlavePath() const;
+
+        /** URI that can be given to DriverClass5_20::openURI */
+        std::string getURI(int baudrate = 9600) const;
+
+        /** Adds a simulated device
+         *
+         * The device starts uninitialized. Most requests are answered with
+         * Error::ERROR_DEVICE_NOT_INITIALIZED until it receives
+         * FUNCTION_INITIALIZE.
+         */
+        void addDevice(int address, int serialNumber = 0);
+
+        /** Returns a copy of the current state of a device */
+        Device getDeviceState(int address) const;
+
+        /** Sets the value returned for a channel */
+        void setChannelValue(int address, int channel, float value);
+
+        /** Sets whether the device measures absolute pressures */
+        void setAbsolute(int address, bool absolute);
+
+        /** Sets whether the device is initialized */
+        void setInitialized(int address, bool initialized);
+
+        /** Sets how many of the next READ_CHANNEL requests are answered
+         * with the powering-up flag. It applies immediately, whether the
+         * device is initialized or not
+         */
+        void setPoweringUpReads(int address, int count);
+
+        /** Sets the saturation bits (0x7) of READ_CHANNEL responses */
+        void setSaturation(int address, int bits);
+
+        /** Sets the channel error bits of READ_CHANNEL responses */
+        void setChannelErrors(int address, int bits);
+
+        /** Answers the next request to this device with the given error code */
+        void injectError(int address, int errorCode);
+
+        /** Sets the time between the reception of a request and the sending
+         * of its response
+         */
+        void setLatency(base::Time const& latency);
+
+        /** Sends random bytes before some responses
+         *
+         * @param probability the probability that a response is preceded by
+         *   noise
+         * @param maxSize the maximum number of noise bytes
+         */
+        void setNoise(double probability, int maxSize = 8);
+
+        /** Returns the number of valid requests received so far */
+        int getRequestCount() const;
+
+        /** Processes the requests received within the given time
+         *
+         * @return true if at least one request got processed
+         */
+        bool process(base::Time const& timeout);
+
+        /** Runs process() in a background thread until stop() is called */
+        void start();
+
+        /** Stops the thread started with start() */
+        void stop();
+    };
+}
+
+#endif
+
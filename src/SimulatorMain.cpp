@@ -0,0 +1,62 @@
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pressure_velki/Simulator.hpp>
+
+using namespace pressure_velki;
+using namespace std;
+
+static void usage(char const* name)
+{
+    cerr << "usage: " << name << " [-l LATENCY_MS] [-n NOISE_PROBABILITY] [-p POWERING_UP_READS] [ADDRESS...]\n"
+        << "simulates Velki class 5.20 devices on a pseudo-terminal. The device(s)\n"
+        << "are at address 1 if none are given" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    double latency_ms = 0;
+    double noise = 0;
+    int powering_up = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "l:n:p:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'l': latency_ms = atof(optarg); break;
+            case 'n': noise = atof(optarg); break;
+            case 'p': powering_up = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    vector<int> addresses;
+    for (int i = optind; i < argc; ++i)
+        addresses.push_back(atoi(argv[i]));
+    if (addresses.empty())
+        addresses.push_back(1);
+
+    Simulator simulator;
+    simulator.open();
+    simulator.setLatency(base::Time::fromMicroseconds(latency_ms * 1000));
+    simulator.setNoise(noise);
+    for (size_t i = 0; i < addresses.size(); ++i)
+    {
+        int address = addresses[i];
+        simulator.addDevice(address, address);
+        simulator.setPoweringUpReads(address, powering_up);
+        simulator.setChannelValue(address, 1, 1.013);
+        simulator.setChannelValue(address, 2, 1.013);
+        simulator.setChannelValue(address, 3, 25);
+        simulator.setChannelValue(address, 4, 25);
+        simulator.setChannelValue(address, 5, 25);
+    }
+
+    cout << simulator.getURI() << endl;
+    while (true)
+        simulator.process(base::Time::fromSeconds(1));
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <pressure_velki/TimestampEstimator.hpp>
+#include <algorithm>
+
+using namespace pressure_velki;
+
+TimestampEstimator::TimestampEstimator()
+    : currentCount(0)
+    , hasPrevious(false)
+{
+}
+
+void TimestampEstimator::setConversionDelay(base::Time const& delay, base::Time const& uncertainty)
+{
+    conversionDelay = delay;
+    conversionUncertainty = uncertainty;
+}
+
+void TimestampEstimator::update(base::Time const& requestEnd, base::Time const& responseStart,
+        base::Time& time, base::Time& uncertainty)
+{
+    base::Time turnaround = std::max(responseStart - requestEnd, base::Time());
+    if (currentCount == WINDOW_SIZE)
+    {
+        previousMinimum = currentMinimum;
+        hasPrevious = true;
+        currentCount = 0;
+    }
+    if (currentCount == 0 || turnaround < currentMinimum)
+        currentMinimum = turnaround;
+    ++currentCount;
+
+    base::Time latestArrival = responseStart;
+    if (getSampleCount() >= MINIMUM_SAMPLES)
+        latestArrival = responseStart - getProcessingDelay();
+
+    base::Time halfWidth = base::Time::fromMicroseconds((latestArrival - requestEnd).toMicroseconds() / 2);
+    time = requestEnd + halfWidth - conversionDelay;
+    uncertainty = halfWidth + conversionUncertainty;
+}
+
+base::Time TimestampEstimator::getProcessingDelay() const
+{
+    if (hasPrevious)
+        return std::min(currentMinimum, previousMinimum);
+    return currentMinimum;
+}
+
+int TimestampEstimator::getSampleCount() const
+{
+    return currentCount + (hasPrevious ? WINDOW_SIZE : 0);
+}
+
+void TimestampEstimator::reset()
+{
+    currentMinimum = base::Time();
+    previousMinimum = base::Time();
+    currentCount = 0;
+    hasPrevious = false;
+}
@@ -0,0 +1,82 @@
+#ifndef PRESSURE_VELKI_TIMESTAMP_ESTIMATOR_HPP
+#define PRESSURE_VELKI_TIMESTAMP_ESTIMATOR_HPP
+
+#include <base/Time.hpp>
+
+namespace pressure_velki
+{
+    /** Estimation of the time at which a device acquired the value it sent
+     * back
+     *
+     * The device handles a request some time between the end of the request
+     * on the line and the start of the response. The time it takes to
+     * handle a request, the processing delay, is estimated as the minimum of
+     * the observed turnarounds: anything above it is scheduling jitter on
+     * our side. The request therefore reached the device between the end
+     * of the request and the start of the response minus the processing
+     * delay, and the estimate is the middle of that interval, with half its
+     * width as uncertainty.
+     *
+     * Only the last WINDOW_SIZE to 2 * WINDOW_SIZE turnarounds are taken
+     * into account, so that the processing delay follows slow drifts of the
+     * device (e.g. with temperature). Until MINIMUM_SAMPLES turnarounds got
+     * observed, the whole turnaround is used as the interval.
+     *
+     * The value may also have been acquired before the request got
+     * handled, e.g. if the device returns the last completed conversion.
+     * This is the conversion delay, which cannot be observed on the bus
+     * and is given with setConversionDelay().
+     */
+    class TimestampEstimator
+    {
+    public:
+        static const int WINDOW_SIZE = 256;
+        static const int MINIMUM_SAMPLES = 16;
+
+    private:
+        base::Time currentMinimum;
+        base::Time previousMinimum;
+        int currentCount;
+        bool hasPrevious;
+        base::Time conversionDelay;
+        base::Time conversionUncertainty;
+
+    public:
+        TimestampEstimator();
+
+        /** Sets how long before handling a request the device acquired the
+         * value it returns
+         *
+         * @param uncertainty the uncertainty on this delay. For a device
+         *   that returns the last completed conversion, it is half the
+         *   conversion period, with the delay being the other half
+         */
+        void setConversionDelay(base::Time const& delay, base::Time const& uncertainty = base::Time());
+
+        /** Updates the model with a transaction and estimates the
+         * acquisition time of the returned value
+         *
+         * @param requestEnd the time at which the request was fully
+         *   transmitted
+         * @param responseStart the time at which the response started to
+         *   be received
+         * @param time set to the estimated acquisition time
+         * @param uncertainty set to the maximum error of the estimate
+         */
+        void update(base::Time const& requestEnd, base::Time const& responseStart,
+                base::Time& time, base::Time& uncertainty);
+
+        /** Returns the estimated processing delay, or a null time if no
+         * turnaround has been observed yet
+         */
+        base::Time getProcessingDelay() const;
+
+        /** Returns the number of turnarounds the estimate is based on */
+        int getSampleCount() const;
+
+        /** Forgets all observed turnarounds. The conversion delay is kept */
+        void reset();
+    };
+}
+
+#endif
@@ -0,0 +1,23 @@
+#include <iostream>
+#include <vector>
+#include <pressure_velki/TraceRing.hpp>
+
+using namespace pressure_velki;
+using namespace std;
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        cerr << "usage: " << argv[0] << " TRACE_FILE\n"
+            << "displays the events of a file-backed I/O trace, oldest first. The\n"
+            << "trace can be read while the process that writes it runs, or after\n"
+            << "it crashed" << endl;
+        return 1;
+    }
+
+    vector<TraceRing::Event> events;
+    TraceRing::readFile(argv[1], events);
+    TraceRing::dump(cout, events);
+    return 0;
+}
@@ -0,0 +1,323 @@
+#include <pressure_velki/TraceRing.hpp>
+#include <pressure_velki/FrameLog.hpp>
+#include <iodrivers_base/Driver.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <new>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/atomic.hpp>
+#include <boost/static_assert.hpp>
+
+using namespace pressure_velki;
+using namespace std;
+using boost::uint8_t;
+using boost::uint16_t;
+using boost::uint32_t;
+using boost::uint64_t;
+
+namespace
+{
+    const char MAGIC[8] = { 'V', 'E', 'L', 'K', 'I', 'T', 'R', 'C' };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t capacity;
+        /** Index of the next event. Slots are claimed by incrementing it */
+        boost::atomic<uint32_t> head;
+        uint8_t reserved[12];
+    };
+
+    struct Slot
+    {
+        /** Index of the event plus one, or zero while the slot is written */
+        boost::atomic<uint32_t> sequence;
+        uint8_t type;
+        uint8_t address;
+        uint8_t function;
+        uint8_t reserved;
+        uint64_t time;
+        uint16_t length;
+        uint8_t payload[TraceRing::PAYLOAD_SIZE];
+    };
+
+    BOOST_STATIC_ASSERT(sizeof(Header) == 32);
+    BOOST_STATIC_ASSERT(sizeof(Slot) == 32);
+
+    uint32_t roundCapacity(size_t capacity)
+    {
+        if (capacity == 0 || capacity > (1U << 24))
+            throw std::invalid_argument("TraceRing: capacity must be between 1 and 2^24");
+        uint32_t result = 1;
+        while (result < capacity)
+            result <<= 1;
+        return result;
+    }
+
+    size_t mappingSizeFor(uint32_t capacity)
+    {
+        return sizeof(Header) + capacity * sizeof(Slot);
+    }
+
+    Header* headerOf(uint8_t* mapping)
+    {
+        return reinterpret_cast<Header*>(mapping);
+    }
+
+    Slot* slotsOf(uint8_t* mapping)
+    {
+        return reinterpret_cast<Slot*>(mapping + sizeof(Header));
+    }
+
+    /** Copies the events of a mapped ring, skipping the slots that are
+     * being written
+     */
+    void collect(uint8_t const* mapping, vector<TraceRing::Event>& events)
+    {
+        Header const* header = reinterpret_cast<Header const*>(mapping);
+        Slot const* slots = reinterpret_cast<Slot const*>(mapping + sizeof(Header));
+        uint32_t capacity = header->capacity;
+
+        uint32_t end = header->head.load(boost::memory_order_acquire);
+        uint32_t count = std::min(end, capacity);
+        for (uint32_t index = end - count; index != end; ++index)
+        {
+            Slot const& slot = slots[index & (capacity - 1)];
+            uint32_t sequence = slot.sequence.load(boost::memory_order_acquire);
+            if (sequence != index + 1)
+                continue;
+
+            TraceRing::Event event;
+            event.time = slot.time;
+            event.type = static_cast<TraceRing::EVENT_TYPE>(slot.type);
+            event.address = slot.address;
+            event.function = slot.function;
+            event.length = slot.length;
+            event.payloadSize = std::max(0, std::min<int>(event.length - 2, TraceRing::PAYLOAD_SIZE));
+            memcpy(event.payload, slot.payload, event.payloadSize);
+
+            // Drop the event if a writer reused the slot while we copied it
+            boost::atomic_thread_fence(boost::memory_order_acquire);
+            if (slot.sequence.load(boost::memory_order_relaxed) != sequence)
+                continue;
+            events.push_back(event);
+        }
+    }
+
+    char const* typeName(TraceRing::EVENT_TYPE type)
+    {
+        switch(type)
+        {
+            case TraceRing::SENT: return "SENT";
+            case TraceRing::RECEIVED: return "RECEIVED";
+            case TraceRing::DISCARDED: return "DISCARDED";
+            case TraceRing::TIMEOUT: return "TIMEOUT";
+            case TraceRing::RETRY: return "RETRY";
+        }
+        return "UNKNOWN";
+    }
+}
+
+const int TraceRing::PAYLOAD_SIZE;
+const int TraceRing::DEFAULT_CAPACITY;
+const int TraceRing::VERSION;
+
+TraceRing::TraceRing(size_t capacity)
+    : fd(-1)
+    , mapping(0)
+    , mappingSize(0)
+    , capacity(0)
+{
+    map(-1, capacity);
+}
+
+TraceRing::TraceRing(string const& path, size_t capacity)
+    : fd(-1)
+    , mapping(0)
+    , mappingSize(0)
+    , capacity(0)
+{
+    int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file == -1)
+        throw iodrivers_base::UnixError("cannot create trace " + path);
+    if (ftruncate(file, mappingSizeFor(roundCapacity(capacity))) == -1)
+    {
+        ::close(file);
+        throw iodrivers_base::UnixError("cannot resize trace " + path);
+    }
+
+    fd = file;
+    try { map(fd, capacity); }
+    catch(...)
+    {
+        ::close(fd);
+        throw;
+    }
+}
+
+void TraceRing::map(int fd, size_t capacity)
+{
+    this->capacity = roundCapacity(capacity);
+    mappingSize = mappingSizeFor(this->capacity);
+
+    void* result;
+    if (fd == -1)
+        result = mmap(0, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    else
+        result = mmap(0, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (result == MAP_FAILED)
+        throw iodrivers_base::UnixError("cannot map trace");
+    mapping = static_cast<uint8_t*>(result);
+
+    // The mapping is zero-filled, which is an empty ring
+    Header* header = headerOf(mapping);
+    new (&header->head) boost::atomic<uint32_t>(0);
+    Slot* slots = slotsOf(mapping);
+    for (uint32_t i = 0; i < this->capacity; ++i)
+        new (&slots[i].sequence) boost::atomic<uint32_t>(0);
+    header->version = VERSION;
+    header->capacity = this->capacity;
+    // Write the magic last, so that a truncated file is not mistaken for a
+    // trace
+    memcpy(header->magic, MAGIC, 8);
+}
+
+TraceRing::~TraceRing()
+{
+    munmap(mapping, mappingSize);
+    if (fd != -1)
+        ::close(fd);
+}
+
+size_t TraceRing::getCapacity() const
+{
+    return capacity;
+}
+
+uint32_t TraceRing::getEventCount() const
+{
+    return headerOf(mapping)->head.load(boost::memory_order_relaxed);
+}
+
+void TraceRing::record(EVENT_TYPE type, uint8_t const* data, int size)
+{
+    uint32_t index = headerOf(mapping)->head.fetch_add(1, boost::memory_order_relaxed);
+    Slot& slot = slotsOf(mapping)[index & (capacity - 1)];
+    slot.sequence.store(0, boost::memory_order_relaxed);
+    boost::atomic_thread_fence(boost::memory_order_release);
+
+    slot.time = FrameLog::now();
+    slot.type = type;
+    slot.address = size > 0 ? data[0] : 0;
+    slot.function = size > 1 ? data[1] : 0;
+    slot.length = std::min(size, 0xFFFF);
+    if (size > 2)
+        memcpy(slot.payload, data + 2, std::min(size - 2, static_cast<int>(PAYLOAD_SIZE)));
+
+    slot.sequence.store(index + 1, boost::memory_order_release);
+}
+
+void TraceRing::record(EVENT_TYPE type, int address, int function)
+{
+    uint32_t index = headerOf(mapping)->head.fetch_add(1, boost::memory_order_relaxed);
+    Slot& slot = slotsOf(mapping)[index & (capacity - 1)];
+    slot.sequence.store(0, boost::memory_order_relaxed);
+    boost::atomic_thread_fence(boost::memory_order_release);
+
+    slot.time = FrameLog::now();
+    slot.type = type;
+    slot.address = address;
+    slot.function = function;
+    slot.length = 0;
+
+    slot.sequence.store(index + 1, boost::memory_order_release);
+}
+
+void TraceRing::snapshot(vector<Event>& events) const
+{
+    collect(mapping, events);
+}
+
+void TraceRing::dump(ostream& io) const
+{
+    vector<Event> events;
+    snapshot(events);
+    dump(io, events);
+}
+
+void TraceRing::readFile(string const& path, vector<Event>& events)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw iodrivers_base::UnixError("cannot open trace " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+        ::close(fd);
+        throw iodrivers_base::UnixError("cannot stat trace " + path);
+    }
+    size_t size = info.st_size;
+    if (size < sizeof(Header))
+    {
+        ::close(fd);
+        throw std::runtime_error(path + " is not a trace");
+    }
+
+    void* result = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (result == MAP_FAILED)
+        throw iodrivers_base::UnixError("cannot map trace " + path);
+    uint8_t const* mapping = static_cast<uint8_t const*>(result);
+
+    Header const* header = reinterpret_cast<Header const*>(mapping);
+    string error;
+    if (memcmp(header->magic, MAGIC, 8) != 0)
+        error = path + " is not a trace";
+    else if (header->version != static_cast<uint32_t>(VERSION))
+        error = path + " has an unsupported trace version";
+    else if (header->capacity == 0 || (header->capacity & (header->capacity - 1)) ||
+            size < mappingSizeFor(header->capacity))
+        error = path + " is truncated";
+
+    if (error.empty())
+        collect(mapping, events);
+    munmap(result, size);
+    if (!error.empty())
+        throw std::runtime_error(error);
+}
+
+void TraceRing::dump(ostream& io, vector<Event> const& events)
+{
+    ios_base::fmtflags flags = io.flags();
+    char fill = io.fill();
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        Event const& event = events[i];
+        uint64_t delta = (i == 0) ? 0 : event.time - events[i - 1].time;
+        io << setfill(' ') << dec
+            << setw(10) << event.time / 1000000 << "." << setfill('0') << setw(6) << event.time % 1000000
+            << setfill(' ') << " +" << setw(8) << delta << "us "
+            << left << setw(9) << typeName(event.type) << right
+            << " addr=" << setw(3) << event.address
+            << " func=" << setw(3) << event.function;
+        if (event.type != TIMEOUT && event.type != RETRY)
+        {
+            io << " len=" << setw(3) << event.length << " " << hex << setfill('0');
+            for (int b = 0; b < event.payloadSize; ++b)
+                io << " " << setw(2) << static_cast<int>(event.payload[b]);
+            if (event.payloadSize + 2 < event.length)
+                io << " ...";
+        }
+        io << "\n";
+    }
+    io.flags(flags);
+    io.fill(fill);
+}
@@ -0,0 +1,133 @@
+#ifndef PRESSURE_VELKI_TRACE_RING_HPP
+#define PRESSURE_VELKI_TRACE_RING_HPP
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace pressure_velki
+{
+    /** Fixed-size ring of compact binary events describing the I/O of a
+     * driver
+     *
+     * Recording an event is a few stores in a preallocated slot, without
+     * formatting, allocation or system call, so that tracing can stay
+     * enabled without changing the timing of the communication. Once the
+     * ring is full, the oldest events are overwritten.
+     *
+     * Recording is lock-free, and several threads may record in the same
+     * ring. Each slot holds a sequence number that is cleared while the slot
+     * is being written, which lets snapshot() skip the events that are being
+     * overwritten.
+     *
+     * The ring is either in anonymous memory, or mapped from a file. In the
+     * latter case, the file holds the last events even if the process
+     * crashes, and can be rendered with the pressure_velki_trace_dump tool.
+     * The file layout is the 8-byte magic "VELKITRC", a 32-bit version, the
+     * 32-bit capacity and the 32-bit event counter, padded to 32 bytes,
+     * followed by the 32-byte slots. It is in the host's byte order.
+     */
+    class TraceRing : boost::noncopyable
+    {
+    public:
+        enum EVENT_TYPE
+        {
+            /** Data written on the port */
+            SENT = 1,
+            /** A frame read from the port */
+            RECEIVED = 2,
+            /** Received bytes that are not part of the expected response */
+            DISCARDED = 3,
+            /** No response from the device within the timeout */
+            TIMEOUT = 4,
+            /** A request is sent again after a timeout */
+            RETRY = 5
+        };
+
+        /** How many bytes following the address and function are kept */
+        static const int PAYLOAD_SIZE = 14;
+        static const int DEFAULT_CAPACITY = 1024;
+        static const int VERSION = 1;
+
+        struct Event
+        {
+            /** Monotonic timestamp in microseconds, see FrameLog::now() */
+            boost::uint64_t time;
+            EVENT_TYPE type;
+            /** The first two bytes of the data, or the address and function
+             * of the expected response for TIMEOUT and RETRY
+             */
+            int address;
+            int function;
+            /** The full size of the data, zero for TIMEOUT and RETRY */
+            int length;
+            /** The bytes following the address and function, truncated to
+             * PAYLOAD_SIZE
+             */
+            boost::uint8_t payload[PAYLOAD_SIZE];
+            int payloadSize;
+        };
+
+    private:
+        int fd;
+        boost::uint8_t* mapping;
+        size_t mappingSize;
+        boost::uint32_t capacity;
+
+        void map(int fd, size_t capacity);
+
+    public:
+        /** Creates a ring in anonymous memory
+         *
+         * @param capacity the number of events. It is rounded up to a power
+         *   of two
+         */
+        explicit TraceRing(size_t capacity = DEFAULT_CAPACITY);
+
+        /** Creates a ring mapped from a file, which is created or truncated
+         *
+         * @param capacity the number of events. It is rounded up to a power
+         *   of two
+         */
+        TraceRing(std::string const& path, size_t capacity = DEFAULT_CAPACITY);
+
+        ~TraceRing();
+
+        /** Returns the number of events the ring can hold */
+        size_t getCapacity() const;
+
+        /** Returns the number of events recorded since the creation of the
+         * ring, including the ones that got overwritten
+         */
+        boost::uint32_t getEventCount() const;
+
+        /** Records data sent or received */
+        void record(EVENT_TYPE type, boost::uint8_t const* data, int size);
+
+        /** Records an event that has no data */
+        void record(EVENT_TYPE type, int address, int function);
+
+        /** Copies the events currently in the ring at the end of \c events,
+         * oldest first
+         */
+        void snapshot(std::vector<Event>& events) const;
+
+        /** Renders the events currently in the ring */
+        void dump(std::ostream& io) const;
+
+        /** Reads the events of a file-backed ring, e.g. after a crash
+         *
+         * @throw std::runtime_error if the file is not a trace
+         */
+        static void readFile(std::string const& path, std::vector<Event>& events);
+
+        /** Renders events, one per line, with the time elapsed since the
+         * previous event
+         */
+        static void dump(std::ostream& io, std::vector<Event> const& events);
+    };
+}
+
+#endif
@@ -0,0 +1,266 @@
+#include <pressure_velki/DriverClass5_20.hpp>
+#include <pressure_velki/Simulator.hpp>
+#include <pressure_velki/Packet.hpp>
+#include <pressure_velki/BatchDecoder.hpp>
+#include <pressure_velki/TraceRing.hpp>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace pressure_velki;
+using namespace std;
+
+/** Micro- and macro-benchmarks of the packet and driver hot paths
+ *
+ * Results are written on stdout, one JSON object per line, so that they can
+ * be compared across releases
+ */
+
+namespace
+{
+    double nowInSeconds()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    /** Prevents the compiler from optimizing away benchmarked results */
+    volatile int sink;
+
+    void reportMicro(string const& name, long iterations, double duration)
+    {
+        cout << "{\"type\":\"micro\",\"name\":\"" << name << "\""
+            << ",\"iterations\":" << iterations
+            << ",\"ns_per_op\":" << duration * 1e9 / iterations
+            << "}" << endl;
+    }
+
+    void reportMacro(string const& name, vector<double> latencies, double duration)
+    {
+        sort(latencies.begin(), latencies.end());
+        size_t count = latencies.size();
+        cout << "{\"type\":\"macro\",\"name\":\"" << name << "\""
+            << ",\"transactions\":" << count
+            << ",\"tps\":" << count / duration
+            << ",\"p50_us\":" << latencies[count / 2] * 1e6
+            << ",\"p90_us\":" << latencies[count * 9 / 10] * 1e6
+            << ",\"p99_us\":" << latencies[count * 99 / 100] * 1e6
+            << ",\"max_us\":" << latencies[count - 1] * 1e6
+            << "}" << endl;
+    }
+
+    /** Gives access to the driver's packet extraction */
+    struct BenchDriver : public DriverClass5_20
+    {
+        void expect(int address, int function, int payloadSize)
+        {
+            expectResponse(address, function, payloadSize);
+        }
+
+        /** Extracts a packet the way iodrivers_base does, dropping bytes
+         * until a packet is found
+         */
+        int extract(byte const* buffer, size_t size) const
+        {
+            size_t offset = 0;
+            while (offset < size)
+            {
+                int result = extractPacket(buffer + offset, size - offset);
+                if (result > 0)
+                    return result;
+                else if (result == 0)
+                    return 0;
+                offset -= result;
+            }
+            return 0;
+        }
+    };
+
+    vector<byte> readChannelResponse(int address)
+    {
+        vector<byte> buffer;
+        Packet packet(address, DriverClass5_20::FUNCTION_READ_CHANNEL);
+        byte payload[5] = { 63, 109, 186, 172, 0 };
+        packet.addBytes(payload, 5);
+        packet.marshal(buffer);
+        return buffer;
+    }
+
+    void runMicro(long iterations)
+    {
+        vector<byte> response = readChannelResponse(1);
+
+        {
+            Packet packet(1, DriverClass5_20::FUNCTION_READ_CHANNEL);
+            packet.addByte(DriverClass5_20::CHANNEL_PRESSURE0);
+            vector<byte> buffer;
+            double start = nowInSeconds();
+            for (long i = 0; i < iterations; ++i)
+            {
+                buffer.clear();
+                packet.marshal(buffer);
+            }
+            reportMicro("Packet::marshal", iterations, nowInSeconds() - start);
+        }
+
+        {
+            int size = 0;
+            double start = nowInSeconds();
+            for (long i = 0; i < iterations; ++i)
+                size += RequestFrames::readChannel(i % RequestFrames::CHANNEL_COUNT, 1).size;
+            sink = size;
+            reportMicro("RequestFrames::readChannel", iterations, nowInSeconds() - start);
+        }
+
+        {
+            Packet packet;
+            double start = nowInSeconds();
+            for (long i = 0; i < iterations; ++i)
+                sink = packet.unmarshal(&response[0], response.size());
+            reportMicro("Packet::unmarshal", iterations, nowInSeconds() - start);
+        }
+
+        {
+            double start = nowInSeconds();
+            for (long i = 0; i < iterations; ++i)
+                sink = Packet::isChecksumValid(&response[0], &response[0] + response.size());
+            reportMicro("Packet::isChecksumValid", iterations, nowInSeconds() - start);
+        }
+
+        {
+            float sum = 0;
+            double start = nowInSeconds();
+            for (long i = 0; i < iterations; ++i)
+                sum += Packet::parseFloat(&response[2]);
+            sink = sum;
+            reportMicro("Packet::parseFloat", iterations, nowInSeconds() - start);
+        }
+
+        {
+            // Decode 1024 frames per call, as when processing a recorded
+            // session
+            const int batch = 1024;
+            vector<byte> frames;
+            vector<boost::uint32_t> offsets;
+            for (int i = 0; i < batch; ++i)
+            {
+                offsets.push_back(frames.size());
+                frames.insert(frames.end(), response.begin(), response.end());
+            }
+            vector<byte> channels(batch, DriverClass5_20::CHANNEL_PRESSURE0);
+            ChannelColumns columns;
+
+            long batch_iterations = max(1L, iterations / batch);
+            double start = nowInSeconds();
+            for (long i = 0; i < batch_iterations; ++i)
+            {
+                columns.clear();
+                BatchDecoder::decode(&frames[0], &offsets[0], &channels[0], batch, columns);
+            }
+            sink = columns.size();
+            reportMicro("BatchDecoder::decode", batch_iterations * batch, nowInSeconds() - start);
+        }
+
+        {
+            TraceRing ring;
+            double start = nowInSeconds();
+            for (long i = 0; i < iterations; ++i)
+                ring.record(TraceRing::RECEIVED, &response[0], response.size());
+            sink = ring.getEventCount();
+            reportMicro("TraceRing::record", iterations, nowInSeconds() - start);
+        }
+
+        BenchDriver driver;
+        driver.expect(1, DriverClass5_20::FUNCTION_READ_CHANNEL, 5);
+        {
+            double start = nowInSeconds();
+            for (long i = 0; i < iterations; ++i)
+                sink = driver.extract(&response[0], response.size());
+            reportMicro("extractPacket_clean", iterations, nowInSeconds() - start);
+        }
+
+        {
+            // 64 bytes of noise containing plausible frame starts, followed by
+            // a valid response
+            vector<byte> noisy;
+            srand(0);
+            for (int i = 0; i < 64; ++i)
+                noisy.push_back((i % 8 == 0) ? 1 : (rand() & 0xFF));
+            noisy.insert(noisy.end(), response.begin(), response.end());
+
+            long noisy_iterations = max(1L, iterations / 10);
+            double start = nowInSeconds();
+            for (long i = 0; i < noisy_iterations; ++i)
+                sink = driver.extract(&noisy[0], noisy.size());
+            reportMicro("extractPacket_noisy", noisy_iterations, nowInSeconds() - start);
+        }
+    }
+
+    void runMacro(int transactions)
+    {
+        Simulator simulator;
+        simulator.open();
+        simulator.addDevice(1);
+        simulator.setInitialized(1, true);
+        simulator.start();
+
+        DriverClass5_20 driver;
+        driver.openURI(simulator.getURI(115200));
+
+        {
+            vector<double> latencies;
+            double start = nowInSeconds();
+            for (int i = 0; i < transactions; ++i)
+            {
+                double t = nowInSeconds();
+                driver.readPressure(0, 1);
+                latencies.push_back(nowInSeconds() - t);
+            }
+            reportMacro("readPressure", latencies, nowInSeconds() - start);
+        }
+
+        {
+            vector<DriverClass5_20::CHANNEL_ID> channels;
+            channels.push_back(DriverClass5_20::CHANNEL_PRESSURE0);
+            channels.push_back(DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE0);
+            channels.push_back(DriverClass5_20::CHANNEL_PRESSURE1);
+            channels.push_back(DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE1);
+
+            vector<double> latencies;
+            double start = nowInSeconds();
+            for (int i = 0; i < transactions; ++i)
+            {
+                double t = nowInSeconds();
+                driver.readChannels(channels, 1);
+                latencies.push_back(nowInSeconds() - t);
+            }
+            reportMacro("readChannels_4", latencies, nowInSeconds() - start);
+        }
+
+        simulator.stop();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3)
+    {
+        cerr << "usage: " << argv[0] << " [MICRO_ITERATIONS] [TRANSACTIONS]\n"
+            << "runs the micro-benchmarks MICRO_ITERATIONS times (default 1000000) and\n"
+            << "the transactions against a simulated device TRANSACTIONS times (default 1000).\n"
+            << "Set either to zero to skip the corresponding benchmarks" << endl;
+        return 1;
+    }
+
+    long iterations = (argc > 1) ? atol(argv[1]) : 1000000;
+    int transactions = (argc > 2) ? atoi(argv[2]) : 1000;
+    if (iterations > 0)
+        runMicro(iterations);
+    if (transactions > 0)
+        runMacro(transactions);
+    return 0;
+}
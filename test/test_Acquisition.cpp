@@ -0,0 +1,171 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/Acquisition.hpp>
+#include <pressure_velki/Simulator.hpp>
+#include <unistd.h>
+
+using namespace std;
+using namespace pressure_velki;
+
+BOOST_AUTO_TEST_CASE(SPSCRing_is_first_in_first_out)
+{
+    SPSCRing<int> ring(4);
+    BOOST_CHECK(ring.push(1));
+    BOOST_CHECK(ring.push(2));
+    int value;
+    BOOST_REQUIRE(ring.pop(value));
+    BOOST_CHECK_EQUAL(1, value);
+    BOOST_REQUIRE(ring.pop(value));
+    BOOST_CHECK_EQUAL(2, value);
+    BOOST_CHECK(!ring.pop(value));
+}
+
+BOOST_AUTO_TEST_CASE(SPSCRing_drops_new_elements_when_full)
+{
+    SPSCRing<int> ring(2);
+    BOOST_CHECK(ring.push(1));
+    BOOST_CHECK(ring.push(2));
+    BOOST_CHECK(!ring.push(3));
+    BOOST_CHECK_EQUAL(1, ring.getOverruns());
+
+    int value;
+    BOOST_REQUIRE(ring.peek(0, value));
+    BOOST_CHECK_EQUAL(2, value);
+    BOOST_REQUIRE(ring.peek(1, value));
+    BOOST_CHECK_EQUAL(1, value);
+    BOOST_CHECK(!ring.peek(2, value));
+}
+
+struct AcquisitionFixture
+{
+    Simulator simulator;
+    Acquisition acquisition;
+
+    AcquisitionFixture()
+    {
+        simulator.open();
+        simulator.addDevice(1);
+        simulator.setInitialized(1, true);
+        simulator.setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE0, 1.5);
+        simulator.setChannelValue(1, DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE0, 20);
+        simulator.start();
+        acquisition.getDriver().openURI(simulator.getURI(115200));
+        acquisition.getDriver().setReadTimeout(base::Time::fromMilliseconds(100));
+
+        Acquisition::Channels channels;
+        channels.push_back(DriverClass5_20::CHANNEL_PRESSURE0);
+        channels.push_back(DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE0);
+        acquisition.addDevice(1, channels);
+    }
+
+    ~AcquisitionFixture()
+    {
+        acquisition.stop();
+        simulator.stop();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(Acquisition_with_simulator, AcquisitionFixture)
+
+BOOST_AUTO_TEST_CASE(it_acquires_samples_in_the_background)
+{
+    acquisition.start();
+    vector<Sample> samples;
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(2);
+    while (samples.size() < 10 && base::Time::now() < deadline)
+    {
+        acquisition.drain(samples);
+        usleep(1000);
+    }
+    acquisition.stop();
+
+    BOOST_REQUIRE(samples.size() >= 10);
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        BOOST_REQUIRE_EQUAL(Sample::STATUS_OK, samples[i].status);
+        BOOST_REQUIRE_EQUAL(1, samples[i].device);
+        if (samples[i].channel == DriverClass5_20::CHANNEL_PRESSURE0)
+            BOOST_REQUIRE_CLOSE(1.5, samples[i].getPressure().toBar(), 1e-3);
+        else
+            BOOST_REQUIRE_CLOSE(20, samples[i].value, 1e-3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(it_gives_the_latest_sample_of_a_channel)
+{
+    Sample sample;
+    BOOST_CHECK(!acquisition.latest(1, DriverClass5_20::CHANNEL_PRESSURE0, sample));
+    acquisition.pollOnce();
+    BOOST_REQUIRE(acquisition.latest(1, DriverClass5_20::CHANNEL_PRESSURE0, sample));
+    BOOST_CHECK_CLOSE(1.5, sample.value, 1e-3);
+
+    vector<Sample> samples;
+    BOOST_CHECK_EQUAL(2, acquisition.drain(samples));
+    BOOST_REQUIRE(acquisition.latest(1, DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE0, sample));
+    BOOST_CHECK_CLOSE(20, sample.value, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(it_keeps_the_latest_sample_up_to_date_when_the_ring_is_full)
+{
+    Acquisition small(2);
+    small.getDriver().openURI(simulator.getURI(115200));
+    small.getDriver().setReadTimeout(base::Time::fromMilliseconds(100));
+    small.addDevice(1, Acquisition::Channels(1, DriverClass5_20::CHANNEL_PRESSURE0));
+
+    for (int i = 0; i < 4; ++i)
+    {
+        simulator.setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE0, i);
+        small.pollOnce();
+    }
+    BOOST_CHECK_EQUAL(2, small.getOverruns());
+    Sample sample;
+    BOOST_REQUIRE(small.latest(1, DriverClass5_20::CHANNEL_PRESSURE0, sample));
+    BOOST_CHECK_CLOSE(3, sample.value, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(it_stops_the_thread_when_the_port_fails)
+{
+    acquisition.start();
+    usleep(20000);
+    simulator.stop();
+    simulator.close();
+
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(2);
+    while (acquisition.isRunning() && base::Time::now() < deadline)
+        usleep(1000);
+    BOOST_CHECK(!acquisition.isRunning());
+    BOOST_CHECK(acquisition.hasFailed());
+    BOOST_CHECK(!acquisition.getFailure().empty());
+    acquisition.stop();
+}
+
+BOOST_AUTO_TEST_CASE(it_reports_failures_as_sample_status)
+{
+    simulator.setPoweringUpReads(1, 2);
+    acquisition.pollOnce();
+    simulator.setInitialized(1, false);
+    acquisition.pollOnce();
+
+    vector<Sample> samples;
+    BOOST_REQUIRE_EQUAL(4, acquisition.drain(samples));
+    BOOST_CHECK_EQUAL(Sample::STATUS_POWERING_UP, samples[0].status);
+    BOOST_CHECK_EQUAL(Sample::STATUS_POWERING_UP, samples[1].status);
+    BOOST_CHECK_EQUAL(Sample::STATUS_DEVICE_ERROR, samples[2].status);
+    BOOST_CHECK_EQUAL(Sample::STATUS_DEVICE_ERROR, samples[3].status);
+}
+
+BOOST_AUTO_TEST_CASE(it_publishes_the_samples_in_shared_memory)
+{
+    SharedSampleWriter writer;
+    writer.create("/pressure_velki_test_acquisition", 16);
+    acquisition.setSharedWriter(&writer);
+    acquisition.pollOnce();
+
+    SharedSampleReader reader;
+    reader.open("/pressure_velki_test_acquisition");
+    BOOST_CHECK_EQUAL(2, reader.getPublishedCount());
+    Sample sample;
+    BOOST_REQUIRE(reader.latest(1, DriverClass5_20::CHANNEL_PRESSURE0, sample));
+    BOOST_CHECK_CLOSE(1.5, sample.value, 1e-3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,97 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/BatchDecoder.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+#include <pressure_velki/PacketView.hpp>
+#include <base/Float.hpp>
+#include <stdlib.h>
+
+using namespace std;
+using namespace pressure_velki;
+
+BOOST_AUTO_TEST_CASE(BatchDecoder_matches_decodeChannel)
+{
+    // An odd number of frames, with some padding between them, to exercise
+    // both the SIMD and the scalar paths
+    const size_t count = 103;
+    vector<byte> buffer;
+    vector<boost::uint32_t> offsets;
+    vector<byte> channels;
+    srand(0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        buffer.resize(buffer.size() + (i % 3));
+        offsets.push_back(buffer.size());
+        channels.push_back(i % 6);
+
+        Packet packet(i % 256, DriverClass5_20::FUNCTION_READ_CHANNEL);
+        for (int b = 0; b < 4; ++b)
+            packet.addByte(rand() & 0xFF);
+        packet.addByte(i % 16);
+        packet.marshal(buffer);
+    }
+
+    ChannelColumns columns;
+    columns.values.push_back(0);
+    columns.statuses.push_back(0);
+    columns.channels.push_back(0);
+    columns.devices.push_back(0);
+    BatchDecoder::decode(&buffer[0], &offsets[0], &channels[0], count, columns);
+    BOOST_REQUIRE_EQUAL(count + 1, columns.size());
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        PacketView response(&buffer[offsets[i]], BatchDecoder::RESPONSE_SIZE);
+        DriverClass5_20::CHANNEL_ID channel = static_cast<DriverClass5_20::CHANNEL_ID>(channels[i]);
+        float expected;
+        Sample::STATUS status = DriverClass5_20::decodeChannel(channel, response, expected);
+
+        BOOST_REQUIRE_EQUAL(status, columns.statuses[i + 1]);
+        BOOST_REQUIRE_EQUAL(channels[i], columns.channels[i + 1]);
+        BOOST_REQUIRE_EQUAL(i % 256, columns.devices[i + 1]);
+        if (base::isUnknown(expected))
+            BOOST_REQUIRE(base::isUnknown(columns.values[i + 1]));
+        else
+            BOOST_REQUIRE_EQUAL(expected, columns.values[i + 1]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BatchDecoder_classifies_statuses)
+{
+    struct Case
+    {
+        byte status;
+        int channel;
+        Sample::STATUS expected;
+    };
+    // Powering up (0x8) wins over saturation (0x7), which wins over the
+    // channel error bits
+    Case const cases[] = {
+        { 0x00, 0, Sample::STATUS_OK },
+        { 0x00, 5, Sample::STATUS_OK },
+        { 0xF0, 0, Sample::STATUS_OK },
+        { 0x08, 1, Sample::STATUS_POWERING_UP },
+        { 0x0F, 1, Sample::STATUS_POWERING_UP },
+        { 0xF8, 4, Sample::STATUS_POWERING_UP },
+        { 0x01, 0, Sample::STATUS_SATURATED },
+        { 0x02, 1, Sample::STATUS_SATURATED },
+        { 0x04, 4, Sample::STATUS_SATURATED },
+        { 0x07, 5, Sample::STATUS_SATURATED },
+        { 0x10, 1, Sample::STATUS_OK }
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+        BOOST_CHECK_EQUAL(cases[i].expected, BatchDecoder::classify(cases[i].status, cases[i].channel));
+
+        Packet packet(1, DriverClass5_20::FUNCTION_READ_CHANNEL);
+        for (int b = 0; b < 4; ++b)
+            packet.addByte(0);
+        packet.addByte(cases[i].status);
+        vector<byte> frame;
+        packet.marshal(frame);
+        float value;
+        BOOST_CHECK_EQUAL(cases[i].expected, DriverClass5_20::decodeChannel(
+                    static_cast<DriverClass5_20::CHANNEL_ID>(cases[i].channel),
+                    PacketView(&frame[0], frame.size()), value));
+    }
+}
@@ -0,0 +1,107 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/BusDiscovery.hpp>
+#include <pressure_velki/Simulator.hpp>
+
+using namespace std;
+using namespace pressure_velki;
+
+BOOST_AUTO_TEST_CASE(BusDiscovery_finds_the_devices_on_the_bus)
+{
+    Simulator simulator;
+    simulator.open();
+    simulator.addDevice(3, 1003);
+    simulator.addDevice(7, 1007);
+    simulator.addDevice(12, 1012);
+    simulator.start();
+
+    DriverClass5_20 driver;
+    driver.openURI(simulator.getURI(115200));
+    driver.setReadTimeout(base::Time::fromSeconds(1));
+    driver.setMaxRetries(2);
+
+    BusDiscovery discovery(driver);
+    discovery.setRange(1, 30);
+    BOOST_CHECK(discovery.getProbeTimeout() < base::Time::fromMilliseconds(30));
+
+    base::Time start = base::Time::now();
+    vector<BusDiscovery::Device> devices = discovery.scan();
+    base::Time duration = base::Time::now() - start;
+    simulator.stop();
+
+    BOOST_REQUIRE_EQUAL(3, devices.size());
+    BOOST_CHECK_EQUAL(3, devices[0].address);
+    BOOST_CHECK_EQUAL(1003, devices[0].serialNumber);
+    BOOST_CHECK_EQUAL(7, devices[1].address);
+    BOOST_CHECK_EQUAL(1007, devices[1].serialNumber);
+    BOOST_CHECK_EQUAL(12, devices[2].address);
+    BOOST_CHECK_EQUAL(1012, devices[2].serialNumber);
+    BOOST_CHECK_EQUAL(5, devices[0].info.deviceClass);
+    BOOST_CHECK(driver.getMetadata(7).hasInfo);
+
+    // 27 empty addresses with the 1s read timeout would take 27 seconds
+    BOOST_CHECK(duration < base::Time::fromSeconds(1));
+    BOOST_CHECK_EQUAL(base::Time::fromSeconds(1), driver.getReadTimeout());
+    BOOST_CHECK_EQUAL(2, driver.getMaxRetries());
+}
+
+BOOST_AUTO_TEST_CASE(BusDiscovery_stops_after_the_given_number_of_misses)
+{
+    Simulator simulator;
+    simulator.open();
+    simulator.addDevice(1);
+    simulator.addDevice(2);
+    simulator.addDevice(40);
+    simulator.start();
+
+    DriverClass5_20 driver;
+    driver.openURI(simulator.getURI(115200));
+
+    BusDiscovery discovery(driver);
+    discovery.setMaxConsecutiveMisses(4);
+    vector<BusDiscovery::Device> devices = discovery.scan();
+    simulator.stop();
+
+    BOOST_REQUIRE_EQUAL(2, devices.size());
+    BOOST_CHECK_EQUAL(1, devices[0].address);
+    BOOST_CHECK_EQUAL(2, devices[1].address);
+    BOOST_CHECK_EQUAL(6, discovery.getProbeCount());
+}
+
+BOOST_AUTO_TEST_CASE(BusDiscovery_increases_the_timeout_when_a_response_arrives_late)
+{
+    Simulator simulator;
+    simulator.open();
+    simulator.addDevice(2, 1002);
+    simulator.addDevice(5, 1005);
+    simulator.setLatency(base::Time::fromMilliseconds(40));
+    simulator.start();
+
+    DriverClass5_20 driver;
+    driver.openURI(simulator.getURI(115200));
+
+    BusDiscovery discovery(driver);
+    discovery.setRange(1, 8);
+    vector<BusDiscovery::Device> devices = discovery.scan();
+    simulator.stop();
+
+    BOOST_REQUIRE_EQUAL(2, devices.size());
+    BOOST_CHECK_EQUAL(2, devices[0].address);
+    BOOST_CHECK_EQUAL(1002, devices[0].serialNumber);
+    BOOST_CHECK_EQUAL(5, devices[1].address);
+    BOOST_CHECK_EQUAL(1005, devices[1].serialNumber);
+}
+
+BOOST_AUTO_TEST_CASE(BusDiscovery_reports_port_failures)
+{
+    Simulator simulator;
+    simulator.open();
+    simulator.addDevice(1);
+
+    DriverClass5_20 driver;
+    driver.openURI(simulator.getURI(115200));
+    simulator.close();
+
+    BusDiscovery discovery(driver);
+    discovery.setRange(1, 8);
+    BOOST_CHECK_THROW(discovery.scan(), iodrivers_base::UnixError);
+}
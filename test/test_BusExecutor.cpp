@@ -0,0 +1,248 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/BusExecutor.hpp>
+#include <pressure_velki/Simulator.hpp>
+#include <stdexcept>
+
+using namespace std;
+using namespace pressure_velki;
+
+namespace
+{
+    /** The typical sequence: echo, initialize, wait for the device to
+     * power up and then read a few samples
+     */
+    struct ReadSequence : public BusTask
+    {
+        int device;
+        int count;
+        vector<Sample>* samples;
+        vector<int>* completionOrder;
+        DeviceInfo info;
+
+        ReadSequence(int device, int count, vector<Sample>* samples, vector<int>* completionOrder)
+            : device(device)
+            , count(count)
+            , samples(samples)
+            , completionOrder(completionOrder) {}
+
+#include <boost/asio/yield.hpp>
+        void operator()(BusExecutor& executor)
+        {
+            reenter(this)
+            {
+                yield executor.transact(*this, DriverClass5_20::Request::echo(device));
+                BOOST_REQUIRE_EQUAL(DriverClass5_20::ASYNC_OK, status);
+                DriverClass5_20::checkEcho(getResponse());
+
+                yield executor.transact(*this, DriverClass5_20::Request::initialize(device));
+                BOOST_REQUIRE_EQUAL(DriverClass5_20::ASYNC_OK, status);
+                info = DriverClass5_20::parseInitialize(getResponse());
+
+                while (count > 0)
+                {
+                    yield executor.readChannel(*this, DriverClass5_20::CHANNEL_PRESSURE0, device);
+                    if (sample.status == Sample::STATUS_POWERING_UP)
+                    {
+                        yield executor.sleep(*this, base::Time::fromMilliseconds(20));
+                        continue;
+                    }
+                    samples->push_back(sample);
+                    --count;
+                }
+                completionOrder->push_back(device);
+            }
+        }
+#include <boost/asio/unyield.hpp>
+    };
+}
+
+BOOST_AUTO_TEST_CASE(BusExecutor_interleaves_the_tasks_of_several_devices)
+{
+    Simulator simulator;
+    simulator.open();
+    simulator.addDevice(1);
+    simulator.addDevice(2);
+    simulator.setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE0, 1.5);
+    simulator.setChannelValue(2, DriverClass5_20::CHANNEL_PRESSURE0, 2.5);
+    // Device 1 takes 5 sleeps to power up, in which device 2 gets read
+    simulator.setPoweringUpReads(1, 5);
+    simulator.start();
+
+    DriverClass5_20 driver;
+    driver.openURI(simulator.getURI(115200));
+    driver.setReadTimeout(base::Time::fromMilliseconds(100));
+
+    vector<Sample> samples;
+    vector<int> completionOrder;
+    BusExecutor executor(driver);
+    executor.spawn(new ReadSequence(1, 3, &samples, &completionOrder));
+    executor.spawn(new ReadSequence(2, 3, &samples, &completionOrder));
+    BOOST_CHECK_EQUAL(2, executor.getTaskCount());
+
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(2);
+    while (executor.runOnce(base::Time::fromMilliseconds(10)) && base::Time::now() < deadline);
+    simulator.stop();
+
+    BOOST_CHECK_EQUAL(0, executor.getTaskCount());
+    BOOST_REQUIRE_EQUAL(2, completionOrder.size());
+    BOOST_CHECK_EQUAL(2, completionOrder[0]);
+    BOOST_CHECK_EQUAL(1, completionOrder[1]);
+    BOOST_REQUIRE_EQUAL(6, samples.size());
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(Sample::STATUS_OK, samples[i].status);
+        BOOST_CHECK_CLOSE(samples[i].device == 1 ? 1.5 : 2.5, samples[i].value, 1e-3);
+    }
+    BOOST_CHECK_EQUAL(5, driver.getStatistics().poweringUp);
+}
+
+namespace
+{
+    struct ReadMissing : public BusTask
+    {
+        Sample* result;
+        explicit ReadMissing(Sample* result) : result(result) {}
+
+#include <boost/asio/yield.hpp>
+        void operator()(BusExecutor& executor)
+        {
+            reenter(this)
+            {
+                yield executor.readChannel(*this, DriverClass5_20::CHANNEL_PRESSURE0, 3);
+                *result = sample;
+            }
+        }
+#include <boost/asio/unyield.hpp>
+    };
+}
+
+BOOST_AUTO_TEST_CASE(BusExecutor_reports_timeouts_in_the_sample)
+{
+    Simulator simulator;
+    simulator.open();
+    simulator.addDevice(1);
+    simulator.start();
+
+    DriverClass5_20 driver;
+    driver.openURI(simulator.getURI(115200));
+    driver.setReadTimeout(base::Time::fromMilliseconds(50));
+
+    Sample result;
+    BusExecutor executor(driver);
+    executor.spawn(new ReadMissing(&result));
+    executor.run();
+    simulator.stop();
+
+    BOOST_CHECK_EQUAL(Sample::STATUS_TIMEOUT, result.status);
+    BOOST_CHECK_EQUAL(3, result.device);
+}
+
+namespace
+{
+    struct ReadTimed : public BusTask
+    {
+        vector<Sample>* samples;
+        vector<base::Time>* resumeTimes;
+        ReadTimed(vector<Sample>* samples, vector<base::Time>* resumeTimes)
+            : samples(samples)
+            , resumeTimes(resumeTimes) {}
+
+#include <boost/asio/yield.hpp>
+        void operator()(BusExecutor& executor)
+        {
+            reenter(this)
+            {
+                while (samples->size() < 3)
+                {
+                    yield executor.readChannel(*this, DriverClass5_20::CHANNEL_PRESSURE0, 1);
+                    samples->push_back(sample);
+                    resumeTimes->push_back(base::Time::now());
+                }
+            }
+        }
+#include <boost/asio/unyield.hpp>
+    };
+}
+
+BOOST_AUTO_TEST_CASE(BusExecutor_timestamps_the_samples_as_the_driver_does)
+{
+    Simulator simulator;
+    simulator.open();
+    simulator.addDevice(1);
+    simulator.setInitialized(1, true);
+    simulator.setLatency(base::Time::fromMilliseconds(10));
+    simulator.start();
+
+    DriverClass5_20 driver;
+    driver.openURI(simulator.getURI(115200));
+    driver.setReadTimeout(base::Time::fromMilliseconds(100));
+
+    vector<Sample> samples;
+    vector<base::Time> resumeTimes;
+    BusExecutor executor(driver);
+    base::Time before = base::Time::now();
+    executor.spawn(new ReadTimed(&samples, &resumeTimes));
+    executor.run();
+    simulator.stop();
+
+    BOOST_REQUIRE_EQUAL(3, samples.size());
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(Sample::STATUS_OK, samples[i].status);
+        // The device took the sample somewhere between the request and the
+        // response, and not when the task got resumed
+        BOOST_CHECK(samples[i].timeUncertainty > base::Time());
+        BOOST_CHECK(samples[i].time - samples[i].timeUncertainty >= before);
+        BOOST_CHECK(samples[i].time + base::Time::fromMilliseconds(2) < resumeTimes[i]);
+    }
+}
+
+namespace
+{
+    struct FailAfterYield : public BusTask
+    {
+#include <boost/asio/yield.hpp>
+        void operator()(BusExecutor& executor)
+        {
+            reenter(this)
+            {
+                yield;
+                throw std::runtime_error("task failed");
+            }
+        }
+#include <boost/asio/unyield.hpp>
+    };
+}
+
+BOOST_AUTO_TEST_CASE(BusExecutor_deletes_a_task_that_throws_and_keeps_running_the_others)
+{
+    Simulator simulator;
+    simulator.open();
+    simulator.addDevice(1);
+    simulator.setInitialized(1, true);
+    simulator.start();
+
+    DriverClass5_20 driver;
+    driver.openURI(simulator.getURI(115200));
+    driver.setReadTimeout(base::Time::fromMilliseconds(100));
+
+    vector<Sample> samples;
+    vector<base::Time> resumeTimes;
+    BusExecutor executor(driver);
+    executor.spawn(new FailAfterYield);
+    executor.runOnce(base::Time());
+    // Both tasks are ready at the next call, the read one after the one
+    // that throws
+    executor.spawn(new ReadTimed(&samples, &resumeTimes));
+    BOOST_CHECK_THROW(executor.runOnce(base::Time()), std::runtime_error);
+    BOOST_CHECK_EQUAL(1, executor.getTaskCount());
+
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(2);
+    while (executor.runOnce(base::Time::fromMilliseconds(10)) && base::Time::now() < deadline);
+    simulator.stop();
+
+    BOOST_CHECK_EQUAL(0, executor.getTaskCount());
+    BOOST_REQUIRE_EQUAL(3, samples.size());
+    for (size_t i = 0; i < samples.size(); ++i)
+        BOOST_CHECK_EQUAL(Sample::STATUS_OK, samples[i].status);
+}
@@ -0,0 +1,192 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/BusScheduler.hpp>
+#include <pressure_velki/Simulator.hpp>
+#include <algorithm>
+
+using namespace std;
+using namespace pressure_velki;
+
+struct BusSchedulerFixture
+{
+    Simulator simulator;
+    BusScheduler scheduler;
+    BusScheduler::Channels channels;
+
+    BusSchedulerFixture()
+    {
+        simulator.open();
+        for (int address = 1; address <= 3; ++address)
+        {
+            simulator.addDevice(address);
+            simulator.setInitialized(address, true);
+        }
+        simulator.start();
+        scheduler.getDriver().openURI(simulator.getURI(115200));
+        scheduler.getDriver().setReadTimeout(base::Time::fromMilliseconds(20));
+        channels.push_back(DriverClass5_20::CHANNEL_PRESSURE0);
+    }
+
+    ~BusSchedulerFixture()
+    {
+        simulator.stop();
+    }
+
+    /** Polls until the given time has elapsed */
+    vector<BusScheduler::PollResult> pollFor(base::Time const& duration)
+    {
+        vector<BusScheduler::PollResult> results;
+        base::Time end = base::Time::now() + duration;
+        while (base::Time::now() < end)
+            results.push_back(scheduler.poll());
+        return results;
+    }
+
+    /** Returns the polls of a given device */
+    static vector<BusScheduler::PollResult> pollsOf(int device, vector<BusScheduler::PollResult> const& results)
+    {
+        vector<BusScheduler::PollResult> polls;
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            if (results[i].device == device)
+                polls.push_back(results[i]);
+        }
+        return polls;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(BusScheduler_with_simulator, BusSchedulerFixture)
+
+BOOST_AUTO_TEST_CASE(it_refuses_to_poll_without_devices)
+{
+    BOOST_CHECK_THROW(scheduler.poll(), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(it_polls_the_device_with_the_earliest_deadline_first)
+{
+    scheduler.addDevice(1, channels, 50);
+    scheduler.addDevice(2, channels, 20);
+    scheduler.addDevice(3, channels, 0);
+
+    vector<BusScheduler::PollResult> results = pollFor(base::Time::fromSeconds(1));
+    vector<BusScheduler::PollResult> fast = pollsOf(1, results);
+    vector<BusScheduler::PollResult> slow = pollsOf(2, results);
+    vector<BusScheduler::PollResult> free_running = pollsOf(3, results);
+
+    // The rate-limited devices get their rate, whatever the free-running
+    // device asks for. A late poll moves the next deadlines, which loses a
+    // few polls on a loaded machine
+    BOOST_CHECK(fast.size() >= 45 && fast.size() <= 51);
+    BOOST_CHECK(slow.size() >= 18 && slow.size() <= 21);
+    BOOST_CHECK(free_running.size() > fast.size());
+    // No poll comes before its deadline, not even the one after a late poll
+    for (size_t i = 1; i < slow.size(); ++i)
+        BOOST_CHECK(slow[i].time + base::Time::fromMilliseconds(5) >= slow[0].time + base::Time::fromMilliseconds(50 * i));
+
+    // Both rate-limited devices are due on the first poll, the one that got
+    // added first has the earliest deadline
+    BOOST_CHECK_EQUAL(1, results[0].device);
+    BOOST_CHECK_EQUAL(2, results[1].device);
+
+    vector<BusScheduler::DeviceStatistics> stats = scheduler.getStatistics();
+    BOOST_REQUIRE_EQUAL(3, stats.size());
+    BOOST_CHECK_EQUAL(50, stats[0].requestedRate);
+    BOOST_CHECK_EQUAL(static_cast<int>(fast.size()), stats[0].successes);
+    BOOST_CHECK_EQUAL(0, stats[2].timeouts);
+}
+
+BOOST_AUTO_TEST_CASE(it_shares_the_bus_between_free_running_devices_according_to_their_weights)
+{
+    scheduler.addDevice(1, channels, 0, 3);
+    scheduler.addDevice(2, channels, 0, 1);
+
+    vector<int> order;
+    for (int i = 0; i < 40; ++i)
+    {
+        BusScheduler::PollResult result = scheduler.poll();
+        BOOST_REQUIRE_EQUAL(BusScheduler::POLL_OK, result.status);
+        BOOST_REQUIRE_EQUAL(1, result.values.size());
+        order.push_back(result.device);
+    }
+
+    BOOST_CHECK_EQUAL(30, count(order.begin(), order.end(), 1));
+    BOOST_CHECK_EQUAL(10, count(order.begin(), order.end(), 2));
+    // Smooth round-robin interleaves the devices instead of polling the
+    // first one three times in a row
+    int const expected[] = { 1, 1, 2, 1 };
+    for (int i = 0; i < 40; ++i)
+        BOOST_CHECK_EQUAL(expected[i % 4], order[i]);
+}
+
+BOOST_AUTO_TEST_CASE(it_backs_off_exponentially_from_devices_that_time_out)
+{
+    scheduler.setBackoff(base::Time::fromMilliseconds(50), base::Time::fromMilliseconds(200));
+    scheduler.addDevice(1, channels, 0);
+    scheduler.addDevice(9, channels, 0);
+
+    vector<BusScheduler::PollResult> results = pollFor(base::Time::fromMilliseconds(1200));
+    vector<BusScheduler::PollResult> absent = pollsOf(9, results);
+    BOOST_REQUIRE(absent.size() >= 5);
+
+    base::Time timeout = scheduler.getDriver().getReadTimeout();
+    base::Time backoff = base::Time::fromMilliseconds(50);
+    for (size_t i = 0; i < absent.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(BusScheduler::POLL_TIMEOUT, absent[i].status);
+        BOOST_CHECK(absent[i].values.empty());
+        if (i == 0)
+            continue;
+
+        // Each poll waits for the back-off and then for the read timeout. The
+        // slack is below the 200ms an uncapped back-off would add
+        base::Time interval = absent[i].time - absent[i - 1].time;
+        BOOST_CHECK(interval >= backoff + timeout);
+        BOOST_CHECK(interval < backoff + timeout + base::Time::fromMilliseconds(150));
+        backoff = std::min(backoff * 2, base::Time::fromMilliseconds(200));
+    }
+
+    // The other device uses the bus while the absent one is backed off
+    vector<BusScheduler::DeviceStatistics> stats = scheduler.getStatistics();
+    BOOST_CHECK(stats[0].successes > 10 * stats[1].timeouts);
+    BOOST_CHECK_EQUAL(static_cast<int>(absent.size()), stats[1].timeouts);
+    BOOST_CHECK(!stats[1].backoffUntil.isNull());
+}
+
+BOOST_AUTO_TEST_CASE(it_resets_the_backoff_once_the_device_responds)
+{
+    scheduler.setBackoff(base::Time::fromMilliseconds(20), base::Time::fromSeconds(1));
+    scheduler.addDevice(1, channels, 0);
+    scheduler.addDevice(2, channels, 0);
+    simulator.setPoweringUpReads(2, 3);
+
+    vector<BusScheduler::PollResult> polls;
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(2);
+    while (polls.size() < 6 && base::Time::now() < deadline)
+    {
+        BusScheduler::PollResult result = scheduler.poll();
+        if (result.device == 2)
+            polls.push_back(result);
+    }
+    BOOST_REQUIRE_EQUAL(6, polls.size());
+
+    for (int i = 0; i < 3; ++i)
+        BOOST_CHECK_EQUAL(BusScheduler::POLL_POWERING_UP, polls[i].status);
+    BOOST_CHECK(polls[1].time - polls[0].time >= base::Time::fromMilliseconds(20));
+    BOOST_CHECK(polls[2].time - polls[1].time >= base::Time::fromMilliseconds(40));
+    BOOST_CHECK(polls[3].time - polls[2].time >= base::Time::fromMilliseconds(80));
+
+    // Once it responded, the device is back in the round-robin
+    for (size_t i = 3; i < polls.size(); ++i)
+        BOOST_CHECK_EQUAL(BusScheduler::POLL_OK, polls[i].status);
+    BOOST_CHECK(polls[5].time - polls[4].time < base::Time::fromMilliseconds(50));
+
+    vector<BusScheduler::DeviceStatistics> stats = scheduler.getStatistics();
+    BOOST_CHECK_EQUAL(3, stats[1].poweringUp);
+    BOOST_CHECK(stats[1].backoffUntil.isNull());
+
+    scheduler.resetStatistics();
+    stats = scheduler.getStatistics();
+    BOOST_CHECK_EQUAL(0, stats[1].poweringUp);
+    BOOST_CHECK_EQUAL(0, stats[1].successes);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
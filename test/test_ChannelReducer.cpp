@@ -0,0 +1,88 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/ChannelReducer.hpp>
+#include <base/Float.hpp>
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace std;
+using namespace pressure_velki;
+
+BOOST_AUTO_TEST_CASE(ChannelReducer_matches_a_direct_computation_over_the_window)
+{
+    const int window = 7;
+    ChannelReducer reducer(window, 0.5);
+    vector<float> values;
+    srand(0);
+    for (int i = 0; i < 200; ++i)
+    {
+        float value = (i % 11 == 3) ? base::unknown<float>() : (rand() % 1000) / 10.0;
+        values.push_back(value);
+        reducer.push(value);
+
+        vector<float> valid;
+        for (int k = max(0, i - window + 1); k <= i; ++k)
+            if (!base::isUnknown(values[k]))
+                valid.push_back(values[k]);
+
+        BOOST_REQUIRE_EQUAL(static_cast<int>(valid.size()), reducer.getValidCount());
+        BOOST_REQUIRE_EQUAL(min(i + 1, window), reducer.getWindowCount());
+        double sum = 0;
+        for (size_t k = 0; k < valid.size(); ++k)
+            sum += valid[k];
+        double mean = sum / valid.size();
+        double variance = 0;
+        for (size_t k = 0; k < valid.size(); ++k)
+            variance += (valid[k] - mean) * (valid[k] - mean);
+        variance /= valid.size();
+
+        BOOST_REQUIRE_CLOSE(mean, reducer.getMean(), 1e-3);
+        BOOST_REQUIRE_SMALL(variance - reducer.getVariance(), 1e-2);
+        BOOST_REQUIRE_EQUAL(*min_element(valid.begin(), valid.end()), reducer.getMin());
+        BOOST_REQUIRE_EQUAL(*max_element(valid.begin(), valid.end()), reducer.getMax());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ChannelReducer_reports_NaN_without_valid_values)
+{
+    ChannelReducer reducer(2, 0.5);
+    reducer.push(1);
+    reducer.push(base::unknown<float>());
+    reducer.push(base::unknown<float>());
+    BOOST_CHECK_EQUAL(0, reducer.getValidCount());
+    BOOST_CHECK(base::isUnknown(reducer.getMean()));
+    BOOST_CHECK(base::isUnknown(reducer.getMin()));
+    // The moving average keeps the last valid values
+    BOOST_CHECK_EQUAL(1, reducer.getSmoothed());
+}
+
+BOOST_AUTO_TEST_CASE(SampleReducer_decimates_each_channel)
+{
+    SampleReducer reducer(10, 0.1, base::Time::fromMilliseconds(100));
+    vector<Sample> samples;
+    base::Time start = base::Time::fromSeconds(1000);
+    for (int i = 0; i < 100; ++i)
+    {
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            Sample sample;
+            sample.time = start + base::Time::fromMilliseconds(10 * i);
+            sample.device = 1;
+            sample.channel = channel;
+            sample.value = i;
+            if (channel == 1 && i % 2)
+                sample.status = Sample::STATUS_SATURATED;
+            samples.push_back(sample);
+        }
+    }
+
+    vector<ReducedSample> outputs;
+    BOOST_REQUIRE_EQUAL(20, reducer.push(samples, outputs));
+    // The first output is the first sample, then one every 10 samples
+    ReducedSample const& output = outputs[3];
+    BOOST_CHECK_EQUAL(1, output.channel);
+    BOOST_CHECK_EQUAL(10, output.windowCount);
+    BOOST_CHECK_EQUAL(5, output.validCount);
+    BOOST_CHECK_EQUAL(5, output.invalidCount);
+    BOOST_CHECK_EQUAL(2, output.min);
+    BOOST_CHECK_EQUAL(10, output.max);
+}
@@ -0,0 +1,69 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/Crc16.hpp>
+#include <vector>
+#include <stdlib.h>
+
+using namespace std;
+using namespace pressure_velki;
+
+static const Crc16::ENGINE ALL_ENGINES[] = {
+    Crc16::ENGINE_BITWISE,
+    Crc16::ENGINE_TABLE,
+    Crc16::ENGINE_SLICE_BY_4,
+    Crc16::ENGINE_SLICE_BY_8
+};
+
+BOOST_AUTO_TEST_CASE(Crc16_matches_the_velki_reference_value)
+{
+    // Velki provides expected CRC values for the initialize packet (address
+    // 250, function 48)
+    boost::uint8_t const initialize[] = { 250, 48 };
+    for (int i = 0; i < 4; ++i)
+        BOOST_CHECK_EQUAL(0x0443, Crc16::compute(ALL_ENGINES[i], initialize, initialize + 2));
+}
+
+BOOST_AUTO_TEST_CASE(Crc16_engines_agree_on_all_lengths_and_alignments)
+{
+    vector<boost::uint8_t> buffer(256);
+    srand(42);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = rand() & 0xFF;
+
+    for (int offset = 0; offset < 8; ++offset)
+    {
+        for (int length = 0; length < 200; ++length)
+        {
+            boost::uint8_t const* begin = &buffer[offset];
+            boost::uint16_t expected = Crc16::compute(Crc16::ENGINE_BITWISE, begin, begin + length);
+            for (int i = 1; i < 4; ++i)
+                BOOST_REQUIRE_EQUAL(expected, Crc16::compute(ALL_ENGINES[i], begin, begin + length));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Crc16_update_can_split_a_computation)
+{
+    boost::uint8_t buffer[20];
+    for (int i = 0; i < 20; ++i)
+        buffer[i] = i * 13;
+
+    boost::uint16_t expected = Crc16::compute(buffer, buffer + 20);
+    for (int split = 0; split <= 20; ++split)
+    {
+        boost::uint16_t crc = Crc16::update(Crc16::INITIAL_VALUE, buffer, buffer + split);
+        BOOST_REQUIRE_EQUAL(expected, Crc16::update(crc, buffer + split, buffer + 20));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Crc16_default_engine_can_be_changed)
+{
+    Crc16::ENGINE previous = Crc16::getDefaultEngine();
+    boost::uint8_t const initialize[] = { 250, 48 };
+    for (int i = 0; i < 4; ++i)
+    {
+        Crc16::setDefaultEngine(ALL_ENGINES[i]);
+        BOOST_CHECK_EQUAL(ALL_ENGINES[i], Crc16::getDefaultEngine());
+        BOOST_CHECK_EQUAL(0x0443, Crc16::compute(initialize, initialize + 2));
+    }
+    Crc16::setDefaultEngine(previous);
+}
@@ -0,0 +1,493 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+#include <pressure_velki/Simulator.hpp>
+#include <base/Float.hpp>
+#include <boost/bind.hpp>
+#include <sys/select.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace pressure_velki;
+
+struct SimulatorFixture
+{
+    Simulator simulator;
+    DriverClass5_20 driver;
+
+    SimulatorFixture()
+    {
+        simulator.open();
+        simulator.addDevice(1, 0x01020304);
+        simulator.addDevice(2, 42);
+        simulator.setInitialized(1, true);
+        simulator.start();
+        driver.openURI(simulator.getURI(115200));
+        driver.setReadTimeout(base::Time::fromMilliseconds(100));
+    }
+
+    ~SimulatorFixture()
+    {
+        simulator.stop();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(DriverClass5_20_with_simulator, SimulatorFixture)
+
+BOOST_AUTO_TEST_CASE(it_initializes_a_device)
+{
+    DeviceInfo info = driver.initialize(2);
+    BOOST_CHECK_EQUAL(5, info.deviceClass);
+    BOOST_CHECK_EQUAL(20, info.deviceGroup);
+    BOOST_CHECK(simulator.getDeviceState(2).initialized);
+}
+
+BOOST_AUTO_TEST_CASE(it_reads_the_serial_number)
+{
+    BOOST_CHECK_EQUAL(0x01020304, driver.getSerialNumber(1));
+}
+
+BOOST_AUTO_TEST_CASE(it_uses_the_first_device_for_point_to_point)
+{
+    BOOST_CHECK_EQUAL(0x01020304, driver.getSerialNumber());
+}
+
+BOOST_AUTO_TEST_CASE(it_performs_an_echo)
+{
+    driver.echo(2);
+}
+
+BOOST_AUTO_TEST_CASE(it_reads_whether_the_device_is_absolute)
+{
+    simulator.setAbsolute(1, false);
+    BOOST_CHECK(!driver.isAbsolute(1));
+    simulator.setAbsolute(1, true);
+    driver.invalidateMetadata(1);
+    BOOST_CHECK(driver.isAbsolute(1));
+}
+
+BOOST_AUTO_TEST_CASE(it_caches_the_device_metadata)
+{
+    BOOST_CHECK(!driver.getMetadata(1).hasInfo);
+    driver.initialize(1);
+    driver.getSerialNumber(1);
+    driver.isAbsolute(1);
+    int requests = simulator.getRequestCount();
+    BOOST_CHECK_EQUAL(0x01020304, driver.getSerialNumber(1));
+    BOOST_CHECK(driver.isAbsolute(1));
+    BOOST_CHECK_EQUAL(requests, simulator.getRequestCount());
+
+    DeviceMetadata metadata = driver.getMetadata(1);
+    BOOST_CHECK(metadata.hasInfo);
+    BOOST_CHECK(metadata.hasSerialNumber);
+    BOOST_CHECK(metadata.hasAbsolute);
+
+    // Re-initialization clears the cache
+    driver.isAbsolute(1);
+    driver.initialize(1);
+    BOOST_CHECK(!driver.getMetadata(1).hasAbsolute);
+    BOOST_CHECK(driver.getMetadata(1).hasInfo);
+}
+
+BOOST_AUTO_TEST_CASE(it_clears_the_metadata_when_the_device_is_not_initialized)
+{
+    driver.getSerialNumber(1);
+    simulator.setInitialized(1, false);
+    BOOST_CHECK_THROW(driver.readPressure(0, 1), Error);
+    BOOST_CHECK(!driver.getMetadata(1).hasSerialNumber);
+}
+
+BOOST_AUTO_TEST_CASE(it_clears_the_metadata_on_serial_number_mismatch)
+{
+    driver.isAbsolute(1);
+    BOOST_CHECK(driver.verifySerialNumber(1));
+    BOOST_CHECK(driver.getMetadata(1).hasAbsolute);
+
+    simulator.addDevice(1, 43);
+    simulator.setInitialized(1, true);
+    BOOST_CHECK(!driver.verifySerialNumber(1));
+    BOOST_CHECK(!driver.getMetadata(1).hasAbsolute);
+    BOOST_CHECK_EQUAL(43, driver.getMetadata(1).serialNumber);
+}
+
+BOOST_AUTO_TEST_CASE(it_reads_pressures_and_temperatures)
+{
+    simulator.setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE1, 1.5);
+    simulator.setChannelValue(1, DriverClass5_20::CHANNEL_TEMPERATURE_OF_PRESSURE1, 21.5);
+    BOOST_CHECK_CLOSE(1.5, driver.readPressure(1, 1).toBar(), 1e-3);
+    BOOST_CHECK_CLOSE(21.5, driver.readTemperatureOfPressureSensor(1, 1), 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(it_reads_several_channels_at_once)
+{
+    for (int i = 0; i < 6; ++i)
+        simulator.setChannelValue(1, i, i * 10);
+
+    vector<DriverClass5_20::CHANNEL_ID> channels;
+    channels.push_back(DriverClass5_20::CHANNEL_TEMPERATURE);
+    channels.push_back(DriverClass5_20::CHANNEL_PRESSURE0);
+    channels.push_back(DriverClass5_20::CHANNEL_CALCULATED);
+    vector<float> values = driver.readChannels(channels, 1);
+    BOOST_REQUIRE_EQUAL(3, values.size());
+    BOOST_CHECK_EQUAL(30, values[0]);
+    BOOST_CHECK_EQUAL(10, values[1]);
+    BOOST_CHECK_EQUAL(0, values[2]);
+}
+
+BOOST_AUTO_TEST_CASE(it_throws_PoweringUp_while_the_device_powers_up)
+{
+    simulator.setPoweringUpReads(1, 1);
+    BOOST_CHECK_THROW(driver.readPressure(0, 1), PoweringUp);
+    driver.readPressure(0, 1);
+}
+
+BOOST_AUTO_TEST_CASE(it_returns_NaN_on_saturation)
+{
+    simulator.setSaturation(1, 1);
+    BOOST_CHECK(base::isUnknown(driver.readPressure(0, 1).toBar()));
+}
+
+BOOST_AUTO_TEST_CASE(it_throws_DeviceNotInitialized_errors)
+{
+    try
+    {
+        driver.readPressure(0, 2);
+        BOOST_FAIL("expected an exception");
+    }
+    catch(Error const& e)
+    {
+        BOOST_CHECK_EQUAL(2, e.device);
+        BOOST_CHECK_EQUAL(Error::ERROR_DEVICE_NOT_INITIALIZED, e.error);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(it_keeps_the_stream_in_sync_after_an_error_in_readChannels)
+{
+    simulator.injectError(1, Error::ERROR_BAD_DATA);
+    vector<DriverClass5_20::CHANNEL_ID> channels(3, DriverClass5_20::CHANNEL_PRESSURE0);
+    BOOST_CHECK_THROW(driver.readChannels(channels, 1), Error);
+    simulator.setChannelValue(1, 0, 12);
+    BOOST_CHECK_EQUAL(12, driver.readChannels(vector<DriverClass5_20::CHANNEL_ID>(1), 1)[0]);
+}
+
+BOOST_AUTO_TEST_CASE(it_times_out_on_missing_devices)
+{
+    BOOST_CHECK_THROW(driver.echo(3), iodrivers_base::TimeoutError);
+}
+
+BOOST_AUTO_TEST_CASE(it_recovers_from_noise)
+{
+    simulator.setNoise(1, 8);
+    simulator.setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE0, 2);
+    for (int i = 0; i < 20; ++i)
+        BOOST_REQUIRE_CLOSE(2, driver.readPressure(0, 1).toBar(), 1e-3);
+}
+
+static void storeAsyncResult(vector<DriverClass5_20::ASYNC_STATUS>* results,
+        DriverClass5_20::ASYNC_STATUS status, PacketView const&)
+{
+    results->push_back(status);
+}
+
+BOOST_AUTO_TEST_CASE(it_processes_requests_asynchronously)
+{
+    vector<DriverClass5_20::ASYNC_STATUS> results;
+    driver.submit(DriverClass5_20::Request::echo(1), boost::bind(storeAsyncResult, &results, _1, _2));
+    driver.submit(DriverClass5_20::Request::echo(3), boost::bind(storeAsyncResult, &results, _1, _2));
+    driver.submit(DriverClass5_20::Request::readChannel(DriverClass5_20::CHANNEL_PRESSURE0, 2),
+            boost::bind(storeAsyncResult, &results, _1, _2));
+
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(2);
+    while (driver.hasPendingRequests() && base::Time::now() < deadline)
+    {
+        usleep(100);
+        driver.processAsync();
+    }
+
+    BOOST_REQUIRE_EQUAL(3, results.size());
+    BOOST_CHECK_EQUAL(DriverClass5_20::ASYNC_OK, results[0]);
+    BOOST_CHECK_EQUAL(DriverClass5_20::ASYNC_TIMEOUT, results[1]);
+    BOOST_CHECK_EQUAL(DriverClass5_20::ASYNC_DEVICE_ERROR, results[2]);
+}
+
+/** Submits an echo to device 2 and processes it before returning */
+static void submitAndWait(DriverClass5_20* driver, vector<DriverClass5_20::ASYNC_STATUS>* results,
+        DriverClass5_20::ASYNC_STATUS status, PacketView const&)
+{
+    results->push_back(status);
+    driver->submit(DriverClass5_20::Request::echo(2), boost::bind(storeAsyncResult, results, _1, _2));
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(1);
+    while (driver->hasPendingRequests() && base::Time::now() < deadline)
+    {
+        usleep(100);
+        driver->processAsync();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(it_allows_callbacks_to_process_new_requests)
+{
+    vector<DriverClass5_20::ASYNC_STATUS> results;
+    driver.submit(DriverClass5_20::Request::echo(1), boost::bind(submitAndWait, &driver, &results, _1, _2));
+
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(2);
+    while (results.empty() && base::Time::now() < deadline)
+    {
+        usleep(100);
+        driver.processAsync();
+    }
+    BOOST_REQUIRE_EQUAL(2, results.size());
+    BOOST_CHECK_EQUAL(DriverClass5_20::ASYNC_OK, results[0]);
+    BOOST_CHECK_EQUAL(DriverClass5_20::ASYNC_OK, results[1]);
+    BOOST_CHECK(!driver.hasPendingRequests());
+    BOOST_CHECK_EQUAL(0, driver.getDiscardedBytes());
+}
+
+BOOST_AUTO_TEST_CASE(it_accumulates_statistics)
+{
+    driver.setMaxRetries(1);
+    driver.echo(1);
+    driver.readPressure(0, 1);
+    BOOST_CHECK_THROW(driver.readPressure(0, 2), Error);
+    BOOST_CHECK_THROW(driver.echo(3), iodrivers_base::TimeoutError);
+
+    DriverStatistics stats = driver.getStatistics();
+    BOOST_CHECK_EQUAL(3, stats.responses);
+    // The echo to the missing device is retried once
+    BOOST_CHECK_EQUAL(2, stats.timeouts);
+    BOOST_CHECK_EQUAL(1, stats.retries);
+    BOOST_CHECK_EQUAL(1, stats.errors[Error::ERROR_DEVICE_NOT_INITIALIZED]);
+    BOOST_CHECK_EQUAL(5, stats.writeTime.getCount());
+    BOOST_CHECK_EQUAL(1, stats.roundTripByFunction[DriverClass5_20::FUNCTION_ECHO].getCount());
+    BOOST_CHECK_EQUAL(2, stats.roundTripByFunction[DriverClass5_20::FUNCTION_READ_CHANNEL].getCount());
+    BOOST_CHECK_EQUAL(2, stats.roundTripByDevice[1].getCount());
+    BOOST_CHECK(stats.roundTripByDevice[1].getMin() > base::Time());
+
+    driver.resetStatistics();
+    BOOST_CHECK_EQUAL(0, driver.getStatistics().responses);
+}
+
+BOOST_AUTO_TEST_CASE(it_traces_the_IO)
+{
+    driver.setMaxRetries(1);
+    driver.echo(1);
+    BOOST_CHECK_THROW(driver.echo(3), iodrivers_base::TimeoutError);
+
+    vector<TraceRing::Event> events;
+    driver.getTrace().snapshot(events);
+    BOOST_REQUIRE_EQUAL(7, events.size());
+    BOOST_CHECK_EQUAL(TraceRing::SENT, events[0].type);
+    BOOST_CHECK_EQUAL(TraceRing::RECEIVED, events[1].type);
+    BOOST_CHECK_EQUAL(1, events[1].address);
+    BOOST_CHECK_EQUAL(DriverClass5_20::FUNCTION_ECHO, events[1].function);
+    BOOST_CHECK_EQUAL(TraceRing::SENT, events[2].type);
+    BOOST_CHECK_EQUAL(TraceRing::TIMEOUT, events[3].type);
+    BOOST_CHECK_EQUAL(TraceRing::RETRY, events[4].type);
+    BOOST_CHECK_EQUAL(TraceRing::SENT, events[5].type);
+    BOOST_CHECK_EQUAL(TraceRing::TIMEOUT, events[6].type);
+    BOOST_CHECK_EQUAL(3, events[6].address);
+}
+
+BOOST_AUTO_TEST_CASE(it_timestamps_samples_between_the_request_and_the_response)
+{
+    simulator.setLatency(base::Time::fromMilliseconds(10));
+    base::Time before = base::Time::now();
+    Sample sample = driver.tryReadChannel(DriverClass5_20::CHANNEL_PRESSURE0, 1);
+    base::Time after = base::Time::now();
+
+    BOOST_REQUIRE_EQUAL(Sample::STATUS_OK, sample.status);
+    BOOST_CHECK(sample.time - sample.timeUncertainty >= before);
+    BOOST_CHECK(sample.time + sample.timeUncertainty <= after);
+    BOOST_CHECK(sample.timeUncertainty >= base::Time::fromMilliseconds(4));
+    // The pseudo-terminal does not delay the data as a 115200 bauds line
+    // would, which the driver accounts for
+    BOOST_CHECK(driver.getProcessingDelay(1) >= base::Time::fromMilliseconds(8));
+}
+
+BOOST_AUTO_TEST_CASE(it_does_not_adapt_the_timeouts_nor_retry_by_default)
+{
+    BOOST_CHECK(!driver.isAdaptiveTimeoutEnabled());
+    BOOST_CHECK_EQUAL(0, driver.getMaxRetries());
+    for (int i = 0; i < AdaptiveTimeout::MINIMUM_SAMPLES; ++i)
+        driver.echo(1);
+    BOOST_CHECK_EQUAL(driver.getReadTimeout(), driver.getResponseTimeout(1, DriverClass5_20::FUNCTION_ECHO));
+}
+
+BOOST_AUTO_TEST_CASE(it_timestamps_batched_reads_from_the_end_of_each_request)
+{
+    simulator.setLatency(base::Time::fromMilliseconds(10));
+    vector<DriverClass5_20::CHANNEL_ID> channels(6, DriverClass5_20::CHANNEL_PRESSURE0);
+    vector<Sample> samples;
+    base::Time before = base::Time::now();
+    driver.tryReadChannels(channels, samples, 1);
+    base::Time after = base::Time::now();
+
+    BOOST_REQUIRE_EQUAL(6, samples.size());
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        BOOST_REQUIRE_EQUAL(Sample::STATUS_OK, samples[i].status);
+        // The device handles the requests one after the other
+        BOOST_CHECK(samples[i].time - samples[i].timeUncertainty >=
+                before + base::Time::fromMilliseconds(10 * i));
+        BOOST_CHECK(samples[i].time + samples[i].timeUncertainty <= after);
+        if (i > 0)
+            BOOST_CHECK(samples[i].time > samples[i - 1].time);
+    }
+    // Measuring the first turnaround from the end of the whole batch would
+    // remove the transmission of the five other requests from it
+    BOOST_CHECK(driver.getProcessingDelay(1) >= base::Time::fromMilliseconds(8));
+}
+
+BOOST_AUTO_TEST_CASE(it_adapts_the_response_timeout_to_the_device_and_function)
+{
+    driver.setAdaptiveTimeout(true);
+    BOOST_CHECK_EQUAL(driver.getReadTimeout(), driver.getResponseTimeout(1, DriverClass5_20::FUNCTION_ECHO));
+    for (int i = 0; i < AdaptiveTimeout::MINIMUM_SAMPLES; ++i)
+        driver.echo(1);
+    BOOST_CHECK(driver.getResponseTimeout(1, DriverClass5_20::FUNCTION_ECHO) < base::Time::fromMilliseconds(50));
+    BOOST_CHECK_EQUAL(driver.getReadTimeout(), driver.getResponseTimeout(1, DriverClass5_20::FUNCTION_INITIALIZE));
+    BOOST_CHECK_EQUAL(driver.getReadTimeout(), driver.getResponseTimeout(2, DriverClass5_20::FUNCTION_ECHO));
+
+    driver.setAdaptiveTimeout(false);
+    BOOST_CHECK_EQUAL(driver.getReadTimeout(), driver.getResponseTimeout(1, DriverClass5_20::FUNCTION_ECHO));
+}
+
+BOOST_AUTO_TEST_CASE(it_discards_the_late_duplicate_of_a_retried_request)
+{
+    driver.setReadTimeout(base::Time::fromMilliseconds(50));
+    driver.setMaxRetries(1);
+    // The response to the first echo arrives after the retry got sent, the
+    // response to the retry comes one latency later
+    simulator.setLatency(base::Time::fromMilliseconds(70));
+    driver.echo(1);
+    BOOST_CHECK_EQUAL(1, driver.getStatistics().retries);
+    simulator.setLatency(base::Time());
+
+    usleep(100000);
+    int fd = driver.getFileDescriptor();
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(fd, &set);
+    timeval tv = { 0, 0 };
+    BOOST_CHECK_EQUAL(0, select(fd + 1, &set, 0, 0, &tv));
+}
+
+BOOST_AUTO_TEST_CASE(it_does_not_wait_for_duplicates_when_all_attempts_time_out)
+{
+    driver.setMaxRetries(1);
+    base::Time start = base::Time::now();
+    BOOST_CHECK_THROW(driver.echo(3), iodrivers_base::TimeoutError);
+    // Two attempts of 100ms
+    BOOST_CHECK(base::Time::now() - start < base::Time::fromMilliseconds(250));
+}
+
+BOOST_AUTO_TEST_CASE(it_retries_a_bounded_number_of_times)
+{
+    driver.setAdaptiveTimeout(true);
+    for (int i = 0; i < AdaptiveTimeout::MINIMUM_SAMPLES; ++i)
+        driver.echo(1);
+    driver.setMaxRetries(2);
+    driver.resetStatistics();
+
+    simulator.setLatency(base::Time::fromMilliseconds(300));
+    base::Time start = base::Time::now();
+    BOOST_CHECK_THROW(driver.echo(1), iodrivers_base::TimeoutError);
+    // The first attempt uses the learned timeout, the retries the 100ms
+    // read timeout
+    base::Time duration = base::Time::now() - start;
+    BOOST_CHECK(duration >= base::Time::fromMilliseconds(200));
+    BOOST_CHECK(duration < base::Time::fromMilliseconds(250));
+    BOOST_CHECK_EQUAL(2, driver.getStatistics().retries);
+}
+
+BOOST_AUTO_TEST_CASE(it_follows_a_device_that_slows_down)
+{
+    driver.setReadTimeout(base::Time::fromSeconds(1));
+    driver.setAdaptiveTimeout(true);
+    simulator.setLatency(base::Time::fromMilliseconds(1));
+    vector<DriverClass5_20::CHANNEL_ID> channels(1, DriverClass5_20::CHANNEL_PRESSURE0);
+    for (int i = 0; i < 2 * AdaptiveTimeout::MINIMUM_SAMPLES; ++i)
+        driver.readChannels(channels, 1);
+    BOOST_REQUIRE(driver.getResponseTimeout(1, DriverClass5_20::FUNCTION_READ_CHANNEL) <
+            base::Time::fromMilliseconds(15));
+
+    simulator.setLatency(base::Time::fromMilliseconds(20));
+    driver.resetStatistics();
+    vector<Sample> samples;
+    int timeouts = 0;
+    for (int i = 0; i < 40; ++i)
+    {
+        simulator.setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE0, i);
+        driver.tryReadChannels(channels, samples, 1);
+        if (samples[0].status == Sample::STATUS_TIMEOUT)
+            ++timeouts;
+        else
+        {
+            // Not the late response to the previous request
+            BOOST_REQUIRE_EQUAL(Sample::STATUS_OK, samples[0].status);
+            BOOST_CHECK_EQUAL(i, samples[0].value);
+        }
+    }
+    // The first read after the slow-down times out, and the timeout grows
+    // back from there
+    BOOST_CHECK_EQUAL(1, timeouts);
+    BOOST_CHECK(driver.getResponseTimeout(1, DriverClass5_20::FUNCTION_READ_CHANNEL) >
+            base::Time::fromMilliseconds(20));
+}
+
+BOOST_AUTO_TEST_CASE(it_waits_for_the_read_timeout_on_retries)
+{
+    driver.setReadTimeout(base::Time::fromSeconds(1));
+    driver.setAdaptiveTimeout(true);
+    driver.setMaxRetries(2);
+    simulator.setLatency(base::Time::fromMilliseconds(1));
+    for (int i = 0; i < 2 * AdaptiveTimeout::MINIMUM_SAMPLES; ++i)
+        driver.echo(1);
+
+    simulator.setLatency(base::Time::fromMilliseconds(40));
+    driver.resetStatistics();
+    for (int i = 0; i < 20; ++i)
+        driver.echo(1);
+    DriverStatistics stats = driver.getStatistics();
+    BOOST_CHECK_EQUAL(1, stats.retries);
+    BOOST_CHECK_EQUAL(1, stats.timeouts);
+    BOOST_CHECK(driver.getResponseTimeout(1, DriverClass5_20::FUNCTION_ECHO) >
+            base::Time::fromMilliseconds(40));
+}
+
+BOOST_AUTO_TEST_CASE(it_reports_failures_through_the_status_in_the_try_API)
+{
+    simulator.setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE0, 3);
+    Sample sample = driver.tryReadPressure(0, 1);
+    BOOST_CHECK_EQUAL(Sample::STATUS_OK, sample.status);
+    BOOST_CHECK_CLOSE(3, sample.value, 1e-3);
+
+    simulator.setPoweringUpReads(1, 1);
+    BOOST_CHECK_EQUAL(Sample::STATUS_POWERING_UP, driver.tryReadPressure(0, 1).status);
+
+    sample = driver.tryReadPressure(0, 2);
+    BOOST_CHECK_EQUAL(Sample::STATUS_DEVICE_ERROR, sample.status);
+    BOOST_CHECK_EQUAL(Error::ERROR_DEVICE_NOT_INITIALIZED, sample.error);
+
+    BOOST_CHECK_EQUAL(Sample::STATUS_TIMEOUT, driver.tryReadPressure(0, 3).status);
+    BOOST_CHECK_EQUAL(Sample::STATUS_CHANNEL_ERROR, driver.tryReadPressure(2, 1).status);
+}
+
+BOOST_AUTO_TEST_CASE(tryReadChannels_reads_all_responses_after_an_exception)
+{
+    simulator.setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE0, 4);
+    simulator.injectError(1, Error::ERROR_BAD_DATA);
+    vector<DriverClass5_20::CHANNEL_ID> channels(3, DriverClass5_20::CHANNEL_PRESSURE0);
+    vector<Sample> samples;
+    driver.tryReadChannels(channels, samples, 1);
+    BOOST_REQUIRE_EQUAL(3, samples.size());
+    BOOST_CHECK_EQUAL(Sample::STATUS_DEVICE_ERROR, samples[0].status);
+    BOOST_CHECK_EQUAL(Error::ERROR_BAD_DATA, samples[0].error);
+    BOOST_CHECK_EQUAL(Sample::STATUS_OK, samples[1].status);
+    BOOST_CHECK_CLOSE(4, samples[2].value, 1e-3);
+
+    driver.tryReadChannels(channels, samples, 3);
+    BOOST_REQUIRE_EQUAL(3, samples.size());
+    for (int i = 0; i < 3; ++i)
+        BOOST_CHECK_EQUAL(Sample::STATUS_TIMEOUT, samples[i].status);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,162 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/FrameLog.hpp>
+#include <pressure_velki/FrameReplay.hpp>
+#include <pressure_velki/DriverClass5_20.hpp>
+#include <pressure_velki/Simulator.hpp>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace pressure_velki;
+
+struct TemporaryLog
+{
+    string path;
+    TemporaryLog()
+    {
+        char pattern[] = "/tmp/pressure_velki_test_XXXXXX";
+        int fd = mkstemp(pattern);
+        close(fd);
+        path = pattern;
+    }
+    ~TemporaryLog() { unlink(path.c_str()); }
+};
+
+BOOST_AUTO_TEST_CASE(FrameLog_records_can_be_read_back)
+{
+    TemporaryLog log;
+    vector<boost::uint8_t> big(300);
+    for (size_t i = 0; i < big.size(); ++i)
+        big[i] = i;
+    boost::uint8_t const small[] = { 1, 2, 3 };
+
+    FrameRecorder recorder;
+    recorder.open(log.path);
+    recorder.record(FrameLog::SENT, small, 3);
+    recorder.record(FrameLog::RECEIVED, &big[0], big.size());
+    recorder.close();
+
+    FrameLogReader reader;
+    reader.open(log.path);
+    FrameLog::Record record;
+    BOOST_REQUIRE(reader.next(record));
+    BOOST_CHECK_EQUAL(FrameLog::SENT, record.direction);
+    BOOST_CHECK_EQUAL(vector<boost::uint8_t>(small, small + 3),
+            vector<boost::uint8_t>(record.data, record.data + record.size));
+    boost::uint64_t first_time = record.time;
+
+    // Data larger than 255 bytes gets split
+    BOOST_REQUIRE(reader.next(record));
+    BOOST_CHECK_EQUAL(FrameLog::RECEIVED, record.direction);
+    BOOST_CHECK_EQUAL(255, record.size);
+    BOOST_CHECK(record.time >= first_time);
+    BOOST_REQUIRE(reader.next(record));
+    BOOST_CHECK_EQUAL(45, record.size);
+    BOOST_CHECK_EQUAL(255, record.data[0]);
+    BOOST_CHECK(!reader.next(record));
+}
+
+BOOST_AUTO_TEST_CASE(FrameReplay_feeds_a_recorded_session_back_to_a_driver)
+{
+    TemporaryLog log;
+    vector<DriverClass5_20::CHANNEL_ID> channels;
+    channels.push_back(DriverClass5_20::CHANNEL_PRESSURE0);
+    channels.push_back(DriverClass5_20::CHANNEL_TEMPERATURE);
+
+    vector<float> recorded;
+    {
+        Simulator simulator;
+        simulator.open();
+        simulator.addDevice(1, 1234);
+        simulator.start();
+
+        FrameRecorder recorder;
+        recorder.open(log.path);
+        DriverClass5_20 driver;
+        driver.openURI(simulator.getURI(115200));
+        driver.setRecorder(&recorder);
+        driver.initialize(1);
+        for (int i = 0; i < 10; ++i)
+        {
+            simulator.setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE0, i);
+            simulator.setChannelValue(1, DriverClass5_20::CHANNEL_TEMPERATURE, 20 + i);
+            vector<float> values = driver.readChannels(channels, 1);
+            recorded.insert(recorded.end(), values.begin(), values.end());
+        }
+        simulator.stop();
+    }
+
+    FrameReplay replay;
+    replay.open(log.path);
+    DriverClass5_20 driver;
+    driver.setReadTimeout(base::Time::fromSeconds(1));
+    replay.attach(driver);
+    replay.start();
+
+    BOOST_CHECK_EQUAL(5, driver.initialize(1).deviceClass);
+    vector<float> replayed;
+    for (int i = 0; i < 10; ++i)
+    {
+        vector<float> values = driver.readChannels(channels, 1);
+        replayed.insert(replayed.end(), values.begin(), values.end());
+    }
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(1);
+    while (!replay.isFinished() && base::Time::now() < deadline)
+        usleep(1000);
+    replay.stop();
+
+    BOOST_CHECK(replay.isFinished());
+    BOOST_CHECK_EQUAL(0, replay.getMismatches());
+    BOOST_REQUIRE_EQUAL(recorded.size(), replayed.size());
+    for (size_t i = 0; i < recorded.size(); ++i)
+        BOOST_CHECK_EQUAL(recorded[i], replayed[i]);
+}
+
+BOOST_AUTO_TEST_CASE(FrameReplay_reproduces_the_noise_on_the_line)
+{
+    TemporaryLog log;
+    vector<DriverClass5_20::CHANNEL_ID> channels(1, DriverClass5_20::CHANNEL_PRESSURE0);
+    vector<float> recorded;
+    boost::uint64_t recordedDiscarded;
+    {
+        Simulator simulator;
+        simulator.open();
+        simulator.addDevice(1, 1234);
+        simulator.setNoise(0.5);
+        simulator.start();
+
+        FrameRecorder recorder;
+        recorder.open(log.path);
+        DriverClass5_20 driver;
+        driver.openURI(simulator.getURI(115200));
+        driver.setRecorder(&recorder);
+        driver.initialize(1);
+        for (int i = 0; i < 20; ++i)
+            recorded.push_back(driver.readChannels(channels, 1).at(0));
+        recordedDiscarded = driver.getDiscardedBytes();
+        simulator.stop();
+    }
+    BOOST_REQUIRE(recordedDiscarded > 0);
+
+    FrameReplay replay;
+    replay.open(log.path);
+    DriverClass5_20 driver;
+    driver.setReadTimeout(base::Time::fromSeconds(1));
+    base::Time silence = driver.getMinimumInterFrameSilence();
+    replay.attach(driver);
+    BOOST_CHECK_EQUAL(base::Time(), driver.getMinimumInterFrameSilence());
+    replay.start();
+
+    driver.initialize(1);
+    vector<float> replayed;
+    for (int i = 0; i < 20; ++i)
+        replayed.push_back(driver.readChannels(channels, 1).at(0));
+    BOOST_CHECK_EQUAL(recordedDiscarded, driver.getDiscardedBytes());
+    BOOST_CHECK(recorded == replayed);
+
+    replay.detach();
+    BOOST_CHECK_EQUAL(silence, driver.getMinimumInterFrameSilence());
+    BOOST_CHECK(!driver.isValid());
+    BOOST_CHECK_EQUAL(0, replay.getMismatches());
+}
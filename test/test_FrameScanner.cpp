@@ -0,0 +1,79 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/FrameScanner.hpp>
+#include <pressure_velki/Packet.hpp>
+#include <vector>
+
+using namespace std;
+using namespace pressure_velki;
+
+static vector<byte> makeResponse(int address, int function, int payloadSize)
+{
+    Packet packet(address, function);
+    for (int i = 0; i < payloadSize; ++i)
+        packet.addByte(i);
+    vector<byte> buffer;
+    packet.marshal(buffer);
+    return buffer;
+}
+
+BOOST_AUTO_TEST_CASE(FrameScanner_returns_the_size_of_a_valid_response)
+{
+    FrameScanner scanner;
+    scanner.expect(1, 73, 5);
+    vector<byte> buffer = makeResponse(1, 73, 5);
+    BOOST_CHECK_EQUAL(9, scanner.scan(&buffer[0], buffer.size()));
+    BOOST_CHECK_EQUAL(0, scanner.getDiscardedBytes());
+}
+
+BOOST_AUTO_TEST_CASE(FrameScanner_waits_for_a_complete_candidate)
+{
+    FrameScanner scanner;
+    scanner.expect(1, 73, 5);
+    vector<byte> buffer = makeResponse(1, 73, 5);
+    for (size_t size = 0; size < buffer.size(); ++size)
+        BOOST_REQUIRE_EQUAL(0, scanner.scan(&buffer[0], size));
+}
+
+BOOST_AUTO_TEST_CASE(FrameScanner_skips_directly_to_the_next_candidate)
+{
+    FrameScanner scanner;
+    scanner.expect(1, 73, 5);
+    byte const noise[] = { 7, 1, 12, 1, 8, 3 };
+    vector<byte> buffer(noise, noise + 6);
+    vector<byte> response = makeResponse(1, 73, 5);
+    buffer.insert(buffer.end(), response.begin(), response.end());
+
+    BOOST_CHECK_EQUAL(-6, scanner.scan(&buffer[0], buffer.size()));
+    BOOST_CHECK_EQUAL(6, scanner.getDiscardedBytes());
+    BOOST_CHECK_EQUAL(9, scanner.scan(&buffer[6], buffer.size() - 6));
+}
+
+BOOST_AUTO_TEST_CASE(FrameScanner_keeps_a_trailing_address_byte)
+{
+    FrameScanner scanner;
+    scanner.expect(1, 73, 5);
+    byte const buffer[] = { 7, 8, 1 };
+    BOOST_CHECK_EQUAL(-2, scanner.scan(buffer, 3));
+}
+
+BOOST_AUTO_TEST_CASE(FrameScanner_resynchronizes_after_a_bad_checksum)
+{
+    FrameScanner scanner;
+    scanner.expect(1, 73, 5);
+    vector<byte> buffer = makeResponse(1, 73, 5);
+    buffer[8] ^= 0xFF;
+    vector<byte> response = makeResponse(1, 73, 5);
+    buffer.insert(buffer.end(), response.begin(), response.end());
+
+    BOOST_CHECK_EQUAL(-9, scanner.scan(&buffer[0], buffer.size()));
+    BOOST_CHECK_EQUAL(1, scanner.getCRCFailures());
+    BOOST_CHECK_EQUAL(9, scanner.scan(&buffer[9], buffer.size() - 9));
+}
+
+BOOST_AUTO_TEST_CASE(FrameScanner_recognizes_exception_responses)
+{
+    FrameScanner scanner;
+    scanner.expect(1, 73, 5);
+    vector<byte> buffer = makeResponse(1, 73 | 0x80, 1);
+    BOOST_CHECK_EQUAL(5, scanner.scan(&buffer[0], buffer.size()));
+}
@@ -0,0 +1,65 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/LatencyHistogram.hpp>
+
+using namespace pressure_velki;
+
+BOOST_AUTO_TEST_CASE(LatencyHistogram_is_exact_on_small_values)
+{
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 10; ++i)
+        histogram.record(static_cast<boost::uint64_t>(i));
+
+    BOOST_CHECK_EQUAL(10, histogram.getCount());
+    BOOST_CHECK_EQUAL(1, histogram.getMin().toMicroseconds());
+    BOOST_CHECK_EQUAL(10, histogram.getMax().toMicroseconds());
+    BOOST_CHECK_EQUAL(5, histogram.getPercentile(0.5).toMicroseconds());
+    BOOST_CHECK_EQUAL(9, histogram.getPercentile(0.9).toMicroseconds());
+    BOOST_CHECK_EQUAL(10, histogram.getPercentile(1).toMicroseconds());
+}
+
+BOOST_AUTO_TEST_CASE(LatencyHistogram_bounds_the_relative_error_on_large_values)
+{
+    LatencyHistogram histogram;
+    int inexact = 0;
+    for (boost::uint64_t value = 1000; value < 10000000; value = value * 3 / 2)
+    {
+        histogram.reset();
+        histogram.record(value);
+        // A larger maximum, so that the percentile is the upper bound of the
+        // bucket of value and not value itself
+        histogram.record(value * 4);
+        double reported = histogram.getPercentile(0.5).toMicroseconds();
+        BOOST_REQUIRE(reported >= value);
+        BOOST_REQUIRE(reported <= value * 1.0625);
+        if (reported > value)
+            ++inexact;
+    }
+    BOOST_CHECK(inexact > 0);
+}
+
+BOOST_AUTO_TEST_CASE(LatencyHistogram_reports_the_upper_bound_of_the_bucket)
+{
+    // Between 1024 and 2047, the buckets are 64 microseconds wide
+    LatencyHistogram histogram;
+    for (boost::uint64_t value = 1024; value < 1088; ++value)
+        histogram.record(value);
+    histogram.record(1088);
+    histogram.record(10000);
+
+    BOOST_CHECK_EQUAL(1087, histogram.getPercentile(0).toMicroseconds());
+    BOOST_CHECK_EQUAL(1087, histogram.getPercentile(64.0 / 66).toMicroseconds());
+    BOOST_CHECK_EQUAL(1151, histogram.getPercentile(65.0 / 66).toMicroseconds());
+    BOOST_CHECK_EQUAL(10000, histogram.getPercentile(1).toMicroseconds());
+}
+
+BOOST_AUTO_TEST_CASE(LatencyHistogram_merges_histograms)
+{
+    LatencyHistogram a, b;
+    a.record(base::Time::fromMilliseconds(1));
+    b.record(base::Time::fromMilliseconds(100));
+    a.merge(b);
+    BOOST_CHECK_EQUAL(2, a.getCount());
+    BOOST_CHECK_EQUAL(1000, a.getMin().toMicroseconds());
+    BOOST_CHECK_EQUAL(100000, a.getMax().toMicroseconds());
+    BOOST_CHECK_EQUAL(50500, a.getMean().toMicroseconds());
+}
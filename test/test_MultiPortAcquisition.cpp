@@ -0,0 +1,129 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/MultiPortAcquisition.hpp>
+#include <pressure_velki/Simulator.hpp>
+#include <unistd.h>
+
+using namespace std;
+using namespace pressure_velki;
+
+struct MultiPortFixture
+{
+    Simulator simulators[3];
+    MultiPortAcquisition acquisition;
+
+    MultiPortFixture()
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            simulators[i].open();
+            simulators[i].addDevice(1);
+            simulators[i].setInitialized(1, true);
+            simulators[i].setChannelValue(1, DriverClass5_20::CHANNEL_PRESSURE0, i);
+            simulators[i].start();
+
+            int port = acquisition.addPort();
+            DriverClass5_20& driver = acquisition.getPort(port).getDriver();
+            driver.openURI(simulators[i].getURI(115200));
+            driver.setReadTimeout(base::Time::fromMilliseconds(100));
+            acquisition.addDevice(port, 1, Acquisition::Channels(1, DriverClass5_20::CHANNEL_PRESSURE0));
+        }
+        acquisition.setSnapshotPeriod(base::Time::fromMilliseconds(20));
+    }
+
+    ~MultiPortFixture()
+    {
+        acquisition.stop();
+        for (int i = 0; i < 3; ++i)
+            simulators[i].stop();
+    }
+
+    vector<MultiPortAcquisition::Snapshot> acquire(int count)
+    {
+        vector<MultiPortAcquisition::Snapshot> snapshots;
+        acquisition.start();
+        base::Time deadline = base::Time::now() + base::Time::fromSeconds(2);
+        while (snapshots.size() < static_cast<size_t>(count) && base::Time::now() < deadline)
+        {
+            acquisition.update(snapshots);
+            usleep(1000);
+        }
+        acquisition.stop();
+        return snapshots;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(MultiPortAcquisition_with_simulators, MultiPortFixture)
+
+static void checkSnapshots(vector<MultiPortAcquisition::Snapshot> const& snapshots)
+{
+    BOOST_REQUIRE(snapshots.size() >= 10);
+    for (size_t i = 1; i < snapshots.size(); ++i)
+        BOOST_REQUIRE_EQUAL(20000, (snapshots[i].time - snapshots[i - 1].time).toMicroseconds());
+
+    // Skip the first snapshots, they may be taken before all ports got
+    // their first sample
+    MultiPortAcquisition::Snapshot const& snapshot = snapshots.back();
+    BOOST_REQUIRE_EQUAL(3, snapshot.samples.size());
+    for (int port = 0; port < 3; ++port)
+    {
+        Sample const& sample = snapshot.samples[port];
+        BOOST_CHECK_EQUAL(Sample::STATUS_OK, sample.status);
+        BOOST_CHECK_CLOSE(port, sample.value, 1e-3);
+        BOOST_CHECK(sample.time <= snapshot.time);
+        BOOST_CHECK(sample.time > snapshot.time - base::Time::fromMilliseconds(100));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(it_produces_time_aligned_snapshots_with_one_thread_per_port)
+{
+    checkSnapshots(acquire(10));
+}
+
+BOOST_AUTO_TEST_CASE(it_produces_time_aligned_snapshots_with_a_worker_pool)
+{
+    acquisition.setWorkerCount(2);
+    checkSnapshots(acquire(10));
+}
+
+BOOST_AUTO_TEST_CASE(it_keeps_polling_the_other_ports_when_one_fails)
+{
+    // Port 0 and port 2 share a worker
+    acquisition.setWorkerCount(2);
+    acquisition.start();
+    usleep(20000);
+    simulators[0].stop();
+    simulators[0].close();
+
+    base::Time deadline = base::Time::now() + base::Time::fromSeconds(2);
+    while (!acquisition.getPort(0).hasFailed() && base::Time::now() < deadline)
+        usleep(1000);
+    BOOST_REQUIRE(acquisition.getPort(0).hasFailed());
+    BOOST_CHECK(!acquisition.getPort(0).getFailure().empty());
+
+    vector<MultiPortAcquisition::Snapshot> snapshots;
+    acquisition.update(snapshots);
+    snapshots.clear();
+    deadline = base::Time::now() + base::Time::fromSeconds(2);
+    while (snapshots.size() < 10 && base::Time::now() < deadline)
+    {
+        acquisition.update(snapshots);
+        usleep(1000);
+    }
+    BOOST_REQUIRE(snapshots.size() >= 10);
+    BOOST_CHECK(!acquisition.getPort(1).hasFailed());
+    BOOST_CHECK(!acquisition.getPort(2).hasFailed());
+
+    // The snapshots do not wait for the failed port anymore
+    MultiPortAcquisition::Snapshot const& snapshot = snapshots.back();
+    BOOST_CHECK(snapshot.time > base::Time::now() - base::Time::fromMilliseconds(500));
+    BOOST_REQUIRE_EQUAL(3, snapshot.samples.size());
+    for (int port = 1; port < 3; ++port)
+    {
+        Sample const& sample = snapshot.samples[port];
+        BOOST_CHECK_EQUAL(Sample::STATUS_OK, sample.status);
+        BOOST_CHECK_CLOSE(port, sample.value, 1e-3);
+        BOOST_CHECK(sample.time > snapshot.time - base::Time::fromMilliseconds(100));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,5 +1,7 @@
 #include <boost/test/unit_test.hpp>
 #include <pressure_velki/Packet.hpp>
+#include <pressure_velki/PacketView.hpp>
+#include <pressure_velki/RequestFrames.hpp>
 #include <iodrivers_base/Driver.hpp>
 
 using namespace std;
@@ -126,3 +128,53 @@ BOOST_AUTO_TEST_CASE(Packet_parseFloat)
     }
 
 }
+
+BOOST_AUTO_TEST_CASE(PacketView_gives_access_to_a_marshalled_packet)
+{
+    pressure_velki::Packet packet(23, 32);
+    byte const payload[] = { 42, 24 };
+    packet.addBytes(payload, 2);
+    vector<byte> buffer;
+    packet.marshal(buffer);
+
+    PacketView view(&buffer[0], buffer.size());
+    BOOST_CHECK_EQUAL(23, view.getAddress());
+    BOOST_CHECK_EQUAL(32, view.getFunction());
+    BOOST_CHECK(!view.hasError());
+    BOOST_REQUIRE_EQUAL(2, view.getPayloadSize());
+    BOOST_CHECK_EQUAL(42, view[0]);
+    BOOST_CHECK_EQUAL(24, view[1]);
+}
+
+BOOST_AUTO_TEST_CASE(PacketView_decodes_exception_responses)
+{
+    byte const buffer[] = { 23, 32 | 0x80, Error::ERROR_BAD_DATA, 0, 0 };
+    PacketView view(buffer, 5);
+    BOOST_CHECK_EQUAL(32, view.getFunction());
+    BOOST_CHECK(view.hasError());
+    BOOST_CHECK_EQUAL(Error::ERROR_BAD_DATA, view.getErrorCode());
+}
+
+BOOST_AUTO_TEST_CASE(RequestFrames_match_the_marshalled_packets)
+{
+    for (int address = 0; address < 256; ++address)
+    {
+        for (int channel = 0; channel < RequestFrames::CHANNEL_COUNT; ++channel)
+        {
+            Packet packet(address, 73);
+            packet.addByte(channel);
+            vector<byte> expected;
+            packet.marshal(expected);
+
+            RequestFrames::Frame const& frame = RequestFrames::readChannel(channel, address);
+            BOOST_REQUIRE_EQUAL(expected, vector<byte>(frame.data, frame.data + frame.size));
+        }
+
+        Packet packet(address, 8);
+        packet.addBytes(RequestFrames::ECHO_PAYLOAD, 4);
+        vector<byte> expected;
+        packet.marshal(expected);
+        RequestFrames::Frame const& frame = RequestFrames::echo(address);
+        BOOST_REQUIRE_EQUAL(expected, vector<byte>(frame.data, frame.data + frame.size));
+    }
+}
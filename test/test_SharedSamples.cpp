@@ -0,0 +1,88 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/SharedSamples.hpp>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+using namespace pressure_velki;
+
+static const char* const NAME = "/pressure_velki_test_samples";
+
+static Sample makeSample(int device, int channel, float value)
+{
+    Sample sample;
+    sample.time = base::Time::fromMicroseconds(1000 + device);
+    sample.timeUncertainty = base::Time::fromMicroseconds(10);
+    sample.device = device;
+    sample.channel = channel;
+    sample.value = value;
+    return sample;
+}
+
+BOOST_AUTO_TEST_CASE(SharedSamples_gives_the_latest_sample_of_each_channel)
+{
+    SharedSampleWriter writer;
+    writer.create(NAME, 8);
+    SharedSampleReader reader;
+    reader.open(NAME);
+    BOOST_CHECK_EQUAL(8, reader.getCapacity());
+
+    Sample sample;
+    BOOST_CHECK(!reader.latest(1, 1, sample));
+    writer.publish(makeSample(1, 1, 2.5));
+    writer.publish(makeSample(1, 2, 3.5));
+    writer.publish(makeSample(1, 1, 4.5));
+
+    BOOST_REQUIRE(reader.latest(1, 1, sample));
+    BOOST_CHECK_EQUAL(4.5, sample.value);
+    BOOST_CHECK_EQUAL(base::Time::fromMicroseconds(1001), sample.time);
+    BOOST_CHECK_EQUAL(base::Time::fromMicroseconds(10), sample.timeUncertainty);
+    BOOST_REQUIRE(reader.latest(1, 2, sample));
+    BOOST_CHECK_EQUAL(3.5, sample.value);
+    BOOST_CHECK(!reader.latest(2, 1, sample));
+    BOOST_CHECK(!reader.getLastUpdate().isNull());
+}
+
+BOOST_AUTO_TEST_CASE(SharedSamples_gives_access_to_the_sample_history)
+{
+    SharedSampleWriter writer;
+    writer.create(NAME, 4);
+    SharedSampleReader reader;
+    reader.open(NAME);
+
+    Sample sample;
+    BOOST_CHECK_EQUAL(SharedSamples::READ_NOT_YET, reader.read(0, sample));
+    for (int i = 0; i < 6; ++i)
+        writer.publish(makeSample(1, 0, i));
+    BOOST_CHECK_EQUAL(6, reader.getPublishedCount());
+    BOOST_CHECK_EQUAL(SharedSamples::READ_OVERWRITTEN, reader.read(1, sample));
+    BOOST_REQUIRE_EQUAL(SharedSamples::READ_OK, reader.read(2, sample));
+    BOOST_CHECK_EQUAL(2, sample.value);
+
+    boost::uint64_t next = 0;
+    vector<Sample> samples;
+    BOOST_CHECK_EQUAL(2, reader.readSince(next, samples));
+    BOOST_CHECK_EQUAL(6, next);
+    BOOST_REQUIRE_EQUAL(4, samples.size());
+    BOOST_CHECK_EQUAL(5, samples[3].value);
+
+    writer.publish(makeSample(1, 0, 6));
+    samples.clear();
+    BOOST_CHECK_EQUAL(0, reader.readSince(next, samples));
+    BOOST_REQUIRE_EQUAL(1, samples.size());
+    BOOST_CHECK_EQUAL(6, samples[0].value);
+}
+
+BOOST_AUTO_TEST_CASE(SharedSamples_reader_rejects_other_shared_memories)
+{
+    int fd = shm_open(NAME, O_RDWR | O_CREAT, 0644);
+    BOOST_REQUIRE(fd != -1);
+    BOOST_REQUIRE_EQUAL(0, ftruncate(fd, 4096));
+    close(fd);
+
+    SharedSampleReader reader;
+    BOOST_CHECK_THROW(reader.open(NAME), std::runtime_error);
+    shm_unlink(NAME);
+}
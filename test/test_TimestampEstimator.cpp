@@ -0,0 +1,50 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/TimestampEstimator.hpp>
+
+using namespace pressure_velki;
+
+static base::Time us(int microseconds)
+{
+    return base::Time::fromMicroseconds(microseconds);
+}
+
+BOOST_AUTO_TEST_CASE(TimestampEstimator_uses_the_whole_turnaround_until_it_has_enough_samples)
+{
+    TimestampEstimator estimator;
+    base::Time time, uncertainty;
+    estimator.update(us(1000), us(1400), time, uncertainty);
+    BOOST_CHECK_EQUAL(us(1200), time);
+    BOOST_CHECK_EQUAL(us(200), uncertainty);
+    BOOST_CHECK_EQUAL(us(400), estimator.getProcessingDelay());
+}
+
+BOOST_AUTO_TEST_CASE(TimestampEstimator_removes_the_processing_delay)
+{
+    TimestampEstimator estimator;
+    base::Time time, uncertainty;
+    for (int i = 0; i < TimestampEstimator::MINIMUM_SAMPLES; ++i)
+        estimator.update(us(0), us(300 + i * 10), time, uncertainty);
+    BOOST_CHECK_EQUAL(us(300), estimator.getProcessingDelay());
+
+    // 100us of jitter on top of the processing delay
+    estimator.update(us(1000), us(1400), time, uncertainty);
+    BOOST_CHECK_EQUAL(us(1050), time);
+    BOOST_CHECK_EQUAL(us(50), uncertainty);
+
+    estimator.setConversionDelay(us(500), us(250));
+    estimator.update(us(1000), us(1400), time, uncertainty);
+    BOOST_CHECK_EQUAL(us(550), time);
+    BOOST_CHECK_EQUAL(us(300), uncertainty);
+}
+
+BOOST_AUTO_TEST_CASE(TimestampEstimator_follows_a_drift_of_the_processing_delay)
+{
+    TimestampEstimator estimator;
+    base::Time time, uncertainty;
+    for (int i = 0; i < TimestampEstimator::WINDOW_SIZE; ++i)
+        estimator.update(us(0), us(300), time, uncertainty);
+    for (int i = 0; i < 2 * TimestampEstimator::WINDOW_SIZE; ++i)
+        estimator.update(us(0), us(500), time, uncertainty);
+    BOOST_CHECK_EQUAL(us(500), estimator.getProcessingDelay());
+    BOOST_CHECK_EQUAL(2 * TimestampEstimator::WINDOW_SIZE, estimator.getSampleCount());
+}
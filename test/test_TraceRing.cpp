@@ -0,0 +1,91 @@
+#include <boost/test/unit_test.hpp>
+#include <pressure_velki/TraceRing.hpp>
+#include <sstream>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace pressure_velki;
+
+BOOST_AUTO_TEST_CASE(TraceRing_records_events)
+{
+    TraceRing ring(8);
+    boost::uint8_t const frame[] = { 1, 73, 0, 0x12, 0x34 };
+    ring.record(TraceRing::SENT, frame, 5);
+    ring.record(TraceRing::TIMEOUT, 1, 73);
+
+    vector<TraceRing::Event> events;
+    ring.snapshot(events);
+    BOOST_REQUIRE_EQUAL(2, events.size());
+    BOOST_CHECK_EQUAL(TraceRing::SENT, events[0].type);
+    BOOST_CHECK_EQUAL(1, events[0].address);
+    BOOST_CHECK_EQUAL(73, events[0].function);
+    BOOST_CHECK_EQUAL(5, events[0].length);
+    BOOST_REQUIRE_EQUAL(3, events[0].payloadSize);
+    BOOST_CHECK_EQUAL(0x34, events[0].payload[2]);
+    BOOST_CHECK_EQUAL(TraceRing::TIMEOUT, events[1].type);
+    BOOST_CHECK_EQUAL(0, events[1].length);
+    BOOST_CHECK(events[1].time >= events[0].time);
+}
+
+BOOST_AUTO_TEST_CASE(TraceRing_keeps_the_latest_events_and_truncates_payloads)
+{
+    TraceRing ring(5);
+    BOOST_CHECK_EQUAL(8, ring.getCapacity());
+
+    vector<boost::uint8_t> data(40);
+    for (int i = 0; i < 20; ++i)
+    {
+        data[0] = i;
+        ring.record(TraceRing::RECEIVED, &data[0], data.size());
+    }
+
+    vector<TraceRing::Event> events;
+    ring.snapshot(events);
+    BOOST_CHECK_EQUAL(20, ring.getEventCount());
+    BOOST_REQUIRE_EQUAL(8, events.size());
+    BOOST_CHECK_EQUAL(12, events[0].address);
+    BOOST_CHECK_EQUAL(19, events[7].address);
+    BOOST_CHECK_EQUAL(40, events[7].length);
+    BOOST_CHECK_EQUAL(TraceRing::PAYLOAD_SIZE, events[7].payloadSize);
+}
+
+BOOST_AUTO_TEST_CASE(TraceRing_file_can_be_read_back_and_rendered)
+{
+    char pattern[] = "/tmp/pressure_velki_test_XXXXXX";
+    close(mkstemp(pattern));
+    string path = pattern;
+
+    {
+        TraceRing ring(path, 16);
+        boost::uint8_t const frame[] = { 2, 8, 0xAA, 0xBB };
+        ring.record(TraceRing::SENT, frame, 4);
+        ring.record(TraceRing::RETRY, 2, 8);
+    }
+
+    vector<TraceRing::Event> events;
+    TraceRing::readFile(path, events);
+    unlink(path.c_str());
+    BOOST_REQUIRE_EQUAL(2, events.size());
+    BOOST_CHECK_EQUAL(TraceRing::RETRY, events[1].type);
+
+    ostringstream rendered;
+    TraceRing::dump(rendered, events);
+    BOOST_CHECK(rendered.str().find("SENT") != string::npos);
+    BOOST_CHECK(rendered.str().find(" aa bb") != string::npos);
+    BOOST_CHECK(rendered.str().find("RETRY") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(TraceRing_readFile_rejects_other_files)
+{
+    char pattern[] = "/tmp/pressure_velki_test_XXXXXX";
+    int fd = mkstemp(pattern);
+    char const garbage[64] = "not a trace";
+    BOOST_REQUIRE_EQUAL(64, write(fd, garbage, 64));
+    close(fd);
+
+    vector<TraceRing::Event> events;
+    BOOST_CHECK_THROW(TraceRing::readFile(pattern, events), std::runtime_error);
+    unlink(pattern);
+}